@@ -39,8 +39,56 @@ local function CallCET(...)
     end
 end
 
+-- Pending asynchronous translations keyed by DLL ticket
+local pendingTranslations = {}
+local pendingCount = 0
+
+-- Collect finished translations from the DLL; only polls while work is outstanding
+local function OnUpdate()
+    if pendingCount == 0 then
+        return
+    end
+    
+    while true do
+        local success, ticket, ok, text = pcall(CallCET, "poll")
+        if not success or type(ticket) ~= "number" then
+            break
+        end
+        
+        local callback = pendingTranslations[ticket]
+        if callback then
+            pendingTranslations[ticket] = nil
+            pendingCount = pendingCount - 1
+            if ok then
+                callback(text)
+            else
+                DebugPrint("Async translation failed: " .. tostring(text))
+                callback(nil)
+            end
+        end
+    end
+end
+
 -- Hook outgoing chat messages for translation
 local originalSendChatMessage = SendChatMessage
+
+-- Outgoing messages waiting for their translation, per chat target. They are
+-- sent in the order they were typed: a message answered from the DLL's cache
+-- waits for an earlier one that is still being translated.
+local outboundQueues = {}
+
+-- Send the finished messages at the front of a target's queue
+local function FlushOutbound(target)
+    local queue = outboundQueues[target]
+    while queue[1] and queue[1].ready do
+        local entry = table.remove(queue, 1)
+        originalSendChatMessage(entry.text, entry.chatType, entry.language, entry.channel)
+    end
+    if not queue[1] then
+        outboundQueues[target] = nil
+    end
+end
+
 local function HookedSendChatMessage(msg, chatType, language, channel)
     DebugPrint("HookedSendChatMessage called: '" .. tostring(msg) .. "', type: " .. tostring(chatType or "nil"))
     
@@ -73,6 +121,9 @@ local function HookedSendChatMessage(msg, chatType, language, channel)
     
     DebugPrint("Channel " .. tostring(chatType) .. " translation enabled: " .. tostring(shouldTranslate))
     
+    -- Whispers go to a player and CHANNEL to a channel number; the rest by type
+    local target = chatType .. ":" .. tostring(channel)
+    
     if shouldTranslate and CETVars.translatorReady and msg and msg ~= "" then
         -- Determine translation direction for outbound (always outbound here)
         local actualTranslationDirection
@@ -96,22 +147,122 @@ local function HookedSendChatMessage(msg, chatType, language, channel)
         
         DebugPrint("Translating outbound message: " .. actualTranslationDirection .. " (" .. tostring(fromLang) .. " -> " .. tostring(toLang) .. ")")
         
-        -- Attempt translation
-        local translatedMsg = CET.TranslateText(msg, fromLang, toLang)
+        -- Translate in the background and send once the result arrives and
+        -- everything typed earlier to the same target has gone out; the
+        -- player's own messages are scheduled ahead of incoming chat
+        local entry = { text = msg, chatType = chatType, language = language, channel = channel, ready = false }
+        if not outboundQueues[target] then
+            outboundQueues[target] = {}
+        end
+        table.insert(outboundQueues[target], entry)
         
-        if translatedMsg and translatedMsg ~= msg then
-            DebugPrint("Sending translated message: '" .. tostring(translatedMsg) .. "'")
-            originalSendChatMessage(translatedMsg, chatType, language, channel)
-            return
-        else
-            DebugPrint("Translation failed or unchanged, sending original")
+        local queued = CET.TranslateAsync(msg, fromLang, toLang, function(translatedMsg)
+            if translatedMsg and translatedMsg ~= msg then
+                DebugPrint("Translated outgoing message: '" .. tostring(translatedMsg) .. "'")
+                entry.text = translatedMsg
+            else
+                DebugPrint("Translation failed or unchanged, sending original")
+            end
+            entry.ready = true
+            FlushOutbound(target)
+        end, "direct")
+        
+        if not queued then
+            DebugPrint("Translation could not be queued, sending original")
+            entry.ready = true
+            FlushOutbound(target)
         end
+        return
     end
     
-    -- Send original message if translation not enabled or failed
+    -- Send original message if translation not enabled, behind any earlier
+    -- message to the same target that is still being translated
+    if outboundQueues[target] then
+        table.insert(outboundQueues[target], { text = msg, chatType = chatType, language = language, channel = channel, ready = true })
+        FlushOutbound(target)
+        return
+    end
     originalSendChatMessage(msg, chatType, language, channel)
 end
 
+-- Push performance tunables from CETDefaults to the DLL
+local function ApplyDLLConfig()
+    local settings = {
+        api_endpoint = CETDefaults.defaultApiEndpoint,
+        connection_pool_size = CETDefaults.defaultConnectionPoolSize,
+        keepalive_ms = CETDefaults.defaultKeepAliveInterval,
+        cache_expiration = CETDefaults.defaultCacheExpiration,
+        cache_max_bytes = CETDefaults.defaultMaxCacheSize,
+        disk_cache_max_bytes = CETDefaults.defaultDiskCacheSize,
+        batch_window_ms = CETDefaults.defaultBatchWindow,
+        batch_max_items = CETDefaults.defaultBatchMaxItems,
+        batch_max_bytes = CETDefaults.defaultBatchMaxBytes,
+        quota_requests_per_sec = CETDefaults.defaultQuotaRequests,
+        quota_chars_per_sec = CETDefaults.defaultQuotaChars,
+        shed_group_ms = CETDefaults.defaultShedGroup,
+        shed_public_ms = CETDefaults.defaultShedPublic,
+        request_timeout_ms = CETDefaults.defaultTranslationTimeout,
+        retry_attempts = CETDefaults.defaultRetryAttempts,
+        hedge_requests = tostring(CETDefaults.defaultHedgeRequests),
+        breaker_failures = CETDefaults.defaultBreakerFailures,
+        breaker_open_ms = CETDefaults.defaultBreakerOpenTime,
+        phrase_tables = tostring(CETDefaults.defaultPhraseTables),
+        mask_placeholders = tostring(CETDefaults.defaultMaskPlaceholders),
+        glossary = CETDefaults.defaultGlossary,
+        stats_dump_ms = CETDefaults.defaultStatsDump,
+        log_level = CETVars.debugMode and "debug" or "info",
+    }
+    
+    for key, value in pairs(settings) do
+        local success, result = pcall(CallCET, "config", key, value)
+        DebugPrint("Config " .. key .. ": " .. tostring(result))
+    end
+end
+
+-- Keep the names of the player and their group out of translation
+local lastGlossaryNames
+function CET.UpdateGlossaryNames()
+    if not CETVars.dllInitialized then
+        return
+    end
+    
+    local names = {}
+    local playerName = UnitName("player")
+    if playerName then
+        table.insert(names, playerName)
+    end
+    local raidMembers = GetNumRaidMembers()
+    if raidMembers > 0 then
+        for i = 1, raidMembers do
+            local name = UnitName("raid" .. i)
+            if name and name ~= playerName then
+                table.insert(names, name)
+            end
+        end
+    else
+        for i = 1, GetNumPartyMembers() do
+            local name = UnitName("party" .. i)
+            if name then
+                table.insert(names, name)
+            end
+        end
+    end
+    
+    local list = table.concat(names, ",")
+    if list ~= lastGlossaryNames then
+        lastGlossaryNames = list
+        pcall(CallCET, "config", "glossary_names", list)
+        DebugPrint("Glossary names: " .. list)
+    end
+end
+
+-- DLL debug logging follows the addon's debug mode
+function CET.ApplyLogLevel()
+    if CETVars.dllInitialized then
+        pcall(CallCET, "config", "log_level", CETVars.debugMode and "debug" or "info")
+    end
+end
+
 -- Initialize DLL communication and translator
 function CET.InitializeDLL()
     if not UnitXP then
@@ -126,10 +277,11 @@ function CET.InitializeDLL()
         CETVars.dllInitialized = true
         DebugPrint("DLL communication established: " .. result)
         
-        -- Initialize translator if API key is available
-        if CETVars.apiKey and CETVars.apiKey ~= "" then
-            CET.InitializeTranslator()
-        end
+        ApplyDLLConfig()
+        CET.UpdateGlossaryNames()
+        
+        -- Without an API key the translator still runs on phrase tables
+        CET.InitializeTranslator()
         
         return true
     else
@@ -167,17 +319,18 @@ function CET.InitializeTranslator()
         return false
     end
     
-    if not CETVars.apiKey or CETVars.apiKey == "" then
-        CET.Print("|cFFFF0000Error:|r No API key configured. Use /cet apikey <your_key>")
-        return false
-    end
+    local offline = not CETVars.apiKey or CETVars.apiKey == ""
     
-    DebugPrint("Initializing translator with API key...")
-    local success, result = pcall(CallCET, "init_translator", CETVars.apiKey)
+    DebugPrint(offline and "Initializing translator offline..." or "Initializing translator with API key...")
+    local success, result = pcall(CallCET, "init_translator", offline and "" or CETVars.apiKey)
     
     if success and result and string.find(result, "successfully") then
         CETVars.translatorReady = true
-        CET.Print("Translator initialized successfully")
+        if offline then
+            CET.Print("Translator running offline on phrase tables. Use /cet apikey <your_key> for full translation")
+        else
+            CET.Print("Translator initialized successfully")
+        end
         DebugPrint(result)
         return true
     else
@@ -186,12 +339,32 @@ function CET.InitializeTranslator()
     end
 end
 
+-- Classify text with the DLL's script detector. Returns true plus the
+-- language code (nil when the text has no letters), or false if the DLL
+-- can't detect so the Lua heuristics below should be used.
+local function DetectLanguageNative(text)
+    if not CETVars.dllInitialized then
+        return false
+    end
+    
+    local success, lang, script = pcall(CallCET, "detect", text)
+    if not success or type(script) ~= "string" then
+        return false
+    end
+    return true, lang
+end
+
 -- Simple language detection based on character patterns
 local function DetectLanguage(text)
     if not text or text == "" then
         return nil
     end
     
+    local native, lang = DetectLanguageNative(text)
+    if native then
+        return lang
+    end
+    
     -- Count Chinese characters (CJK range)
     local chineseCount = 0
     local totalChars = string.len(text)
@@ -219,6 +392,11 @@ local function DetectLanguageForTranslate(text)
         return nil
     end
     
+    local native, lang = DetectLanguageNative(text)
+    if native then
+        return lang
+    end
+    
     local totalBytes = string.len(text)
     local chineseBytes = 0
     local alphaCount = 0
@@ -298,6 +476,50 @@ function CET.TranslateText(text, fromLang, toLang)
     end
 end
 
+-- Perform translation without blocking; callback receives the translation or nil.
+-- priority is "direct", "group" or "public" (default) and decides which
+-- requests go first, and which are dropped, when chat is busy.
+-- Returns false if the request could not be queued (callback is not called).
+function CET.TranslateAsync(text, fromLang, toLang, callback, priority)
+    if not CETVars.translatorReady or not text or text == "" then
+        return false
+    end
+    
+    local success, ticket, cached = pcall(CallCET, "translate_async", text, fromLang, toLang, priority or "public")
+    
+    if not success or type(ticket) ~= "number" then
+        -- Older DLLs without translate_async fall back to the blocking call
+        if success and type(ticket) == "string" and string.find(ticket, "Unknown command") then
+            callback(CET.TranslateText(text, fromLang, toLang))
+            return true
+        end
+        DebugPrint("translate_async failed: " .. tostring(ticket))
+        return false
+    end
+    
+    -- Ticket 0 means the DLL answered from its cache
+    if ticket == 0 then
+        callback(cached)
+        return true
+    end
+    
+    pendingTranslations[ticket] = callback
+    pendingCount = pendingCount + 1
+    return true
+end
+
+-- Scheduling class of incoming chat; everything else is "public"
+local CHAT_PRIORITY = {
+    WHISPER = "direct",
+    WHISPER_INFORM = "direct",
+    PARTY = "group",
+    RAID = "group",
+    RAID_LEADER = "group",
+    RAID_WARNING = "group",
+    GUILD = "group",
+    OFFICER = "group",
+}
+
 -- Check if we should process a chat event
 local function ShouldProcessMessage(event, channelString, isOutbound)
     if not event then
@@ -410,23 +632,24 @@ local function ProcessChatMessage(event)
         return
     end
     
-    -- Attempt translation
-    local translation = CET.TranslateText(message, fromLang, toLang)
-    
-    DebugPrint("Translation result: " .. tostring(translation))
-    
-    if translation and translation ~= message then
-        -- Display translated message
-        local prefix = CETVars.translationPrefix .. " "
-        local translatedDisplay = prefix .. translation
+    -- Attempt translation; the result is displayed when the DLL finishes it
+    local priority = isOutbound and "direct" or CHAT_PRIORITY[string.sub(event, 10)] or "public"
+    CET.TranslateAsync(message, fromLang, toLang, function(translation)
+        DebugPrint("Translation result: " .. tostring(translation))
         
-        if CETVars.showOriginalText then
-            translatedDisplay = translatedDisplay .. " |cFF808080(Original: " .. message .. ")|r"
+        if translation and translation ~= message then
+            -- Display translated message
+            local prefix = CETVars.translationPrefix .. " "
+            local translatedDisplay = prefix .. translation
+            
+            if CETVars.showOriginalText then
+                translatedDisplay = translatedDisplay .. " |cFF808080(Original: " .. message .. ")|r"
+            end
+            
+            -- Display in appropriate chat frame with sender info
+            DEFAULT_CHAT_FRAME:AddMessage("|cFF00FF96[" .. sender .. "]|r " .. translatedDisplay)
         end
-        
-        -- Display in appropriate chat frame with sender info
-        DEFAULT_CHAT_FRAME:AddMessage("|cFF00FF96[" .. sender .. "]|r " .. translatedDisplay)
-    end
+    end, priority)
 end
 
 -- Event handler
@@ -446,6 +669,9 @@ local function OnEvent()
         -- Register chat events
         CET.RegisterChatEvents()
         
+    elseif event == "PLAYER_ENTERING_WORLD" or event == "PARTY_MEMBERS_CHANGED" or event == "RAID_ROSTER_UPDATE" then
+        CET.UpdateGlossaryNames()
+        
     elseif event == "PLAYER_LOGOUT" then
         -- Save variables
         CETVars.SaveVariables()
@@ -453,6 +679,12 @@ local function OnEvent()
         -- Clean up hook
         CET.RemoveMessageHook()
         
+        -- Stop the DLL's background threads while it is safe to wait for
+        -- them; DllMain cannot
+        if CETVars.dllInitialized then
+            pcall(CallCET, "shutdown")
+        end
+        
     elseif event and string.find(event, "CHAT_MSG_") then
         -- Process chat messages
         ProcessChatMessage(event)
@@ -509,6 +741,8 @@ SlashCmdList["CET"] = function(msg)
     if cmd == "help" then
         CET.Print("Commands:")
         CET.Print("/cet status - Show current settings")
+        CET.Print("/cet stats - Show translation counters and latencies")
+        CET.Print("/cet trace on|off|dump - Record timing spans and write CET_trace.json")
         CET.Print("/cet toggle <channel> - Toggle channel (say/whisper/party/raid/guild/yell/channel)")
         CET.Print("/cet direction <direction> - Set translation direction (cn_to_en or en_to_cn)")
         CET.Print("/cet apikey <key> - Set Google Translate API key")
@@ -591,9 +825,49 @@ SlashCmdList["CET"] = function(msg)
             CET.Print("DLL Test: " .. tostring(result))
         end
         
+    elseif cmd == "stats" then
+        if not CETVars.dllInitialized then
+            CET.Print("DLL not initialized.")
+            return
+        end
+        local success, result = pcall(CallCET, "stats")
+        if not success or type(result) ~= "string" then
+            CET.Print("Stats unavailable: " .. tostring(result))
+            return
+        end
+        -- key=value pairs after the "cet_stats" tag, a few per chat line
+        local line = ""
+        local count = 0
+        for pair in string.gfind(result, "%S+=%S+") do
+            line = line .. " " .. pair
+            count = count + 1
+            if count == 6 then
+                CET.Print(line)
+                line = ""
+                count = 0
+            end
+        end
+        if count > 0 then
+            CET.Print(line)
+        end
+        
+    elseif cmd == "trace" then
+        if not CETVars.dllInitialized then
+            CET.Print("DLL not initialized.")
+            return
+        end
+        local action = string.lower(args[2] or "")
+        if action ~= "on" and action ~= "off" and action ~= "dump" then
+            CET.Print("Usage: /cet trace on|off|dump")
+            return
+        end
+        local success, result = pcall(CallCET, "trace", action)
+        CET.Print(tostring(result))
+        
     elseif cmd == "debug" then
         CETVars.debugMode = not CETVars.debugMode
         CETVars.SaveVariables()
+        CET.ApplyLogLevel()
         CET.Print("Debug mode " .. (CETVars.debugMode and "enabled" or "disabled"))
         
     elseif cmd == "reset" then
@@ -665,4 +939,8 @@ end
 -- Set up event handling
 eventFrame:RegisterEvent("ADDON_LOADED")
 eventFrame:RegisterEvent("PLAYER_LOGOUT")
+eventFrame:RegisterEvent("PLAYER_ENTERING_WORLD")
+eventFrame:RegisterEvent("PARTY_MEMBERS_CHANGED")
+eventFrame:RegisterEvent("RAID_ROSTER_UPDATE")
 eventFrame:SetScript("OnEvent", OnEvent)
+eventFrame:SetScript("OnUpdate", OnUpdate)
@@ -33,6 +33,11 @@ CETDefaults.translationDirections = {
 CETDefaults.defaultApiKey = ""
 CETDefaults.defaultApiEndpoint = "https://translation.googleapis.com/language/translate/v2"
 
+-- Default connection settings - persistent connections are warmed when the
+-- translator initializes and probed after defaultKeepAliveInterval idle ms
+CETDefaults.defaultConnectionPoolSize = 2
+CETDefaults.defaultKeepAliveInterval = 45000 -- milliseconds
+
 -- Default UI settings
 CETDefaults.defaultDebugMode = false
 CETDefaults.defaultShowOriginalText = true
@@ -44,7 +49,48 @@ CETDefaults.defaultIgnoreList = {}
 -- Default performance settings
 CETDefaults.defaultTranslationTimeout = 10000 -- 10 seconds
 CETDefaults.defaultCacheExpiration = 3600 -- 1 hour
-CETDefaults.defaultMaxCacheSize = 1000
+CETDefaults.defaultMaxCacheSize = 1048576 -- bytes of cached translations (1 MB)
+CETDefaults.defaultDiskCacheSize = 8388608 -- CET_cache.bin size limit (8 MB), 0 disables it
+
+-- Default request batching - cache misses for the same language pair are
+-- gathered for up to defaultBatchWindow milliseconds into one API request
+CETDefaults.defaultBatchWindow = 50 -- milliseconds
+CETDefaults.defaultBatchMaxItems = 16
+CETDefaults.defaultBatchMaxBytes = 4096
+
+-- Default API quota and load shedding - requests and characters sent per
+-- second (0 = unlimited); group and public chat still queued after the
+-- shed time is dropped instead of being translated late
+CETDefaults.defaultQuotaRequests = 10 -- requests per second
+CETDefaults.defaultQuotaChars = 2000 -- characters per second
+CETDefaults.defaultShedGroup = 15000 -- milliseconds
+CETDefaults.defaultShedPublic = 5000 -- milliseconds
+
+-- Default request resilience - each API request (retries included) gets
+-- defaultTranslationTimeout ms; transport errors, 429 and 5xx are retried
+-- with a randomized backoff. After defaultBreakerFailures failures in a row
+-- requests fail fast for defaultBreakerOpenTime ms. Hedged requests resend
+-- a request that is slower than usual on a second connection; the API bills
+-- both, so they are off by default.
+CETDefaults.defaultRetryAttempts = 3 -- including the first attempt
+CETDefaults.defaultHedgeRequests = false
+CETDefaults.defaultBreakerFailures = 5
+CETDefaults.defaultBreakerOpenTime = 30000 -- milliseconds
+
+-- Default phrase tables - common chat (LFG, WTS/WTB, raid calls) is answered
+-- from CET_phrases_<from>_<to>.tsv next to the DLL before going to the API,
+-- and without an API key phrase tables are all the translator uses
+CETDefaults.defaultPhraseTables = true
+
+-- Default placeholder masking - links, numbers, group members' names and the
+-- glossary words below are sent as placeholders and put back unchanged, so
+-- "LF2M BRD" and "LF3M BRD" share one cached translation
+CETDefaults.defaultMaskPlaceholders = true
+CETDefaults.defaultGlossary = "BRD,LBRS,UBRS,MC,BWL,ZG,AQ20,AQ40,Naxx,Ony,Strat,Scholo,DM,SM,ST,ZF,Mara,RFD,RFK,RFC,SFK,BFD,WC,VC,Gnomer,Ulda"
+
+-- Default stats file - every defaultStatsDump ms the DLL appends its
+-- counters (the /cet stats line) to CET_stats.log next to it; 0 = off
+CETDefaults.defaultStatsDump = 0 -- milliseconds
 
 -- Deep copy utility for default settings
 function CETDefaults.deepCopy(original)
@@ -192,6 +192,7 @@ local function CreateSettingsUI()
     
     local debugCheckbox = CreateCheckbox(scrollChild, "Enable Debug Mode", CETVars.debugMode, function()
         CETVars.debugMode = (this:GetChecked() == 1)
+        CET.ApplyLogLevel()
         -- Don't auto-save, let the Save button handle it
     end)
     PositionElement(debugCheckbox, OPTION_LABEL_LEFT_MARGIN, OPTION_SPACING)
@@ -0,0 +1,651 @@
+// cet_bench.cpp - Microbenchmarks for the platform-independent parts of CET
+// Runs the chat corpus through segmentation, cache keys, masking, the caches,
+// request building, response parsing, UTF-8 checks, phrase tables and the
+// UnitXP bridge (against stub Lua functions), and reports ns, allocations
+// and allocated bytes per operation. Exits with 2 when a path that must
+// not allocate once warm does.
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_set>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <new>
+#include <fstream>
+
+#include "../include/lua_interface.h"
+#include "../include/segmenter.h"
+#include "../include/script_detect.h"
+#include "../include/cache_key.h"
+#include "../include/translation_cache.h"
+#include "../include/text_mask.h"
+#include "../include/aho_corasick.h"
+#include "../include/phrase_table.h"
+#include "../include/json_parser.h"
+#include "../include/utf8_helper.h"
+#include "../include/request_builder.h"
+#include "../include/logging.h"
+#include "../include/utils.h"
+#include "lua_stub.h"
+
+using namespace std;
+
+#ifndef CET_BENCH_CORPUS
+#define CET_BENCH_CORPUS "bench/chat_corpus.tsv"
+#endif
+#ifndef CET_BENCH_PHRASES
+#define CET_BENCH_PHRASES "phrases"
+#endif
+
+// Allocation counting: every global new in the process goes through here
+static atomic<uint64_t> g_allocations{ 0 };
+static atomic<uint64_t> g_allocatedBytes{ 0 };
+
+static void* CountedAlloc(size_t size) {
+    g_allocations.fetch_add(1, memory_order_relaxed);
+    g_allocatedBytes.fetch_add(size, memory_order_relaxed);
+    void* memory = malloc(size ? size : 1);
+    if (!memory) {
+        throw bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new(size_t size) { return CountedAlloc(size); }
+void* operator new[](size_t size) { return CountedAlloc(size); }
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    try { return CountedAlloc(size); } catch (...) { return nullptr; }
+}
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+    try { return CountedAlloc(size); } catch (...) { return nullptr; }
+}
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete[](void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+void operator delete[](void* memory, size_t) noexcept { free(memory); }
+
+// Results are summed into this so the compiler cannot drop the work
+static volatile size_t g_sink = 0;
+
+static inline void Consume(size_t value) {
+    g_sink = g_sink + value;
+}
+
+struct BenchOptions {
+    string filter;
+    string corpusPath = CET_BENCH_CORPUS;
+    string phraseDirectory = CET_BENCH_PHRASES;
+    double minTimeMs = 200.0;
+};
+
+static BenchOptions g_options;
+
+// Time fn (which performs opsPerCall operations) until minTimeMs has passed,
+// then print ns, allocations and bytes per operation. Returns the
+// allocations per operation, 0 when the benchmark was filtered out.
+template <typename Fn>
+static double Bench(const char* name, size_t opsPerCall, Fn&& fn, const string& note = string()) {
+    if (!g_options.filter.empty() && string_view(name).find(g_options.filter) == string_view::npos) {
+        return 0;
+    }
+    if (opsPerCall == 0) {
+        return 0;
+    }
+
+    // Warm up buffers and caches; their first growth is not steady state
+    fn();
+    fn();
+
+    size_t calls = 1;
+    for (;;) {
+        uint64_t allocations = g_allocations.load(memory_order_relaxed);
+        uint64_t bytes = g_allocatedBytes.load(memory_order_relaxed);
+        auto start = chrono::steady_clock::now();
+        for (size_t call = 0; call < calls; ++call) {
+            fn();
+        }
+        double elapsedNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        allocations = g_allocations.load(memory_order_relaxed) - allocations;
+        bytes = g_allocatedBytes.load(memory_order_relaxed) - bytes;
+
+        if (elapsedNs >= g_options.minTimeMs * 1e6 || calls >= (static_cast<size_t>(1) << 30)) {
+            double ops = static_cast<double>(calls) * opsPerCall;
+            printf("%-34s %12.1f %12.2f %12.1f  %s\n", name, elapsedNs / ops, allocations / ops, bytes / ops,
+                   note.c_str());
+            return allocations / ops;
+        }
+        calls *= elapsedNs < 1e6 ? 10 : 2;
+    }
+}
+
+struct ChatLine {
+    string channel;
+    string sender;
+    string text;
+};
+
+// time_ms<TAB>channel<TAB>sender<TAB>text per line, '#' starts a comment
+static bool LoadCorpus(const string& path, vector<ChatLine>& lines) {
+    ifstream file(path, ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    string line;
+    while (getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        vector<string> fields = SplitString(line, '\t');
+        if (fields.size() < 4 || fields[3].empty()) {
+            continue;
+        }
+        lines.push_back(ChatLine{ fields[1], fields[2], fields[3] });
+    }
+    return !lines.empty();
+}
+
+static string Percent(size_t part, size_t whole) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.1f%%", whole ? 100.0 * part / whole : 0.0);
+    return buffer;
+}
+
+// A translate v2 response for count texts, with escapes and CJK
+static string MakeResponse(size_t count) {
+    string response = "{\n  \"data\": {\n    \"translations\": [\n";
+    for (size_t i = 0; i < count; ++i) {
+        response += "      {\n        \"translatedText\": \"\\u6c42\\u7ec4 {0} \\u8fd8\\u5dee"
+                    "{1}\\u4eba, \\\"\\u6765\\u7684\\u5bc6\\u6211\\\"\",\n"
+                    "        \"detectedSourceLanguage\": \"en\"\n      }";
+        response += i + 1 < count ? ",\n" : "\n";
+    }
+    response += "    ]\n  }\n}\n";
+    return response;
+}
+
+// The same shape, with every text made of \uXXXX and \\ escapes; no escaped
+// quotes, which the old extractor cannot read past, so both decode all of it
+static string MakeEscapedResponse(size_t count) {
+    string response = "{\n  \"data\": {\n    \"translations\": [\n";
+    for (size_t i = 0; i < count; ++i) {
+        response += "      {\n        \"translatedText\": \"";
+        for (size_t j = 0; j < 8; ++j) {
+            response += "\\u4f60\\u597d\\uff0c\\u4e16\\u754c \\u0041\\\\ \\u00e9\\u2764 ";
+        }
+        response += "\",\n        \"detectedSourceLanguage\": \"en\"\n      }";
+        response += i + 1 < count ? ",\n" : "\n";
+    }
+    response += "    ]\n  }\n}\n";
+    return response;
+}
+
+// The extractor TranslationResponseParser replaced, kept as the baseline for
+// json/ numbers: a find for each key, the value cut at the next quote (even
+// an escaped one), then a find-and-replace pass per escape kind
+struct LegacyJsonExtractor {
+    static vector<string> ExtractAll(const string& json) {
+        vector<string> results;
+        size_t pos = 0;
+        while (pos < json.length()) {
+            size_t before = pos;
+            string text = ExtractFrom(json, pos);
+            if (pos == string::npos || pos == before) {
+                break;
+            }
+            results.push_back(text);
+        }
+        return results;
+    }
+
+    static string ExtractFrom(const string& json, size_t& searchPos) {
+        string searchKey = "\"translatedText\"";
+        size_t keyPos = json.find(searchKey, searchPos);
+        if (keyPos == string::npos) {
+            searchPos = string::npos;
+            return "";
+        }
+        searchPos = keyPos + searchKey.length();
+
+        size_t colonPos = json.find(":", keyPos + searchKey.length());
+        if (colonPos == string::npos) {
+            return "";
+        }
+        size_t start = colonPos + 1;
+        while (start < json.length() && (json[start] == ' ' || json[start] == '\t' || json[start] == '\n' || json[start] == '\r')) {
+            start++;
+        }
+        if (start >= json.length() || json[start] != '"') {
+            return "";
+        }
+        start++;
+        size_t end = json.find("\"", start);
+        if (end == string::npos) {
+            return "";
+        }
+        searchPos = end + 1;
+
+        string result = json.substr(start, end - start);
+        size_t pos = 0;
+        while ((pos = result.find("\\\"", pos)) != string::npos) {
+            result.replace(pos, 2, "\"");
+            pos += 1;
+        }
+        pos = 0;
+        while ((pos = result.find("\\\\", pos)) != string::npos) {
+            result.replace(pos, 2, "\\");
+            pos += 1;
+        }
+        pos = 0;
+        while ((pos = result.find("\\u", pos)) != string::npos) {
+            if (pos + 5 < result.length()) {
+                string hexStr = result.substr(pos + 2, 4);
+                try {
+                    unsigned int codepoint = stoul(hexStr, nullptr, 16);
+                    string utf8 = CodepointToUTF8(codepoint);
+                    result.replace(pos, 6, utf8);
+                    pos += utf8.length();
+                } catch (...) {
+                    pos += 6;
+                }
+            } else {
+                break;
+            }
+        }
+        return result;
+    }
+
+    static string CodepointToUTF8(unsigned int codepoint) {
+        string result;
+        if (codepoint <= 0x7F) {
+            result += static_cast<char>(codepoint);
+        } else if (codepoint <= 0x7FF) {
+            result += static_cast<char>(0xC0 | (codepoint >> 6));
+            result += static_cast<char>(0x80 | (codepoint & 0x3F));
+        } else if (codepoint <= 0xFFFF) {
+            result += static_cast<char>(0xE0 | (codepoint >> 12));
+            result += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+            result += static_cast<char>(0x80 | (codepoint & 0x3F));
+        } else if (codepoint <= 0x10FFFF) {
+            result += static_cast<char>(0xF0 | (codepoint >> 18));
+            result += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+            result += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+            result += static_cast<char>(0x80 | (codepoint & 0x3F));
+        }
+        return result;
+    }
+};
+
+static void PrintUsage() {
+    printf("usage: cet_bench [--filter text] [--min-time ms] [--corpus file] [--phrases directory]\n");
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            g_options.filter = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            g_options.minTimeMs = atof(argv[++i]);
+        } else if (arg == "--corpus" && i + 1 < argc) {
+            g_options.corpusPath = argv[++i];
+        } else if (arg == "--phrases" && i + 1 < argc) {
+            g_options.phraseDirectory = argv[++i];
+        } else {
+            PrintUsage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    vector<ChatLine> corpus;
+    if (!LoadCorpus(g_options.corpusPath, corpus)) {
+        fprintf(stderr, "cet_bench: cannot read corpus %s\n", g_options.corpusPath.c_str());
+        return 1;
+    }
+
+    // Segments as the translator sees them, before and after masking
+    PlaceholderMasker masker;
+    masker.SetGlossaryTerms(SplitString("BRD,LBRS,UBRS,MC,BWL,ZG,AQ20,AQ40,Naxx,Ony,Strat,Scholo,DM,SM,ST,ZF,"
+                                        "Mara,RFD,RFK,RFC,SFK,BFD,WC,VC,Gnomer,Ulda", ','));
+    vector<string> senders;
+    for (const ChatLine& line : corpus) {
+        senders.push_back(line.sender);
+    }
+    masker.SetNames(senders);
+
+    vector<TextSegment> segments;
+    vector<string> units;
+    vector<string> templates;
+    vector<vector<MaskSpan>> unitSpans;
+    size_t messageBytes = 0;
+    for (const ChatLine& line : corpus) {
+        messageBytes += line.text.size();
+        SplitSegments(line.text, segments);
+        for (const TextSegment& segment : segments) {
+            units.push_back(line.text.substr(segment.start, segment.length));
+            templates.emplace_back();
+            unitSpans.emplace_back();
+            masker.Mask(units.back(), templates.back(), unitSpans.back());
+        }
+    }
+
+    printf("cet_bench: %zu messages, %zu segments, %zu bytes from %s\n\n", corpus.size(), units.size(), messageBytes,
+           g_options.corpusPath.c_str());
+    printf("%-34s %12s %12s %12s  %s\n", "benchmark", "ns/op", "allocs/op", "bytes/op", "notes");
+    size_t regressions = 0;
+
+    // Segmentation and script detection, per message
+    Bench("segmenter/split", corpus.size(), [&] {
+        for (const ChatLine& line : corpus) {
+            SplitSegments(line.text, segments);
+            Consume(segments.size());
+        }
+    });
+
+    Bench("script_detect/detect", corpus.size(), [&] {
+        for (const ChatLine& line : corpus) {
+            Consume(DetectScript(line.text).letters);
+        }
+    });
+
+    // Cache keys, per segment, against the from + "->" + to + ":" + text
+    // string keys they replaced. The notes give the distinct keys each leaves
+    // on the corpus, so the best hit rate a cache could reach, and what a
+    // key costs per cache entry.
+    {
+        unordered_set<string> stringKeys;
+        size_t stringKeyBytes = 0;
+        for (const string& unit : units) {
+            string key = string("en") + "->" + "zh" + ":" + unit;
+            size_t size = key.size();
+            if (stringKeys.insert(move(key)).second) {
+                stringKeyBytes += sizeof(string) + size;
+            }
+        }
+        string stringNote = to_string(stringKeys.size()) + " keys, hit rate " +
+                            Percent(units.size() - stringKeys.size(), units.size()) + ", " +
+                            to_string(stringKeys.empty() ? 0 : stringKeyBytes / stringKeys.size()) + " bytes/key";
+
+        string stringKey;
+        Bench("cache_key/string_baseline", units.size(), [&] {
+            for (const string& unit : units) {
+                stringKey = string("en") + "->" + "zh" + ":" + unit;
+                Consume(stringKey.size());
+            }
+        }, stringNote);
+
+        unordered_set<CacheKey, CacheKeyHash> rawKeys;
+        unordered_set<CacheKey, CacheKeyHash> maskedKeys;
+        for (size_t i = 0; i < units.size(); ++i) {
+            rawKeys.insert(MakeCacheKey(units[i], "en", "zh"));
+            maskedKeys.insert(MakeCacheKey(templates[i], "en", "zh"));
+        }
+        string note = to_string(rawKeys.size()) + " keys -> " + to_string(maskedKeys.size()) + " masked, hit rate " +
+                      Percent(units.size() - rawKeys.size(), units.size()) + " -> " +
+                      Percent(units.size() - maskedKeys.size(), units.size()) + ", " +
+                      to_string(sizeof(CacheKey)) + " bytes/key";
+
+        Bench("cache_key/make", units.size(), [&] {
+            for (const string& unit : units) {
+                Consume(static_cast<size_t>(MakeCacheKey(unit, "en", "zh").hashLow));
+            }
+        }, note);
+    }
+
+    Bench("cache_key/canonicalize", units.size(), [&] {
+        for (const string& unit : units) {
+            Consume(CanonicalizeText(unit).size());
+        }
+    });
+
+    // Placeholder masking round trip, per segment
+    {
+        size_t masked = 0;
+        size_t rawBytes = 0;
+        size_t templateBytes = 0;
+        for (size_t i = 0; i < units.size(); ++i) {
+            masked += unitSpans[i].empty() ? 0 : 1;
+            rawBytes += units[i].size();
+            templateBytes += templates[i].size();
+        }
+        string note = Percent(masked, units.size()) + " of segments masked, request text " + to_string(rawBytes) +
+                      " -> " + to_string(templateBytes) + " bytes";
+
+        string templ;
+        vector<MaskSpan> spans;
+        Bench("text_mask/mask", units.size(), [&] {
+            for (const string& unit : units) {
+                masker.Mask(unit, templ, spans);
+                Consume(templ.size());
+            }
+        }, note);
+
+        string restored;
+        Bench("text_mask/unmask", units.size(), [&] {
+            for (size_t i = 0; i < units.size(); ++i) {
+                Unmask(templates[i], units[i], unitSpans[i], restored);
+                Consume(restored.size());
+            }
+        });
+    }
+
+    // Translation cache: hits on a warm cache, and inserts into a full one
+    {
+        vector<CacheKey> keys;
+        for (const string& templ : templates) {
+            keys.push_back(MakeCacheKey(templ, "en", "zh"));
+        }
+
+        TranslationCache cache(1024 * 1024, 3600);
+        for (size_t i = 0; i < keys.size(); ++i) {
+            cache.Put(keys[i], templates[i]);
+            cache.Put(keys[i], templates[i]);
+        }
+        string note = to_string(cache.Size()) + " entries, " +
+                      to_string(cache.Size() ? cache.Bytes() / cache.Size() : 0) + " bytes/entry";
+
+        string value;
+        Bench("cache/get_hit", keys.size(), [&] {
+            for (const CacheKey& key : keys) {
+                Consume(cache.Get(key, value) ? value.size() : 0);
+            }
+        }, note);
+
+        TranslationCache small(16 * 1024, 3600);
+        uint64_t salt = 0;
+        Bench("cache/put_evict", keys.size(), [&] {
+            for (size_t i = 0; i < keys.size(); ++i) {
+                CacheKey key = keys[i];
+                key.hashHigh ^= ++salt;
+                small.Put(key, templates[i]);
+            }
+            Consume(small.Size());
+        });
+    }
+
+    // Request bodies for 16 segments and URL encoding, per segment
+    {
+        vector<size_t> queryIndex;
+        for (size_t i = 0; i < units.size() && i < 16; ++i) {
+            queryIndex.push_back(i);
+        }
+        // Every request goes through the builder, which reuses its buffer
+        TranslationRequestBuilder builder;
+        double allocations = Bench("request/build_16", queryIndex.size(), [&] {
+            Consume(builder.Build(templates, queryIndex, 0, queryIndex.size(), "en", "zh").size());
+        });
+        if (allocations > 0) {
+            fprintf(stderr, "cet_bench: request/build_16 allocates after warm-up\n");
+            regressions++;
+        }
+
+        string encoded;
+        Bench("request/url_encode", units.size(), [&] {
+            for (const string& unit : units) {
+                encoded.clear();
+                AppendUrlEncoded(encoded, unit);
+                Consume(encoded.size());
+            }
+        });
+    }
+
+    // Response parsing, per translated text, against the old extractor; the
+    // note says how many of the old extractor's texts match the parser's
+    {
+        struct JsonCase {
+            const char* name;
+            const char* legacyName;
+            string response;
+        };
+        JsonCase cases[] = {
+            { "json/parse_16", "json/parse_16_legacy", MakeResponse(16) },
+            { "json/parse_16_escaped", "json/parse_16_escaped_legacy", MakeEscapedResponse(16) },
+        };
+
+        TranslationResponseParser parser;
+        for (const JsonCase& jsonCase : cases) {
+            const string& response = jsonCase.response;
+            Bench(jsonCase.name, 16, [&] {
+                parser.Reset();
+                parser.Feed(response.data(), response.size());
+                Consume(parser.Finish() ? parser.Count() : 0);
+            }, to_string(response.size()) + " byte response");
+
+            parser.Reset();
+            parser.Feed(response.data(), response.size());
+            parser.Finish();
+            vector<string> legacy = LegacyJsonExtractor::ExtractAll(response);
+            size_t matching = 0;
+            for (size_t i = 0; i < legacy.size() && i < parser.Count(); ++i) {
+                matching += legacy[i] == parser.Text(i);
+            }
+            Bench(jsonCase.legacyName, 16, [&] {
+                Consume(LegacyJsonExtractor::ExtractAll(response).size());
+            }, to_string(matching) + "/" + to_string(parser.Count()) + " texts decoded the same");
+        }
+    }
+
+    // UTF-8 validation over the corpus, and repair of a damaged string
+    {
+        char note[64];
+        snprintf(note, sizeof(note), "%.1f bytes/message", static_cast<double>(messageBytes) / corpus.size());
+        Bench("utf8/find_invalid", corpus.size(), [&] {
+            for (const ChatLine& line : corpus) {
+                Consume(UTF8Helper::FindInvalid(line.text));
+            }
+        }, note);
+
+        string damaged = corpus[0].text + "\xE4\xB8" + corpus[1].text + "\xFF";
+        Bench("utf8/repair", 1, [&] {
+            Consume(UTF8Helper::Repair(damaged).size());
+        });
+    }
+
+    // Multi-pattern glossary scan, per message
+    {
+        AhoCorasick glossary(true);
+        for (const string& term : SplitString("BRD,UBRS,LBRS,MC,BWL,ZG,Strat,Scholo,DM,SM,ST,ZF,Mara", ',')) {
+            glossary.Add(term);
+        }
+        glossary.Build();
+        vector<PatternMatch> matches;
+        Bench("aho_corasick/find_longest", corpus.size(), [&] {
+            for (const ChatLine& line : corpus) {
+                glossary.FindLongest(line.text, matches, OnWordBoundary);
+                Consume(matches.size());
+            }
+        });
+    }
+
+    // Phrase tables over the masked segments, per segment
+    {
+        PhraseTable toChinese;
+        PhraseTable toEnglish;
+        bool loaded = toChinese.Load(g_options.phraseDirectory + "/CET_phrases_en_zh.tsv");
+        loaded = toEnglish.Load(g_options.phraseDirectory + "/CET_phrases_zh_en.tsv") && loaded;
+        if (loaded) {
+            vector<bool> isChinese;
+            size_t covered = 0;
+            string result;
+            for (const string& templ : templates) {
+                isChinese.push_back(DetectScript(templ).script == Script::Han);
+                covered += (isChinese.back() ? toEnglish : toChinese).Translate(templ, result) ? 1 : 0;
+            }
+            string note = Percent(covered, templates.size()) + " of segments answered, " +
+                          to_string(toChinese.Size() + toEnglish.Size()) + " phrases";
+
+            Bench("phrase_table/translate", templates.size(), [&] {
+                for (size_t i = 0; i < templates.size(); ++i) {
+                    Consume((isChinese[i] ? toEnglish : toChinese).Translate(templates[i], result) ? 1 : 0);
+                }
+            }, note);
+        } else {
+            printf("%-34s skipped, no phrase tables in %s\n", "phrase_table/translate",
+                   g_options.phraseDirectory.c_str());
+        }
+    }
+
+    // Utility helpers the Lua side uses on every config call
+    {
+        const char* codes[] = { "en", "zh", "zh-TW", "xx", "de", "klingon" };
+        Bench("utils/is_valid_language_code", 6, [&] {
+            for (const char* code : codes) {
+                Consume(IsValidLanguageCode(code) ? 1 : 0);
+            }
+        });
+
+        string list = "BRD, UBRS ,LBRS,MC, BWL,ZG";
+        Bench("utils/split_string", 1, [&] {
+            Consume(SplitString(list, ',').size());
+        });
+
+        string padded = "   inv pls \t\r\n";
+        Bench("utils/trim_string", 1, [&] {
+            Consume(TrimString(padded).size());
+        });
+    }
+
+    // A debug log call with debug logging off must cost one branch
+    {
+        SetLogLevel(LogLevel::Info);
+        size_t counter = 0;
+        Bench("log/debug_disabled", 1, [&] {
+            LOG_DEBUG("Translation cache hit for: ", units[counter % units.size()], " (", counter, ")");
+            Consume(++counter);
+        });
+    }
+
+    // The real UnitXP hook and CET command table against stub Lua functions:
+    // calls for other addons pass straight through, CET calls are dispatched
+    // by table
+    {
+        InstallStubLua();
+
+        StubLua passthrough = {};
+        SetStubArgs(passthrough, { "player", "nextLevelXP" });
+        Bench("lua/passthrough", 1, [&] {
+            Consume(static_cast<size_t>(detoured_UnitXP(&passthrough)));
+        });
+
+        StubLua ping = {};
+        SetStubArgs(ping, { "CET", "ping" });
+        Bench("lua/dispatch_ping", 1, [&] {
+            Consume(static_cast<size_t>(detoured_UnitXP(&ping)));
+        });
+
+        StubLua detect = {};
+        SetStubArgs(detect, { "CET", "detect", corpus[0].text.c_str() });
+        Bench("lua/detect", 1, [&] {
+            Consume(static_cast<size_t>(detoured_UnitXP(&detect)));
+        });
+    }
+
+    return regressions == 0 ? 0 : 2;
+}
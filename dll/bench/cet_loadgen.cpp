@@ -0,0 +1,439 @@
+// cet_loadgen.cpp - Replays a chat trace through CET against a translate endpoint
+// Every message goes through UnitXP("CET", ...) the way the addon sends it:
+// detect, translate_async with the channel's priority, then poll once per
+// frame. Reports end-to-end latency percentiles, the request count against
+// the message count, failures, and queue depth over time.
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../include/lua_interface.h"
+#include "../include/translator_core.h"
+#include "../include/translation_worker.h"
+#include "../include/logging.h"
+#include "../include/metrics.h"
+#include "../include/trace.h"
+#include "../include/utils.h"
+#include "mock_server.h"
+#include "lua_stub.h"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+#ifndef CET_BENCH_CORPUS
+#define CET_BENCH_CORPUS "bench/chat_corpus.tsv"
+#endif
+
+struct LoadgenOptions {
+    string corpusPath = CET_BENCH_CORPUS;
+    string endpoint;                    // empty: start the mock server in-process
+    vector<pair<string, string>> config;
+    double speed = 1.0;                 // trace time is divided by this
+    unsigned int loops = 1;
+    unsigned int pollMs = 16;           // one addon OnUpdate per frame
+    unsigned int sampleMs = 1000;
+    unsigned int drainMs = 30000;
+    string logLevel;
+    string tracePath;                   // empty: no span trace
+    MockServerOptions mock;
+};
+
+struct TraceMessage {
+    uint32_t timeMs;
+    string channel;
+    string text;
+};
+
+static bool LoadTrace(const string& path, vector<TraceMessage>& messages) {
+    ifstream file(path, ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    string line;
+    while (getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        vector<string> fields = SplitString(line, '\t');
+        if (fields.size() < 4 || fields[3].empty()) {
+            continue;
+        }
+        messages.push_back(TraceMessage{ static_cast<uint32_t>(strtoul(fields[0].c_str(), nullptr, 10)),
+                                         fields[1], fields[3] });
+    }
+    return !messages.empty();
+}
+
+// Priority the addon gives a chat channel
+static const char* ChannelPriority(const string& channel) {
+    if (channel == "WHISPER") {
+        return "direct";
+    }
+    if (channel == "PARTY" || channel == "RAID" || channel == "GUILD") {
+        return "group";
+    }
+    return "public";
+}
+
+// UnitXP("CET", args...) through the hook; the values it returned
+static const vector<LuaValue>& CallCet(StubLua& lua, initializer_list<const char*> args) {
+    lua.args[0] = "CET";
+    lua.top = 1;
+    for (const char* arg : args) {
+        lua.args[lua.top++] = arg;
+    }
+    lua.results.clear();
+    detoured_UnitXP(&lua);
+    return lua.results;
+}
+
+static double ElapsedMs(Clock::time_point from, Clock::time_point to) {
+    return chrono::duration<double, milli>(to - from).count();
+}
+
+static double Percentile(vector<double>& samples, double fraction) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    size_t index = min<size_t>(samples.size() - 1, static_cast<size_t>(fraction * samples.size()));
+    nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+static void PrintLatency(const char* name, vector<double> samples) {
+    if (samples.empty()) {
+        printf("  %-20s %8s\n", name, "-");
+        return;
+    }
+    double p50 = Percentile(samples, 0.50);
+    double p95 = Percentile(samples, 0.95);
+    double p99 = Percentile(samples, 0.99);
+    double worst = *max_element(samples.begin(), samples.end());
+    printf("  %-20s %8zu %10.1f %10.1f %10.1f %10.1f\n", name, samples.size(), p50, p95, p99, worst);
+}
+
+struct DepthSample {
+    double atMs;
+    size_t depth[PRIORITY_COUNT];
+    size_t outstanding;
+    uint64_t endpointRequests;
+};
+
+static void PrintUsage() {
+    printf("usage: cet_loadgen [options]\n"
+           "  --corpus FILE       chat trace, time_ms<TAB>channel<TAB>sender<TAB>text\n"
+           "  --endpoint URL      translate endpoint; default is an in-process mock server\n"
+           "  --config KEY=VALUE  UnitXP(\"CET\", \"config\", KEY, VALUE) before starting (repeatable)\n"
+           "  --speed X           replay X times faster than the trace (1)\n"
+           "  --loops N           replay the trace N times back to back (1)\n"
+           "  --poll-ms N         addon poll interval (16)\n"
+           "  --sample-ms N       queue depth sample interval (1000)\n"
+           "  --drain-ms N        wait this long for outstanding tickets at the end (30000)\n"
+           "  --log LEVEL         write CET.log next to the binary at debug/info/warning/error\n"
+           "  --trace FILE        record spans and write them to FILE as Chrome trace-event JSON\n");
+    PrintMockOptions();
+}
+
+int main(int argc, char** argv) {
+    LoadgenOptions options;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (ParseMockOption(argc, argv, i, options.mock)) {
+            continue;
+        }
+        if (arg == "--corpus" && i + 1 < argc) {
+            options.corpusPath = argv[++i];
+        } else if (arg == "--endpoint" && i + 1 < argc) {
+            options.endpoint = argv[++i];
+        } else if (arg == "--config" && i + 1 < argc) {
+            string setting = argv[++i];
+            size_t equals = setting.find('=');
+            if (equals == string::npos) {
+                PrintUsage();
+                return 1;
+            }
+            options.config.emplace_back(setting.substr(0, equals), setting.substr(equals + 1));
+        } else if (arg == "--speed" && i + 1 < argc) {
+            options.speed = max(0.001, atof(argv[++i]));
+        } else if (arg == "--loops" && i + 1 < argc) {
+            options.loops = max(1, atoi(argv[++i]));
+        } else if (arg == "--poll-ms" && i + 1 < argc) {
+            options.pollMs = max(1, atoi(argv[++i]));
+        } else if (arg == "--sample-ms" && i + 1 < argc) {
+            options.sampleMs = max(1, atoi(argv[++i]));
+        } else if (arg == "--drain-ms" && i + 1 < argc) {
+            options.drainMs = static_cast<unsigned int>(max(0, atoi(argv[++i])));
+        } else if (arg == "--log" && i + 1 < argc) {
+            options.logLevel = argv[++i];
+        } else if (arg == "--trace" && i + 1 < argc) {
+            options.tracePath = argv[++i];
+        } else {
+            PrintUsage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    vector<TraceMessage> trace;
+    if (!LoadTrace(options.corpusPath, trace)) {
+        fprintf(stderr, "cet_loadgen: cannot read trace %s\n", options.corpusPath.c_str());
+        return 1;
+    }
+    uint32_t traceMs = trace.back().timeMs + 1000;
+
+    MockTranslateServer mock;
+    string endpoint = options.endpoint;
+    if (endpoint.empty()) {
+        if (!mock.Start(options.mock)) {
+            fprintf(stderr, "cet_loadgen: cannot start the mock server\n");
+            return 1;
+        }
+        endpoint = mock.EndpointUrl();
+    }
+
+    // What DllMain and the addon's login do
+    if (!options.logLevel.empty()) {
+        InitializeLogging();
+    }
+    g_translator = make_unique<TranslationClient>();
+    g_translationWorker = make_unique<TranslationWorker>(*g_translator);
+
+    InstallStubLua();
+
+    StubLua lua = {};
+    lua.record = true;
+    vector<pair<string, string>> config = { { "api_endpoint", endpoint }, { "disk_cache_max_bytes", "0" } };
+    if (!options.logLevel.empty()) {
+        config.emplace_back("log_level", options.logLevel);
+    }
+    config.insert(config.end(), options.config.begin(), options.config.end());
+    for (const auto& setting : config) {
+        const vector<LuaValue>& reply = CallCet(lua, { "config", setting.first.c_str(), setting.second.c_str() });
+        if (reply.empty() || reply[0].text.find("error") != string::npos) {
+            fprintf(stderr, "cet_loadgen: %s\n", reply.empty() ? "config failed" : reply[0].text.c_str());
+            return 1;
+        }
+    }
+    const vector<LuaValue>& init = CallCet(lua, { "init_translator", "loadgen-key" });
+    if (init.empty() || init[0].text.find("error") != string::npos) {
+        fprintf(stderr, "cet_loadgen: %s\n", init.empty() ? "init_translator failed" : init[0].text.c_str());
+        return 1;
+    }
+    if (!options.tracePath.empty()) {
+        CallCet(lua, { "trace", "on" });
+    }
+
+    printf("endpoint %s, %zu messages x %u at %.1fx (%.1f s), poll every %u ms\n", endpoint.c_str(), trace.size(),
+           options.loops, options.speed, options.loops * traceMs / options.speed / 1000.0, options.pollMs);
+    fflush(stdout);
+
+    unordered_map<uint32_t, Clock::time_point> outstanding;
+    vector<double> allLatency;      // every translated message, cache hits included
+    vector<double> ticketLatency;   // messages that went through the worker
+    map<string, size_t> failures;
+    vector<DepthSample> timeline;
+    size_t sent = 0, skipped = 0, immediate = 0, rejected = 0, succeeded = 0;
+
+    auto PollAll = [&](Clock::time_point now) {
+        for (;;) {
+            const vector<LuaValue>& reply = CallCet(lua, { "poll" });
+            if (reply.size() < 3 || reply[0].type != LuaValue::Type::Number) {
+                return;
+            }
+            auto found = outstanding.find(static_cast<uint32_t>(reply[0].number));
+            if (found == outstanding.end()) {
+                continue;
+            }
+            double latency = ElapsedMs(found->second, now);
+            outstanding.erase(found);
+            if (reply[1].number != 0.0) {
+                succeeded++;
+                allLatency.push_back(latency);
+                ticketLatency.push_back(latency);
+            } else {
+                failures[reply[2].text]++;
+            }
+        }
+    };
+
+    auto Sample = [&](Clock::time_point start, Clock::time_point now) {
+        SchedulerStats scheduler = g_translationWorker->GetSchedulerStats();
+        DepthSample sample = {};
+        sample.atMs = ElapsedMs(start, now);
+        for (size_t i = 0; i < PRIORITY_COUNT; ++i) {
+            sample.depth[i] = scheduler.classes[i].depth;
+        }
+        sample.outstanding = outstanding.size();
+        sample.endpointRequests = options.endpoint.empty() ? mock.GetStats().requests : 0;
+        timeline.push_back(sample);
+    };
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point nextSample = start;
+    size_t total = trace.size() * options.loops;
+    size_t next = 0;
+    Clock::time_point drainUntil = Clock::time_point::max();
+
+    for (;;) {
+        Clock::time_point now = Clock::now();
+
+        // Messages that have arrived by this frame
+        while (next < total) {
+            const TraceMessage& message = trace[next % trace.size()];
+            double dueMs = ((next / trace.size()) * static_cast<double>(traceMs) + message.timeMs) / options.speed;
+            if (ElapsedMs(start, now) < dueMs) {
+                break;
+            }
+            next++;
+
+            const vector<LuaValue>& detected = CallCet(lua, { "detect", message.text.c_str() });
+            if (detected.empty() || detected[0].type != LuaValue::Type::String) {
+                skipped++;
+                continue;
+            }
+            string fromLang = detected[0].text;
+            const char* toLang = fromLang == "en" ? "zh" : "en";
+
+            sent++;
+            Clock::time_point submitted = Clock::now();
+            const vector<LuaValue>& reply = CallCet(
+                lua, { "translate_async", message.text.c_str(), fromLang.c_str(), toLang,
+                       ChannelPriority(message.channel) });
+            if (reply.empty() || reply[0].type != LuaValue::Type::Number) {
+                rejected++;
+                failures[reply.empty() ? string("no reply") : reply[0].text]++;
+            } else if (reply[0].number == 0.0) {
+                immediate++;
+                succeeded++;
+                allLatency.push_back(ElapsedMs(submitted, Clock::now()));
+            } else {
+                outstanding[static_cast<uint32_t>(reply[0].number)] = submitted;
+            }
+        }
+
+        PollAll(now);
+        if (now >= nextSample) {
+            Sample(start, now);
+            nextSample += chrono::milliseconds(options.sampleMs);
+        }
+
+        if (next >= total) {
+            if (drainUntil == Clock::time_point::max()) {
+                drainUntil = now + chrono::milliseconds(options.drainMs);
+            }
+            if (outstanding.empty() || now >= drainUntil) {
+                break;
+            }
+        }
+        this_thread::sleep_for(chrono::milliseconds(options.pollMs));
+    }
+    Sample(start, Clock::now());
+    double elapsedMs = ElapsedMs(start, Clock::now());
+
+    TranslationMemoryStats memory = g_translator->GetMemoryStats();
+    ResilienceStats resilience = g_translator->GetResilienceStats();
+    SchedulerStats scheduler = g_translationWorker->GetSchedulerStats();
+    const vector<LuaValue>& statsReply = CallCet(lua, { "stats" });
+    string statsLine = statsReply.empty() ? string() : statsReply[0].text;
+    size_t traceEvents = 0;
+    bool traceWritten = !options.tracePath.empty() && ExportTrace(options.tracePath, traceEvents);
+
+    StopMetricsDump();
+    g_translationWorker->Stop();
+    g_translator->Cleanup();
+    mock.Stop();
+    MockServerStats endpointStats = mock.GetStats();
+
+    printf("\nmessages: %zu replayed in %.1f s, %zu sent, %zu not translatable, %zu succeeded, "
+           "%zu answered from cache at submit, %zu rejected, %zu still outstanding\n",
+           total, elapsedMs / 1000.0, sent, skipped, succeeded, immediate, rejected, outstanding.size());
+
+    printf("\nend-to-end latency (ms)     count        p50        p95        p99        max\n");
+    PrintLatency("all messages", allLatency);
+    PrintLatency("worker tickets", ticketLatency);
+
+    printf("\nrequests: attempts=%llu retries=%llu timeouts=%llu hedges=%llu hedge_wins=%llu failed_fast=%llu "
+           "breaker_opens=%llu network p50/p95/p99=%u/%u/%u ms\n",
+           static_cast<unsigned long long>(resilience.attempts), static_cast<unsigned long long>(resilience.retries),
+           static_cast<unsigned long long>(resilience.timeouts), static_cast<unsigned long long>(resilience.hedges),
+           static_cast<unsigned long long>(resilience.hedgeWins),
+           static_cast<unsigned long long>(resilience.failedFast),
+           static_cast<unsigned long long>(resilience.breakerOpens), resilience.p50Ms, resilience.p95Ms,
+           resilience.p99Ms);
+    if (options.endpoint.empty()) {
+        printf("endpoint: requests=%llu texts=%llu throttled=%llu errors=%llu probes=%llu connections=%llu "
+               "bytes_in=%llu bytes_out=%llu (%.2f requests per message sent)\n",
+               static_cast<unsigned long long>(endpointStats.requests),
+               static_cast<unsigned long long>(endpointStats.texts),
+               static_cast<unsigned long long>(endpointStats.throttled),
+               static_cast<unsigned long long>(endpointStats.errors),
+               static_cast<unsigned long long>(endpointStats.probes),
+               static_cast<unsigned long long>(endpointStats.connections),
+               static_cast<unsigned long long>(endpointStats.bytesIn),
+               static_cast<unsigned long long>(endpointStats.bytesOut),
+               sent ? static_cast<double>(endpointStats.requests) / sent : 0.0);
+    }
+    printf("scheduler: batches=%llu throttled=%llu",
+           static_cast<unsigned long long>(scheduler.requests), static_cast<unsigned long long>(scheduler.throttled));
+    for (size_t i = 0; i < PRIORITY_COUNT; ++i) {
+        const SchedulerClassStats& cls = scheduler.classes[i];
+        printf(" %s(submitted=%llu shed=%llu rejected=%llu max_wait=%llums)",
+               PriorityToString(static_cast<TranslationPriority>(i)), static_cast<unsigned long long>(cls.submitted),
+               static_cast<unsigned long long>(cls.shed), static_cast<unsigned long long>(cls.rejected),
+               static_cast<unsigned long long>(cls.maxWaitMs));
+    }
+    printf("\nmemory: messages=%llu message_hits=%llu segments=%llu segment_hits=%llu coalesced=%llu "
+           "negative_hits=%llu local_hits=%llu\n",
+           static_cast<unsigned long long>(memory.messages), static_cast<unsigned long long>(memory.messageHits),
+           static_cast<unsigned long long>(memory.segments), static_cast<unsigned long long>(memory.segmentHits),
+           static_cast<unsigned long long>(memory.coalesced), static_cast<unsigned long long>(memory.negativeHits),
+           static_cast<unsigned long long>(memory.localHits));
+
+    if (!failures.empty()) {
+        printf("\nfailures:\n");
+        for (const auto& failure : failures) {
+            printf("  %6zu  %s\n", failure.second, failure.first.c_str());
+        }
+    }
+
+    printf("\n%s\n", statsLine.c_str());
+    if (traceWritten) {
+        printf("trace: %zu spans written to %s\n", traceEvents, options.tracePath.c_str());
+    } else if (!options.tracePath.empty()) {
+        printf("trace: cannot write %s\n", options.tracePath.c_str());
+    }
+
+    // At most about 40 rows; every step-th sample plus the last
+    printf("\nqueue depth          t(s)   direct    group   public  outstanding  endpoint_requests\n");
+    size_t step = max<size_t>(1, (timeline.size() + 39) / 40);
+    for (size_t i = 0; i < timeline.size(); ++i) {
+        if (i % step != 0 && i + 1 != timeline.size()) {
+            continue;
+        }
+        const DepthSample& sample = timeline[i];
+        printf("                 %8.1f %8zu %8zu %8zu %12zu %18llu\n", sample.atMs / 1000.0, sample.depth[0],
+               sample.depth[1], sample.depth[2], sample.outstanding,
+               static_cast<unsigned long long>(sample.endpointRequests));
+    }
+
+    g_translationWorker.reset();
+    g_translator.reset();
+    if (!options.logLevel.empty()) {
+        StopLogWriter();
+        CleanupLogging();
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+// cet_mock_server.cpp - Standalone mock translate endpoint for CET load tests
+// Point api_endpoint (or cet_loadgen --endpoint) at the URL it prints.
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <chrono>
+#include <thread>
+
+#include "mock_server.h"
+
+using namespace std;
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void OnSignal(int) {
+    g_stop = 1;
+}
+
+int main(int argc, char** argv) {
+    MockServerOptions options;
+    options.port = 8089;
+
+    for (int i = 1; i < argc; ++i) {
+        if (ParseMockOption(argc, argv, i, options)) {
+            continue;
+        }
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            options.port = static_cast<uint16_t>(atoi(argv[++i]));
+        } else {
+            printf("usage: cet_mock_server [--port N]\n"
+                   "  --port N            listen on 127.0.0.1:N, 0 = any free port (8089)\n");
+            PrintMockOptions();
+            return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    MockTranslateServer server;
+    if (!server.Start(options)) {
+        fprintf(stderr, "cannot listen on 127.0.0.1:%u\n", options.port);
+        return 1;
+    }
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    printf("listening on %s\n", server.EndpointUrl().c_str());
+    fflush(stdout);
+
+    while (!g_stop) {
+        this_thread::sleep_for(chrono::milliseconds(100));
+    }
+    server.Stop();
+
+    MockServerStats stats = server.GetStats();
+    printf("connections=%llu requests=%llu texts=%llu throttled=%llu errors=%llu probes=%llu "
+           "bytes_in=%llu bytes_out=%llu\n",
+           static_cast<unsigned long long>(stats.connections), static_cast<unsigned long long>(stats.requests),
+           static_cast<unsigned long long>(stats.texts), static_cast<unsigned long long>(stats.throttled),
+           static_cast<unsigned long long>(stats.errors), static_cast<unsigned long long>(stats.probes),
+           static_cast<unsigned long long>(stats.bytesIn), static_cast<unsigned long long>(stats.bytesOut));
+    return 0;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <initializer_list>
+#include <cstdlib>
+#include <cstddef>
+
+#include "../include/lua_interface.h"
+
+// Stub Lua API for driving the UnitXP bridge outside the game: arguments
+// come from args, and pushed values are counted. With record set they are
+// also kept in results, which allocates, so the microbenchmarks leave it off.
+struct LuaValue {
+    enum class Type { Nil, Boolean, Number, String } type;
+    double number;
+    std::string text;
+};
+
+struct StubLua {
+    const char* args[8];
+    int top;
+    size_t pushes;
+    bool record;
+    std::vector<LuaValue> results;
+};
+
+static void StubPush(void* L, LuaValue::Type type, double number, const char* text) {
+    StubLua* lua = static_cast<StubLua*>(L);
+    lua->pushes++;
+    if (lua->record) {
+        lua->results.push_back(LuaValue{ type, number, text ? text : "" });
+    }
+}
+
+static void* __fastcall StubGetContext() { return nullptr; }
+static void __fastcall StubPushString(void* L, const char* s) { StubPush(L, LuaValue::Type::String, 0.0, s); }
+static void __fastcall StubPushBoolean(void* L, int value) {
+    StubPush(L, LuaValue::Type::Boolean, value ? 1.0 : 0.0, nullptr);
+}
+static void __fastcall StubPushNumber(void* L, double value) { StubPush(L, LuaValue::Type::Number, value, nullptr); }
+static void __fastcall StubPushNil(void* L) { StubPush(L, LuaValue::Type::Nil, 0.0, nullptr); }
+static const char* __fastcall StubToString(void* L, int index) {
+    StubLua* lua = static_cast<StubLua*>(L);
+    return index >= 1 && index <= lua->top ? lua->args[index - 1] : nullptr;
+}
+static double __fastcall StubToNumber(void* L, int index) {
+    const char* text = StubToString(L, index);
+    return text ? atof(text) : 0.0;
+}
+static int __fastcall StubToBoolean(void* L, int index) { return StubToString(L, index) != nullptr; }
+static int __fastcall StubGetTop(void* L) { return static_cast<StubLua*>(L)->top; }
+static int __fastcall StubIsNumber(void* L, int index) {
+    const char* text = StubToString(L, index);
+    if (!text || !*text) {
+        return 0;
+    }
+    char* end = nullptr;
+    strtod(text, &end);
+    return *end == '\0';
+}
+static int __fastcall StubIsString(void* L, int index) { return StubToString(L, index) != nullptr; }
+static int __fastcall StubUnitXP(void*) { return 0; }
+
+// The arguments of a UnitXP(args...) call, at most eight
+static inline void SetStubArgs(StubLua& lua, std::initializer_list<const char*> args) {
+    lua.top = 0;
+    for (const char* arg : args) {
+        lua.args[lua.top++] = arg;
+    }
+}
+
+// Point the bridge at the stubs; UnitXP calls for other addons return nothing
+static inline void InstallStubLua() {
+    LuaApi api = { StubGetContext, StubPushString, StubPushBoolean, StubPushNumber, StubPushNil, StubToString,
+                   StubToNumber, StubToBoolean, StubGetTop, StubIsNumber, StubIsString };
+    SetLuaApi(api);
+    g_originalUnitXP = StubUnitXP;
+}
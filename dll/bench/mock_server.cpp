@@ -0,0 +1,465 @@
+// mock_server.cpp - Local mock of the Google Translate v2 endpoint for CET load tests
+// Answers translate requests with configurable latency, errors and 429s
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "mock_server.h"
+#include "../include/request_builder.h"
+
+using namespace std;
+
+static const size_t MAX_REQUEST_HEAD = 64 * 1024;
+static const size_t MAX_REQUEST_BODY = 1024 * 1024;
+
+bool ParseMockOption(int argc, char** argv, int& i, MockServerOptions& options) {
+    if (i + 1 >= argc) {
+        return false;
+    }
+    string arg = argv[i];
+    const char* value = argv[i + 1];
+
+    if (arg == "--latency-ms") {
+        options.latencyMs = static_cast<unsigned int>(strtoul(value, nullptr, 10));
+    } else if (arg == "--jitter-ms") {
+        options.jitterMs = static_cast<unsigned int>(strtoul(value, nullptr, 10));
+    } else if (arg == "--slow-rate") {
+        options.slowRate = atof(value);
+    } else if (arg == "--slow-ms") {
+        options.slowMs = static_cast<unsigned int>(strtoul(value, nullptr, 10));
+    } else if (arg == "--error-rate") {
+        options.errorRate = atof(value);
+    } else if (arg == "--throttle-rate") {
+        options.throttleRate = atof(value);
+    } else if (arg == "--rate-limit") {
+        options.rateLimit = static_cast<unsigned int>(strtoul(value, nullptr, 10));
+    } else if (arg == "--seed") {
+        options.seed = static_cast<unsigned int>(strtoul(value, nullptr, 10));
+    } else {
+        return false;
+    }
+    ++i;
+    return true;
+}
+
+void PrintMockOptions() {
+    MockServerOptions defaults;
+    printf("mock server:\n"
+           "  --latency-ms N      service time per request (%u)\n"
+           "  --jitter-ms N       plus uniform 0..N ms (%u)\n"
+           "  --slow-rate X       share of requests that are slow (%.2f)\n"
+           "  --slow-ms N         extra time of a slow request (%u)\n"
+           "  --error-rate X      share answered with HTTP 500 (%.2f)\n"
+           "  --throttle-rate X   share answered with HTTP 429 (%.2f)\n"
+           "  --rate-limit N      requests per second before 429s, 0 = none (%u)\n"
+           "  --seed N            random seed (%u)\n",
+           defaults.latencyMs, defaults.jitterMs, defaults.slowRate, defaults.slowMs, defaults.errorRate,
+           defaults.throttleRate, defaults.rateLimit, defaults.seed);
+}
+
+// Decode the JSON string starting after the opening quote at pos; pos ends
+// after the closing quote. \u escapes, surrogate pairs included, become UTF-8.
+static bool ReadJsonString(const string& json, size_t& pos, string& out) {
+    out.clear();
+    while (pos < json.size()) {
+        char c = json[pos++];
+        if (c == '"') {
+            return true;
+        }
+        if (c != '\\') {
+            out += c;
+            continue;
+        }
+        if (pos >= json.size()) {
+            return false;
+        }
+        char escape = json[pos++];
+        switch (escape) {
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'u': {
+                if (pos + 4 > json.size()) {
+                    return false;
+                }
+                uint32_t codepoint = static_cast<uint32_t>(strtoul(json.substr(pos, 4).c_str(), nullptr, 16));
+                pos += 4;
+                if (codepoint >= 0xD800 && codepoint < 0xDC00 && pos + 6 <= json.size() &&
+                    json.compare(pos, 2, "\\u") == 0) {
+                    uint32_t low = static_cast<uint32_t>(strtoul(json.substr(pos + 2, 4).c_str(), nullptr, 16));
+                    if (low >= 0xDC00 && low < 0xE000) {
+                        codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                        pos += 6;
+                    }
+                }
+                if (codepoint < 0x80) {
+                    out += static_cast<char>(codepoint);
+                } else if (codepoint < 0x800) {
+                    out += static_cast<char>(0xC0 | (codepoint >> 6));
+                    out += static_cast<char>(0x80 | (codepoint & 0x3F));
+                } else if (codepoint < 0x10000) {
+                    out += static_cast<char>(0xE0 | (codepoint >> 12));
+                    out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (codepoint & 0x3F));
+                } else {
+                    out += static_cast<char>(0xF0 | (codepoint >> 18));
+                    out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+                    out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (codepoint & 0x3F));
+                }
+                break;
+            }
+            default: out += escape; break;     // \" \\ \/
+        }
+    }
+    return false;
+}
+
+// Position just after "key": in a flat JSON object, or npos
+static size_t FindValue(const string& json, const char* key) {
+    string quoted = string("\"") + key + "\"";
+    size_t pos = json.find(quoted);
+    if (pos == string::npos) {
+        return string::npos;
+    }
+    pos = json.find(':', pos + quoted.size());
+    if (pos == string::npos) {
+        return string::npos;
+    }
+    return json.find_first_not_of(" \t\r\n", pos + 1);
+}
+
+// The "q" texts (a string or an array of strings) and "target" of a request body
+static bool ParseTranslateRequest(const string& json, vector<string>& texts, string& target) {
+    texts.clear();
+    target.clear();
+
+    size_t pos = FindValue(json, "target");
+    if (pos != string::npos && json[pos] == '"') {
+        ++pos;
+        ReadJsonString(json, pos, target);
+    }
+
+    pos = FindValue(json, "q");
+    if (pos == string::npos) {
+        return false;
+    }
+    string text;
+    if (json[pos] == '"') {
+        ++pos;
+        if (!ReadJsonString(json, pos, text)) {
+            return false;
+        }
+        texts.push_back(text);
+        return true;
+    }
+    if (json[pos] != '[') {
+        return false;
+    }
+    for (++pos; pos < json.size();) {
+        pos = json.find_first_not_of(" \t\r\n,", pos);
+        if (pos == string::npos) {
+            return false;
+        }
+        if (json[pos] == ']') {
+            return !texts.empty();
+        }
+        if (json[pos] != '"') {
+            return false;
+        }
+        ++pos;
+        if (!ReadJsonString(json, pos, text)) {
+            return false;
+        }
+        texts.push_back(text);
+    }
+    return false;
+}
+
+static bool SendAll(int socket, const string& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t sent = send(socket, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        done += static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+static const char* StatusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 429: return "Too Many Requests";
+        default: return "Internal Server Error";
+    }
+}
+
+MockTranslateServer::MockTranslateServer() : listenSocket(-1), boundPort(0), stopping(false) {
+}
+
+MockTranslateServer::~MockTranslateServer() {
+    Stop();
+}
+
+bool MockTranslateServer::Start(const MockServerOptions& serverOptions) {
+    Stop();
+    options = serverOptions;
+    random.seed(options.seed);
+    stats = MockServerStats();
+    if (options.rateLimit > 0) {
+        rateBucket.Configure(options.rateLimit, options.rateLimit);
+    }
+
+    listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenSocket < 0) {
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(options.port);
+    socklen_t length = sizeof(address);
+    if (bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listenSocket, 64) != 0 ||
+        getsockname(listenSocket, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        close(listenSocket);
+        listenSocket = -1;
+        return false;
+    }
+    boundPort = ntohs(address.sin_port);
+
+    stopping = false;
+    acceptThread = thread(&MockTranslateServer::AcceptLoop, this);
+    return true;
+}
+
+void MockTranslateServer::Stop() {
+    if (listenSocket < 0) {
+        return;
+    }
+
+    // Shutting the sockets down wakes the threads blocked on them
+    stopping = true;
+    shutdown(listenSocket, SHUT_RDWR);
+    if (acceptThread.joinable()) {
+        acceptThread.join();
+    }
+    {
+        lock_guard<mutex> lock(stateMutex);
+        for (int socket : connectionSockets) {
+            shutdown(socket, SHUT_RDWR);
+        }
+    }
+    for (thread& connection : connectionThreads) {
+        connection.join();
+    }
+    connectionThreads.clear();
+    for (int socket : connectionSockets) {
+        close(socket);
+    }
+    connectionSockets.clear();
+
+    close(listenSocket);
+    listenSocket = -1;
+}
+
+string MockTranslateServer::EndpointUrl() const {
+    return "http://127.0.0.1:" + to_string(boundPort) + "/language/translate/v2";
+}
+
+MockServerStats MockTranslateServer::GetStats() {
+    lock_guard<mutex> lock(stateMutex);
+    return stats;
+}
+
+void MockTranslateServer::AcceptLoop() {
+    while (!stopping) {
+        int socket = accept(listenSocket, nullptr, nullptr);
+        if (socket < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        int noDelay = 1;
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        lock_guard<mutex> lock(stateMutex);
+        if (stopping) {
+            close(socket);
+            break;
+        }
+        stats.connections++;
+        connectionSockets.push_back(socket);
+        connectionThreads.emplace_back(&MockTranslateServer::Serve, this, socket);
+    }
+}
+
+int MockTranslateServer::Answer(const string& request, string& body, unsigned int& delayMs) {
+    vector<string> texts;
+    string target;
+    bool valid = ParseTranslateRequest(request, texts, target);
+
+    int status = 200;
+    {
+        lock_guard<mutex> lock(stateMutex);
+        uniform_real_distribution<double> chance(0.0, 1.0);
+        delayMs = options.latencyMs;
+        if (options.jitterMs > 0) {
+            delayMs += uniform_int_distribution<unsigned int>(0, options.jitterMs)(random);
+        }
+        if (chance(random) < options.slowRate) {
+            delayMs += options.slowMs;
+        }
+
+        stats.requests++;
+        auto now = chrono::steady_clock::now();
+        if (!valid) {
+            status = 400;
+        } else if (options.rateLimit > 0 && rateBucket.Available(now) < 1) {
+            status = 429;
+        } else if (chance(random) < options.throttleRate) {
+            status = 429;
+        } else if (chance(random) < options.errorRate) {
+            status = 500;
+        }
+
+        if (options.rateLimit > 0 && status != 400) {
+            rateBucket.Consume(1, now);
+        }
+        if (status == 429) {
+            stats.throttled++;
+            delayMs = min<unsigned int>(delayMs, 10);     // quota checks answer fast
+        } else if (status == 500 || status == 400) {
+            stats.errors++;
+        } else {
+            stats.texts += texts.size();
+        }
+    }
+
+    if (status != 200) {
+        body = "{\n  \"error\": {\n    \"code\": " + to_string(status) + ",\n    \"message\": \"" +
+               (status == 429 ? "Rate Limit Exceeded" : status == 400 ? "Invalid request" : "Backend Error") +
+               "\"\n  }\n}\n";
+        return status;
+    }
+
+    body = "{\n  \"data\": {\n    \"translations\": [\n";
+    for (size_t i = 0; i < texts.size(); ++i) {
+        body += "      {\n        \"translatedText\": \"";
+        AppendJsonEscaped(body, "[" + target + "] ");
+        AppendJsonEscaped(body, texts[i]);
+        body += i + 1 < texts.size() ? "\"\n      },\n" : "\"\n      }\n";
+    }
+    body += "    ]\n  }\n}\n";
+    return 200;
+}
+
+void MockTranslateServer::Serve(int socket) {
+    string buffer;
+    char chunk[8192];
+
+    while (!stopping) {
+        // Request head
+        size_t headEnd;
+        while ((headEnd = buffer.find("\r\n\r\n")) == string::npos) {
+            ssize_t received = recv(socket, chunk, sizeof(chunk), 0);
+            if (received <= 0 || buffer.size() > MAX_REQUEST_HEAD) {
+                return;
+            }
+            buffer.append(chunk, static_cast<size_t>(received));
+        }
+        string head = buffer.substr(0, headEnd + 2);
+        buffer.erase(0, headEnd + 4);
+
+        size_t contentLength = 0;
+        bool keepAlive = head.find(" HTTP/1.0\r\n") == string::npos;
+        for (size_t lineStart = head.find("\r\n") + 2; lineStart < head.size();) {
+            size_t lineEnd = head.find("\r\n", lineStart);
+            string line = head.substr(lineStart, lineEnd - lineStart);
+            lineStart = lineEnd + 2;
+            for (size_t i = 0; i < line.size() && line[i] != ':'; ++i) {
+                line[i] = static_cast<char>(tolower(static_cast<unsigned char>(line[i])));
+            }
+            if (line.compare(0, 15, "content-length:") == 0) {
+                contentLength = strtoul(line.c_str() + 15, nullptr, 10);
+            } else if (line.compare(0, 11, "connection:") == 0 && line.find("close") != string::npos) {
+                keepAlive = false;
+            }
+        }
+        if (contentLength > MAX_REQUEST_BODY) {
+            return;
+        }
+
+        while (buffer.size() < contentLength) {
+            ssize_t received = recv(socket, chunk, sizeof(chunk), 0);
+            if (received <= 0) {
+                return;
+            }
+            buffer.append(chunk, static_cast<size_t>(received));
+        }
+        string request = buffer.substr(0, contentLength);
+        buffer.erase(0, contentLength);
+
+        string body;
+        int status = 404;
+        unsigned int delayMs = 0;
+        bool headOnly = head.compare(0, 5, "HEAD ") == 0;
+        if (headOnly) {
+            lock_guard<mutex> lock(stateMutex);
+            stats.probes++;
+            status = 200;
+        } else if (head.compare(0, 5, "POST ") == 0) {
+            status = Answer(request, body, delayMs);
+        }
+
+        if (delayMs > 0) {
+            this_thread::sleep_for(chrono::milliseconds(delayMs));
+        }
+
+        string response = "HTTP/1.1 " + to_string(status) + " " + StatusText(status) +
+                          "\r\nContent-Type: application/json; charset=UTF-8\r\nContent-Length: " +
+                          to_string(body.size()) + (keepAlive ? "\r\n" : "\r\nConnection: close\r\n") + "\r\n";
+        if (!headOnly) {
+            response += body;
+        }
+        if (!SendAll(socket, response)) {
+            return;
+        }
+
+        {
+            lock_guard<mutex> lock(stateMutex);
+            stats.bytesIn += head.size() + 2 + request.size();
+            stats.bytesOut += response.size();
+        }
+        if (!keepAlive) {
+            shutdown(socket, SHUT_WR);
+            return;
+        }
+    }
+}
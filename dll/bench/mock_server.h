@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <cstdint>
+
+#include "../include/scheduler.h"
+
+// Behaviour of the mock translate endpoint
+struct MockServerOptions {
+    uint16_t port;              // 0 picks a free port
+    unsigned int latencyMs;     // service time of every request
+    unsigned int jitterMs;      // plus a uniformly random 0..jitterMs
+    double slowRate;            // share of requests that take slowMs longer
+    unsigned int slowMs;
+    double errorRate;           // share answered with HTTP 500
+    double throttleRate;        // share answered with HTTP 429
+    unsigned int rateLimit;     // requests per second before 429s; 0 = no limit
+    unsigned int seed;
+
+    MockServerOptions()
+        : port(0), latencyMs(80), jitterMs(40), slowRate(0.02), slowMs(600), errorRate(0.0), throttleRate(0.0),
+          rateLimit(0), seed(1) {}
+};
+
+struct MockServerStats {
+    uint64_t connections;
+    uint64_t requests;          // POSTs, whatever the answer
+    uint64_t texts;             // "q" values in successful answers
+    uint64_t throttled;
+    uint64_t errors;
+    uint64_t probes;            // HEAD requests
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+
+    MockServerStats()
+        : connections(0), requests(0), texts(0), throttled(0), errors(0), probes(0), bytesIn(0), bytesOut(0) {}
+};
+
+// Parse one of the mock server's command line options at argv[i]
+// (--latency-ms, --jitter-ms, --slow-rate, --slow-ms, --error-rate,
+// --throttle-rate, --rate-limit, --seed), advancing i past its value.
+// False if argv[i] is not one of them.
+bool ParseMockOption(int argc, char** argv, int& i, MockServerOptions& options);
+void PrintMockOptions();
+
+// Local stand-in for the Google Translate v2 endpoint: HTTP/1.1 with
+// keep-alive on 127.0.0.1, one thread per connection. A POST answers its
+// "q" texts in the v2 response format, each "translated" as
+// "[<target>] <text>" so placeholders survive, after the configured delay;
+// HEAD answers the connection pool's keep-alive probes.
+class MockTranslateServer {
+private:
+    MockServerOptions options;
+    int listenSocket;
+    uint16_t boundPort;
+    std::thread acceptThread;
+    std::vector<std::thread> connectionThreads;
+    std::vector<int> connectionSockets;
+    std::atomic<bool> stopping;
+
+    std::mutex stateMutex;      // guards everything below
+    std::mt19937 random;
+    TokenBucket rateBucket;
+    MockServerStats stats;
+
+    void AcceptLoop();
+    void Serve(int socket);
+    // Status code and body for one POST body; sets delayMs
+    int Answer(const std::string& request, std::string& body, unsigned int& delayMs);
+
+public:
+    MockTranslateServer();
+    ~MockTranslateServer();
+
+    MockTranslateServer(const MockTranslateServer&) = delete;
+    MockTranslateServer& operator=(const MockTranslateServer&) = delete;
+
+    bool Start(const MockServerOptions& serverOptions);
+    void Stop();
+
+    uint16_t Port() const { return boundPort; }
+    // http://127.0.0.1:<port>/language/translate/v2
+    std::string EndpointUrl() const;
+    MockServerStats GetStats();
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// A match of pattern at text[start, start + length)
+struct PatternMatch {
+    size_t start;
+    size_t length;
+    uint32_t pattern;
+};
+
+// Multi-pattern matcher: an Aho-Corasick automaton over bytes, so UTF-8
+// patterns need no special handling. Patterns are added first, then Build()
+// computes the failure links; a scan then costs one state transition per
+// input byte however many patterns there are. ASCII case folding is
+// optional. Not thread-safe while building; read-only afterwards.
+class AhoCorasick {
+private:
+    struct Node {
+        uint32_t firstEdge;     // edges[firstEdge, firstEdge + edgeCount), sorted by byte
+        uint32_t edgeCount;
+        uint32_t fail;
+        uint32_t output;        // pattern ending here, NO_MATCH if none
+        uint32_t nextOutput;    // nearest node on the fail chain with an output
+    };
+
+    struct Edge {
+        uint8_t byte;
+        uint32_t target;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<Edge> edges;
+    std::vector<std::vector<Edge>> building;    // per-node edges, kept so Add() works after Build()
+    std::vector<uint32_t> patternLengths;
+    uint32_t rootNext[256];                     // root transitions, dense
+    bool foldCase;
+    bool built;
+
+    static constexpr uint32_t ROOT = 0;
+
+    uint8_t Fold(char c) const;
+    uint32_t Child(uint32_t node, uint8_t byte) const;
+    uint32_t Step(uint32_t state, uint8_t byte) const;
+
+public:
+    explicit AhoCorasick(bool foldAsciiCase = false);
+
+    // Id of the pattern; adding a pattern again returns its existing id.
+    // Empty patterns are ignored and return NO_MATCH.
+    uint32_t Add(std::string_view pattern);
+    void Build();
+    void Clear();
+
+    size_t PatternCount() const { return patternLengths.size(); }
+    size_t NodeCount() const { return nodes.size(); }
+    bool IsBuilt() const { return built; }
+
+    // Optional filter for candidate matches, e.g. to require word boundaries
+    typedef bool (*MatchFilter)(std::string_view text, size_t start, size_t length);
+
+    // Leftmost-longest, non-overlapping matches in text order. matches is
+    // overwritten; its storage is reused between calls.
+    void FindLongest(std::string_view text, std::vector<PatternMatch>& matches,
+                     MatchFilter accept = nullptr) const;
+
+    static constexpr uint32_t NO_MATCH = 0xFFFFFFFF;
+};
+
+// MatchFilter for whole words: "lfg" does not match inside "wolfgang".
+// Only ASCII letters, digits and ' make up words, so CJK text has no
+// boundaries to respect.
+bool OnWordBoundary(std::string_view text, size_t start, size_t length);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+// Fixed-size translation cache key: a 128-bit hash of the normalized text
+// plus compact ids for the language pair. Messages that only differ in
+// spacing or ASCII letter case share one key. Color codes stay part of it:
+// with masking on they are placeholders by now, and with masking off the
+// translation has to carry them, so a colored and a plain message differ.
+struct CacheKey {
+    uint64_t hashHigh;
+    uint64_t hashLow;
+    uint16_t fromLanguage;
+    uint16_t toLanguage;
+
+    bool operator==(const CacheKey& other) const {
+        return hashHigh == other.hashHigh && hashLow == other.hashLow &&
+               fromLanguage == other.fromLanguage && toLanguage == other.toLanguage;
+    }
+    bool operator!=(const CacheKey& other) const { return !(*this == other); }
+};
+
+struct CacheKeyHash {
+    size_t operator()(const CacheKey& key) const { return static_cast<size_t>(key.hashLow); }
+};
+
+// Size of a key in its serialized (on-disk) form
+static const size_t CACHE_KEY_BYTES = 20;
+
+CacheKey MakeCacheKey(std::string_view text, std::string_view fromLang, std::string_view toLang);
+
+// Normalized form that feeds the hash: whitespace runs collapsed to one
+// space and trimmed, ASCII letters lowercased
+std::string CanonicalizeText(std::string_view text);
+
+// Small stable id for a language code; codes outside the built-in table get
+// a hashed id with the top bit set
+uint16_t LanguageId(std::string_view code);
+
+// Little-endian serialization used as the key of the persistent cache
+std::string SerializeCacheKey(const CacheKey& key);
@@ -0,0 +1,92 @@
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+#include "mapped_file.h"
+
+// Persistent translation cache backed by an append-only file.
+//
+// Layout: a 16 byte header ("CETC", format version, reserved) followed by
+// records of { keyLength, valueLength, checksum, key, value }. A later record
+// for the same key supersedes earlier ones.
+//
+// Open() returns immediately; the file is memory-mapped and indexed on a
+// background thread, so nothing is read during DLL attach and lookups simply
+// miss until the index is ready. Values that were on disk at startup are
+// copied straight out of the mapping; records appended during the session
+// are read back through the file handle. The file is rewritten without
+// superseded records once they outweigh the live ones, or when it grows past
+// its size limit (oldest records are dropped first).
+class CacheStore {
+private:
+    struct Location {
+        uint64_t offset;     // Start of the record header
+        uint32_t keyLength;
+        uint32_t valueLength;
+    };
+
+    std::string path;
+    MappedFile mapping;
+#ifdef _WIN32
+    HANDLE hWrite;
+#else
+    int hWrite;             // file descriptor, -1 when closed
+#endif
+    std::unordered_map<uint64_t, Location> index;
+    mutable std::mutex storeMutex;
+    std::thread loaderThread;
+    std::atomic<bool> loaded;
+
+    uint64_t fileBytes;     // End of the last valid record
+    uint64_t liveBytes;     // Bytes taken by records still referenced by the index
+    size_t maxBytes;
+    unsigned appendsSinceCheck;
+
+    static const uint32_t FORMAT_VERSION = 3;     // also bumped when key normalization changes
+    static const size_t HEADER_SIZE = 16;
+    static const size_t RECORD_HEADER_SIZE = 12;
+    static const uint32_t MAX_FIELD_LENGTH = 64 * 1024;
+    static const unsigned COMPACTION_CHECK_INTERVAL = 256;
+
+    void Load();
+    bool BuildIndex(std::unordered_map<uint64_t, Location>& newIndex, uint64_t& validEnd, uint64_t& live);
+    bool OpenForAppend();
+    bool ReadRecord(const Location& location, std::string& key, std::string& value);
+    bool LookupLocked(std::string_view key, std::string& value);
+    bool NeedsCompaction() const;
+    void CompactLocked();
+    void CloseLocked();
+    static uint64_t RecordSize(const Location& location);
+    static void EncodeRecord(std::string& buffer, std::string_view key, std::string_view value);
+    static uint64_t HashKey(std::string_view key);
+    static uint32_t Checksum(std::string_view key, std::string_view value);
+
+public:
+    CacheStore();
+    ~CacheStore();
+
+    CacheStore(const CacheStore&) = delete;
+    CacheStore& operator=(const CacheStore&) = delete;
+
+    // Start loading path in the background; a missing file is created
+    void Open(const std::string& filePath, size_t maxFileBytes);
+    void Close();
+
+    bool Lookup(std::string_view key, std::string& value);
+    // Non-blocking variant for the game thread: misses if the store is busy
+    bool TryLookup(std::string_view key, std::string& value);
+    void Append(const std::string& key, const std::string& value);
+
+    void SetMaxBytes(size_t maxFileBytes);
+    bool IsLoaded() const { return loaded; }
+    size_t Size() const;
+};
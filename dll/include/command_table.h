@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+// A CET subcommand: UnitXP("CET", name, ...) calls handler with the Lua
+// state, and handler returns the number of values it pushed. name is a
+// string literal, so name.data() can also serve as a trace span name.
+struct CetCommand {
+    std::string_view name;
+    int (*handler)(void* L);
+};
+
+// Subcommand lookup table. Names are placed in Slots buckets by a seeded
+// FNV-1a hash; the seed is searched for at compile time so that no two
+// names share a bucket, and a lookup is one hash and one compare. Declare
+// tables constexpr and static_assert IsValid().
+template <size_t Count, size_t Slots = 32>
+class CommandTable {
+    static_assert((Slots & (Slots - 1)) == 0 && Slots > Count, "Slots must be a power of two above Count");
+
+private:
+    const CetCommand* commands;
+    uint32_t seed;
+    uint8_t entry[Slots];       // index into commands plus one (0 = empty)
+
+    static constexpr uint32_t NO_SEED = 0xFFFFFFFF;
+    static constexpr uint32_t MAX_SEED = 10000;
+
+    static constexpr uint32_t Hash(std::string_view name, uint32_t hashSeed) {
+        uint32_t hash = 2166136261u ^ hashSeed;
+        for (char c : name) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+        }
+        return hash ^ (hash >> 16);
+    }
+
+    static constexpr bool IsPerfect(const CetCommand (&table)[Count], uint32_t candidate) {
+        bool used[Slots] = {};
+        for (size_t i = 0; i < Count; ++i) {
+            size_t slot = Hash(table[i].name, candidate) & (Slots - 1);
+            if (used[slot]) {
+                return false;
+            }
+            used[slot] = true;
+        }
+        return true;
+    }
+
+public:
+    constexpr explicit CommandTable(const CetCommand (&table)[Count]) : commands(table), seed(NO_SEED), entry() {
+        for (uint32_t candidate = 0; candidate < MAX_SEED && seed == NO_SEED; ++candidate) {
+            if (IsPerfect(table, candidate)) {
+                seed = candidate;
+            }
+        }
+        if (seed == NO_SEED) {
+            return;
+        }
+        for (size_t i = 0; i < Count; ++i) {
+            entry[Hash(table[i].name, seed) & (Slots - 1)] = static_cast<uint8_t>(i + 1);
+        }
+    }
+
+    constexpr bool IsValid() const { return seed != NO_SEED; }
+
+    const CetCommand* Find(std::string_view name) const {
+        uint8_t index = entry[Hash(name, seed) & (Slots - 1)];
+        if (index == 0 || commands[index - 1].name != name) {
+            return nullptr;
+        }
+        return &commands[index - 1];
+    }
+};
@@ -0,0 +1,156 @@
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#include <winhttp.h>
+#endif
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <cstdint>
+
+// Counters describing pool behaviour; connectionsOpened is the number of
+// TCP connections made to the server, each of which costs a TLS handshake
+struct ConnectionPoolStats {
+    unsigned long connectionsOpened;
+    unsigned long warmups;
+    unsigned long probes;
+    unsigned long requests;
+    unsigned long failures;
+    uint32_t firstRequestMs;
+
+    ConnectionPoolStats()
+        : connectionsOpened(0), warmups(0), probes(0), requests(0), failures(0), firstRequestMs(0) {}
+};
+
+// Deadline and cancellation for one Post. Cancel() may be called from any
+// thread: it closes the request handle (shuts down the socket), which makes
+// the blocking call in progress fail.
+class PostControl {
+private:
+    std::mutex controlMutex;
+#ifdef _WIN32
+    HINTERNET hRequest;
+    bool inCall;            // the owner is blocked in a WinHTTP call on hRequest
+#else
+    int requestSocket;      // socket the request is using, -1 if none
+#endif
+    bool cancelled;
+    bool timedOut;
+
+    friend class ConnectionPool;
+
+public:
+    const uint32_t timeoutMs;     // whole request, including the wait for a connection
+
+    explicit PostControl(uint32_t timeoutMilliseconds);
+
+    void Cancel();
+    bool Cancelled();
+    bool TimedOut();
+};
+
+// Small pool of persistent connections to the translation endpoint.
+// Every slot owns its own session so each keeps a separate keep-alive socket;
+// a maintenance thread warms the slots (DNS + TLS) after Open() and sends a
+// cheap HEAD probe on slots that have been idle for the keep-alive interval.
+// Windows uses WinHTTP. Elsewhere requests are plain HTTP/1.1 over sockets,
+// without TLS, which is enough for local endpoints in tools and load tests.
+class ConnectionPool {
+public:
+    // Receives response body chunks as they are read
+    typedef std::function<void(const char* data, size_t size)> ResponseSink;
+
+private:
+    struct Connection {
+#ifdef _WIN32
+        HINTERNET hSession;
+        HINTERNET hConnect;
+#else
+        int socket;         // connected lazily, -1 until then
+#endif
+        uint32_t lastUsed;
+        bool busy;
+
+#ifdef _WIN32
+        Connection() : hSession(nullptr), hConnect(nullptr), lastUsed(0), busy(false) {}
+#else
+        Connection() : socket(-1), lastUsed(0), busy(false) {}
+#endif
+    };
+
+    std::vector<Connection> connections;
+    std::mutex poolMutex;
+    std::condition_variable available;
+    std::condition_variable maintenanceWakeup;
+    std::thread maintenanceThread;
+    bool stopRequested;
+    // The maintenance thread's in-flight probe, cancelled by Close()
+    PostControl* probeControl;
+
+#ifdef _WIN32
+    std::wstring host;
+    INTERNET_PORT port;
+#else
+    std::string host;
+    uint16_t port;
+#endif
+    std::string path;
+    bool secure;
+    uint32_t keepAliveMs;
+
+    ConnectionPoolStats stats;
+    bool firstRequestDone;
+
+    // Platform parts, in the _WIN32 and socket halves of connection_pool.cpp
+    bool ParseEndpoint(const std::string& url);
+    bool OpenConnection(Connection& connection);
+    void CloseConnection(Connection& connection);
+    // One request on an acquired connection; sink may be null for HEAD
+    bool Exchange(Connection& connection, const char* method, const std::string& pathAndQuery,
+                  const std::string& body, const ResponseSink* sink, uint32_t& statusCode,
+                  PostControl* control, uint32_t deadline);
+    bool Probe(Connection& connection, PostControl& control);
+    // Publish the request's handle so PostControl::Cancel can close it
+#ifdef _WIN32
+    bool Attach(PostControl* control, HINTERNET hRequest);
+    void CloseRequest(PostControl* control, HINTERNET hRequest);
+    // Bracket each blocking call on the request; EnterCall is false once
+    // the control was cancelled, and the handle must not be used again
+    bool EnterCall(PostControl* control);
+    void LeaveCall(PostControl* control);
+    // Counts the connects WinHTTP makes under a session's keep-alive pool
+    static void CALLBACK StatusCallback(HINTERNET hInternet, DWORD_PTR context, DWORD status,
+                                        LPVOID information, DWORD informationLength);
+#else
+    bool Attach(PostControl* control, int socket);
+    void Detach(PostControl* control);
+#endif
+
+    size_t Acquire(uint32_t deadline, PostControl* control);
+    void Release(size_t index);
+    void MaintenanceLoop();
+
+public:
+    ConnectionPool();
+    ~ConnectionPool();
+
+    bool Open(const std::string& endpointUrl, size_t poolSize, uint32_t keepAliveIntervalMs);
+    void Close();
+
+    // POST body to pathAndQuery on a pooled connection; returns false on
+    // transport failure, timeout or cancellation. statusCode is the HTTP
+    // status when a response arrived. Without a control the transport's
+    // default timeouts apply.
+    bool Post(const std::string& pathAndQuery, const std::string& body,
+              std::string& response, uint32_t& statusCode, PostControl* control = nullptr);
+    bool Post(const std::string& pathAndQuery, const std::string& body,
+              const ResponseSink& sink, uint32_t& statusCode, PostControl* control = nullptr);
+
+    size_t Size();
+    const std::string& EndpointPath() const { return path; }
+    ConnectionPoolStats GetStats();
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <cstdint>
+
+#include "translation_backend.h"
+#include "resilience.h"
+#include "request_quota.h"
+
+class ConnectionPool;
+class TranslationResponseParser;
+struct HedgeAttempt;
+
+// Google Translate v2 over a pool of persistent HTTP connections, with
+// per-request deadlines, retries, optional hedging and a circuit breaker.
+// Open, Close and the connection setters must not run while Translate is
+// in progress; TranslationClient serializes them with its client lock.
+class HttpBackend : public TranslationBackend {
+private:
+    std::unique_ptr<ConnectionPool> pool;
+    std::string requestPath;
+
+    // Connection settings, applied on the next Open
+    std::string endpointUrl;
+    size_t poolSize;
+    uint32_t keepAliveMs;
+
+    // Deadlines, retries, hedging and the circuit breaker
+    RetryPolicy retryPolicy;
+    CircuitBreaker breaker;
+    LatencyTracker latencies;
+    ResilienceStats resilienceStats;
+    uint32_t requestTimeoutMs;
+    bool hedgeRequests;
+    mutable std::mutex resilienceMutex;    // guards breaker, latencies and resilienceStats
+    RequestQuota quota;                     // charged for every request sent
+
+    // Hedge requests are sent by one helper thread, started with the first
+    // hedged attempt and stopped by Close; an attempt whose primary answers
+    // within the hedge delay is withdrawn without a request or a thread
+    std::thread hedgeThread;
+    std::mutex hedgeMutex;
+    std::condition_variable hedgeWakeup;    // a hedge queued, or stop
+    std::condition_variable hedgeFinished;  // a started hedge is done
+    std::vector<HedgeAttempt*> hedgeQueue;
+    bool hedgeStop;
+
+    static const uint32_t DEFAULT_REQUEST_TIMEOUT_MS = 10000;
+    static const size_t MAX_QUERIES_PER_REQUEST = 128;
+    static const size_t MAX_BYTES_PER_REQUEST = 30 * 1024;   // of text; a longer text is sent alone
+    static const size_t MAX_LOGGED_RESPONSE = 200;
+    static const size_t LATENCY_SAMPLES = 256;
+    static const size_t MIN_HEDGE_SAMPLES = 20;    // no hedging until p95 means something
+    static const uint32_t MIN_HEDGE_DELAY_MS = 50;
+    static constexpr const char* DEFAULT_ENDPOINT = "https://translation.googleapis.com/language/translate/v2";
+
+    // One attempt within timeoutMs; when hedgeAfterMs is non-zero a second
+    // request is sent on another connection if the first has not answered
+    // by then, and whichever succeeds first is used. statusCode is the HTTP
+    // status of the response used. Each request sent is charged to the quota
+    // for chars characters.
+    TranslationResult HttpsRequest(const std::string& path, const std::string& postData, size_t chars,
+                                   uint32_t timeoutMs, uint32_t hedgeAfterMs, TranslationResponseParser& parser,
+                                   std::string& responseHead, uint32_t& statusCode);
+    // Hedge delay for the next attempt: p95 latency, or 0 for no hedge
+    uint32_t HedgeDelay();
+    // Queue hedge for the helper thread, starting it if needed; false if
+    // the thread cannot be started
+    bool QueueHedge(HedgeAttempt& hedge);
+    // Withdraw hedge if it was not sent yet, or wait for it to finish;
+    // cancelSent cancels one in flight first
+    void FinishHedge(HedgeAttempt& hedge, bool cancelSent);
+    void HedgeLoop();
+    void SendHedge(HedgeAttempt& hedge);
+    void RecordAttempt(TranslationResult status, uint32_t statusCode, uint32_t elapsedMs);
+    // permanent is set for a failure that would repeat for the same
+    // request; statusCode is the last HTTP status received
+    TranslationResult RequestTranslations(const std::vector<std::string>& texts, const std::vector<size_t>& queryIndex,
+                                          size_t first, size_t count, const std::string& fromLang,
+                                          const std::string& toLang, std::vector<std::string>& translations,
+                                          bool& permanent, uint32_t& statusCode);
+    // Request one chunk and record each of its slots in Translate's outputs.
+    // A chunk the API rejects for its content is halved until the texts
+    // that fail on their own are found. Returns a failure that is not down
+    // to the texts, which would fail the rest of the call too, or SUCCESS.
+    TranslationResult RequestChunk(const std::vector<std::string>& texts, const std::vector<size_t>& queryIndex,
+                                   size_t first, size_t count, const std::string& fromLang,
+                                   const std::string& toLang, std::vector<std::string>& translations,
+                                   std::vector<bool>& answered, std::vector<TranslationResult>& statuses,
+                                   std::vector<bool>& permanent);
+
+public:
+    HttpBackend();
+    ~HttpBackend();
+
+    // Connect to the configured endpoint with apiKey
+    bool Open(const std::string& apiKey);
+    void Close();
+    bool IsOpen() const { return pool != nullptr; }
+
+    void SetEndpoint(const std::string& url);
+    void SetConnectionPoolSize(size_t size);
+    void SetKeepAliveInterval(uint32_t intervalMs);
+    // Deadline for one API request including its retries
+    void SetRequestTimeout(uint32_t timeoutMs);
+    // Total attempts per request (1 = no retries)
+    void SetRetryAttempts(unsigned int attempts);
+    // Hedged requests send some chat twice, and characters are billed
+    // twice too, so they are off unless enabled
+    void SetHedging(bool enabled);
+    // Consecutive failures before failing fast (0 disables the breaker),
+    // and how long to fail fast before probing the endpoint again
+    void SetBreakerThreshold(unsigned int failures);
+    void SetBreakerOpenTime(unsigned int openMs);
+    // Shared with the scheduler, which waits for it before dispatching
+    RequestQuota& Quota() { return quota; }
+
+    const char* Name() const override { return "http"; }
+    TranslationResult Translate(const std::vector<std::string>& texts, const std::vector<size_t>& queryIndex,
+                                const std::string& fromLang, const std::string& toLang,
+                                std::vector<std::string>& translations, std::vector<bool>& answered) override;
+    // As Translate, with statuses[slot] the outcome of each slot and
+    // returning the first failure. permanent[slot] is set when the failure
+    // would repeat for that text alone (an HTTP error other than 429 and
+    // 5xx), as opposed to a transport failure, timeout, throttling, the open
+    // breaker or an error for the whole request
+    TranslationResult Translate(const std::vector<std::string>& texts, const std::vector<size_t>& queryIndex,
+                                const std::string& fromLang, const std::string& toLang,
+                                std::vector<std::string>& translations, std::vector<bool>& answered,
+                                std::vector<TranslationResult>& statuses, std::vector<bool>& permanent);
+
+    ResilienceStats GetStats() const;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Streaming parser for translate API responses. Bytes can be fed in chunks
+// as they arrive from the network; every "translatedText" string (one per
+// q for multi-q requests) is decoded straight into its output buffer in a
+// single pass, with all JSON escapes including \u surrogate pairs. The
+// first "message" string is kept as well, which is where the API puts its
+// error text.
+//
+// A parser that is Reset() and reused keeps its buffers, so steady-state
+// parsing does not allocate.
+class TranslationResponseParser {
+private:
+    enum class State { Scan, String, Escape, Unicode };
+    enum class Target { Skip, Key, Translation, Message };
+
+    State state;
+    Target target;
+    std::vector<std::string> texts;
+    size_t textCount;
+    std::string key;
+    std::string message;
+    bool messageSeen;
+
+    char containers[32];
+    size_t depth;
+    bool expectKey;
+    Target nextValue;
+    bool sawValue;
+    bool failed;
+
+    uint32_t codeUnit;
+    int hexDigits;
+    uint32_t pendingHigh;
+
+    static const size_t MAX_KEY_LENGTH = 32;
+
+    std::string* Output();
+    void Append(const char* data, size_t size);
+    void AppendCodepoint(uint32_t codepoint);
+    void FlushSurrogate();
+    void CodeUnitDone();
+    void StartString();
+    void EndString();
+    void StartValue();
+    bool ScanByte(char c);
+
+public:
+    TranslationResponseParser();
+
+    void Reset();
+    // Returns false once the input is known to be malformed
+    bool Feed(const char* data, size_t size);
+    // True if a complete, well-formed document was fed
+    bool Finish() const;
+
+    size_t Count() const { return textCount; }
+    const std::string& Text(size_t index) const { return texts[index]; }
+    const std::string& Message() const { return message; }
+};
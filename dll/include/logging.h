@@ -1,22 +1,98 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <atomic>
+#include <type_traits>
+#include <cstdio>
 
-// Log levels
+// Log levels, least to most severe
 enum class LogLevel {
-    Info = 0,
-    Warning = 1,
-    Error = 2,
-    Debug = 3
+    Debug = 0,
+    Info = 1,
+    Warning = 2,
+    Error = 3
 };
 
-// Logging functions
+// Levels below CET_LOG_MIN_LEVEL are compiled out entirely
+// (0 = debug, 1 = info, 2 = warning, 3 = error)
+#ifndef CET_LOG_MIN_LEVEL
+#define CET_LOG_MIN_LEVEL 0
+#endif
+
+// Logging functions. LogToFile only copies the message into a ring buffer
+// once the writer thread is running; until then (DllMain) it writes
+// directly. Messages are cut at 480 bytes, and are dropped and counted
+// when the ring is full.
 bool InitializeLogging();
+void StartLogWriter();
+// Join the writer thread and go back to writing directly; not from DllMain
+void StopLogWriter();
+// Close the log file. Never waits, so DllMain can call it; while the
+// writer is still running the file is left open for the process to close.
 void CleanupLogging();
-void LogToFile(LogLevel level, const std::string& message);
+void LogToFile(LogLevel level, std::string_view message);
+
+// Runtime minimum level (Info by default), checked before any formatting
+extern std::atomic<int> g_logLevel;
+void SetLogLevel(LogLevel level);
+bool ParseLogLevel(const std::string& name, LogLevel& level);
+
+inline bool LogEnabled(LogLevel level) {
+    return static_cast<int>(level) >= g_logLevel.load(std::memory_order_relaxed);
+}
+
+namespace LogDetail {
+
+inline void Append(std::string& out, std::string_view text) { out.append(text.data(), text.size()); }
+inline void Append(std::string& out, const char* text) { out.append(text); }
+inline void Append(std::string& out, const std::string& text) { out.append(text); }
+inline void Append(std::string& out, char c) { out += c; }
+inline void Append(std::string& out, bool value) { out.append(value ? "true" : "false"); }
+
+template <typename T>
+inline std::enable_if_t<std::is_integral_v<T>> Append(std::string& out, T value) {
+    char buffer[24];
+    int length = std::is_signed_v<T>
+        ? snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(value))
+        : snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(value));
+    out.append(buffer, length);
+}
+
+// int8_t and uint8_t are numbers, not characters; only plain char is text
+inline void Append(std::string& out, signed char value) { Append(out, static_cast<int>(value)); }
+inline void Append(std::string& out, unsigned char value) { Append(out, static_cast<unsigned int>(value)); }
+
+template <typename T>
+inline std::enable_if_t<std::is_floating_point_v<T>> Append(std::string& out, T value) {
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "%.3f", static_cast<double>(value));
+    out.append(buffer, length);
+}
+
+// Concatenates the arguments into a per-thread buffer, so a log call does
+// not allocate once the buffer has grown
+template <typename... Args>
+void LogMessage(LogLevel level, const Args&... args) {
+    static thread_local std::string buffer;
+    buffer.clear();
+    (Append(buffer, args), ...);
+    LogToFile(level, buffer);
+}
+
+} // namespace LogDetail
+
+// LOG_DEBUG("Connection ", index, " warmed in ", elapsed, " ms"). Arguments
+// are only evaluated when the level is enabled.
+#define CET_LOG(level, ...) \
+    do { \
+        if (static_cast<int>(level) >= CET_LOG_MIN_LEVEL && LogEnabled(level)) { \
+            LogDetail::LogMessage(level, __VA_ARGS__); \
+        } \
+    } while (0)
 
 // Convenience macros
-#define LOG_INFO(msg) LogToFile(LogLevel::Info, msg)
-#define LOG_WARNING(msg) LogToFile(LogLevel::Warning, msg)  
-#define LOG_ERROR(msg) LogToFile(LogLevel::Error, msg)
-#define LOG_DEBUG(msg) LogToFile(LogLevel::Debug, msg)
+#define LOG_INFO(...) CET_LOG(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARNING(...) CET_LOG(LogLevel::Warning, __VA_ARGS__)
+#define LOG_ERROR(...) CET_LOG(LogLevel::Error, __VA_ARGS__)
+#define LOG_DEBUG(...) CET_LOG(LogLevel::Debug, __VA_ARGS__)
@@ -1,8 +1,15 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <cstdint>
 
+// The client's Lua API is __fastcall; the bridge also builds outside the
+// game (cet_bench), where the convention does not exist
+#ifndef _WIN32
+#define __fastcall
+#endif
+
 // Lua C API function pointers (following UnitXP_SP3 pattern)
 typedef int(__fastcall* LUA_CFUNCTION)(void* L);
 typedef void(__fastcall* LUA_PUSHSTRING)(void* L, const char* s);
@@ -17,19 +24,55 @@ typedef int(__fastcall* LUA_ISNUMBER)(void* L, int index);
 typedef int(__fastcall* LUA_ISSTRING)(void* L, int index);
 typedef void* (__fastcall* GETCONTEXT)(void);
 
+// The client's Lua C API, called through these pointers. They default to
+// the Turtle WoW client's addresses; SetLuaApi replaces them so the bridge
+// can be driven by stubs outside the game.
+struct LuaApi {
+    GETCONTEXT getContext;
+    LUA_PUSHSTRING pushstring;
+    LUA_PUSHBOOLEAN pushboolean;
+    LUA_PUSHNUMBER pushnumber;
+    LUA_PUSHNIL pushnil;
+    LUA_TOSTRING tostring;
+    LUA_TONUMBER tonumber;
+    LUA_TOBOOLEAN toboolean;
+    LUA_GETTOP gettop;
+    LUA_ISNUMBER isnumber;
+    LUA_ISSTRING isstring;
+};
+
+void SetLuaApi(const LuaApi& api);
+
+// UnitXP as it was before the hook; every call that is not for CET goes here
+extern LUA_CFUNCTION g_originalUnitXP;
+
 // Main CET command handler (internal hook function)
 int __fastcall detoured_UnitXP(void* L);
+// Dispatch UnitXP("CET", subcommand, ...) once the first argument matched
+int HandleCetCommand(void* L);
 
 // Lua interface functions
 bool InitializeLuaInterface();
 void CleanupLuaInterface();
+// Stop the background threads; the next UnitXP("CET", ...) call starts
+// them again as needed. Joins threads, so never from DllMain: it runs for
+// UnitXP("CET", "shutdown"), which the addon sends at PLAYER_LOGOUT.
+void ShutdownCET();
+// True while the translator and the worker have no thread running: before
+// the first UnitXP("CET", "init_translator", ...) and after ShutdownCET
+// until the next one. The stats dump only runs in that time too; the log
+// writer is left to CleanupLogging and the process.
+bool IsCETShutdown();
 
-// Helper functions for Lua interaction
+// Helper functions for Lua interaction. lua_tostring returns a view of the
+// string Lua owns, valid until the handler returns; Lua copies pushed
+// strings, so they can come from reused buffers.
+void lua_pushstring(void* L, const char* str);
 void lua_pushstring(void* L, const std::string& str);
 void lua_pushboolean(void* L, bool value);
 void lua_pushnumber(void* L, double value);
 void lua_pushnil(void* L);
-std::string lua_tostring(void* L, int index);
+std::string_view lua_tostring(void* L, int index);
 double lua_tonumber(void* L, int index);
 bool lua_toboolean(void* L, int index);
 int lua_gettop(void* L);
@@ -0,0 +1,36 @@
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. Pages are only faulted in when
+// touched, so opening a large file costs next to nothing.
+class MappedFile {
+private:
+#ifdef _WIN32
+    HANDLE hFile;
+    HANDLE hMapping;
+#else
+    int fd;
+#endif
+    const char* view;
+    size_t length;
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns false if the file is missing or empty
+    bool Open(const std::string& path);
+    void Close();
+
+    const char* Data() const { return view; }
+    size_t Size() const { return length; }
+    bool IsOpen() const { return view != nullptr; }
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <string>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include "translation_backend.h"
+
+// Event counters
+enum class Metric {
+    HookCalls = 0,      // every UnitXP call through the hook, other addons' included
+    CetCommands,        // UnitXP("CET", ...) calls
+    ApiRequests,        // HTTP requests sent, retries and hedges included
+    BytesOut,           // request bodies sent
+    BytesIn,            // response bodies received
+    Count
+};
+
+// Latency histograms, in milliseconds
+enum class LatencyMetric {
+    EndToEnd = 0,       // translate call or ticket submit until the result is ready
+    Network,            // successful HTTP request
+    Count
+};
+
+static const size_t METRIC_COUNT = static_cast<size_t>(Metric::Count);
+static const size_t LATENCY_METRIC_COUNT = static_cast<size_t>(LatencyMetric::Count);
+static const size_t RESULT_CODE_COUNT = static_cast<size_t>(TranslationResult::UNAVAILABLE) + 1;
+
+// Log-linear buckets: exact below 16 ms, then 8 per power of two (at most
+// 12.5% wide) up to about 17 minutes; the last bucket takes the rest
+static const size_t LATENCY_BUCKET_COUNT = 16 + 16 * 8 + 1;
+
+// One thread's metrics. Only the owning thread writes, so an update is a
+// plain load and store without a locked instruction; readers sum every
+// thread's shard with relaxed loads.
+struct MetricsShard {
+    std::atomic<uint64_t> counters[METRIC_COUNT];
+    std::atomic<uint64_t> results[RESULT_CODE_COUNT];
+    std::atomic<uint64_t> latency[LATENCY_METRIC_COUNT][LATENCY_BUCKET_COUNT];
+    std::atomic<uint64_t> latencyMax[LATENCY_METRIC_COUNT];
+
+    MetricsShard();
+};
+
+// Summed over all threads, live and exited
+struct MetricsSnapshot {
+    uint64_t counters[METRIC_COUNT];
+    uint64_t results[RESULT_CODE_COUNT];
+    uint64_t latency[LATENCY_METRIC_COUNT][LATENCY_BUCKET_COUNT];
+    uint64_t latencyMax[LATENCY_METRIC_COUNT];
+    uint64_t uptimeMs;
+
+    MetricsSnapshot();
+
+    uint64_t Counter(Metric metric) const { return counters[static_cast<size_t>(metric)]; }
+    uint64_t Results(TranslationResult result) const { return results[static_cast<size_t>(result)]; }
+    uint64_t LatencyCount(LatencyMetric metric) const;
+    // percentile in [0, 100], as the upper bound of its bucket; 0 when empty
+    uint32_t LatencyPercentile(LatencyMetric metric, double percentile) const;
+};
+
+extern thread_local MetricsShard* t_metricsShard;
+// This thread's shard, registered on first use
+MetricsShard& RegisterMetricsShard();
+
+inline MetricsShard& LocalMetrics() {
+    MetricsShard* shard = t_metricsShard;
+    return shard ? *shard : RegisterMetricsShard();
+}
+
+inline void CountMetric(Metric metric, uint64_t amount = 1) {
+    std::atomic<uint64_t>& counter = LocalMetrics().counters[static_cast<size_t>(metric)];
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+// Outcome of a finished translation (a ticket or a synchronous call)
+void RecordResult(TranslationResult result);
+void RecordLatency(LatencyMetric metric, uint32_t milliseconds);
+
+MetricsSnapshot GetMetrics();
+// Append " key=value"
+void AppendStat(std::string& out, const char* key, uint64_t value);
+// Append " key=value" pairs for the counters, result codes and latency
+// percentiles: hook_calls, api_requests, result_api_error, e2e_p95 ...
+void AppendMetrics(std::string& out, const MetricsSnapshot& metrics);
+
+// Append line() plus a newline to path every intervalMs on a background
+// thread; an interval of 0 stops it
+void SetMetricsDump(const std::string& path, unsigned int intervalMs, std::function<std::string()> line);
+// Joins the dump thread, so not from DllMain; see ShutdownCET
+void StopMetricsDump();
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <shared_mutex>
+#include <atomic>
+#include <cstdint>
+
+#include "translation_backend.h"
+#include "mapped_file.h"
+#include "aho_corasick.h"
+
+// Phrase table for one language pair, read from a memory-mapped UTF-8 text
+// file with one "source<TAB>target" entry per line ('#' starts a comment).
+// Sources are matched case-insensitively for ASCII, and targets point into
+// the mapping, so loading copies nothing but the automaton.
+class PhraseTable {
+private:
+    MappedFile file;
+    AhoCorasick matcher;
+    std::vector<std::string_view> targets;     // by pattern id
+
+public:
+    PhraseTable();
+
+    PhraseTable(const PhraseTable&) = delete;
+    PhraseTable& operator=(const PhraseTable&) = delete;
+
+    // False if the file is missing or holds no entries
+    bool Load(const std::string& path);
+    size_t Size() const { return targets.size(); }
+
+    // Translate text if phrases cover every word of it: the longest phrases
+    // are matched left to right, a phrase must start and end on a word
+    // boundary, and whatever lies between matches may only be whitespace,
+    // digits and punctuation, which is kept as it is.
+    bool Translate(std::string_view text, std::string& result) const;
+};
+
+// Local backend answering formulaic chat (LFG, WTS/WTB, raid calls) from
+// phrase tables, without the network. Tables are files named
+// CET_phrases_<from>_<to>.tsv in the given directory, loaded on first use
+// of their language pair; a pair without a file answers nothing.
+class PhraseTableBackend : public TranslationBackend {
+private:
+    std::string directory;
+    std::unordered_map<std::string, std::unique_ptr<PhraseTable>> tables;  // null: no table
+    mutable std::shared_mutex tablesMutex;
+    std::atomic<uint64_t> lookups;
+    std::atomic<uint64_t> hits;
+
+    static std::string PairKey(std::string_view fromLang, std::string_view toLang);
+    // Loads the pair's table if this is its first use
+    const PhraseTable* Table(std::string_view fromLang, std::string_view toLang);
+
+public:
+    explicit PhraseTableBackend(const std::string& tableDirectory);
+
+    const char* Name() const override { return "phrases"; }
+    TranslationResult Translate(const std::vector<std::string>& texts, const std::vector<size_t>& queryIndex,
+                                const std::string& fromLang, const std::string& toLang,
+                                std::vector<std::string>& translations, std::vector<bool>& answered) override;
+    // Only uses tables that are already loaded
+    bool TryTranslate(std::string_view text, std::string_view fromLang, std::string_view toLang,
+                      std::string& result) override;
+
+    uint64_t Lookups() const { return lookups; }
+    uint64_t Hits() const { return hits; }
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+// Append text as the contents of a JSON string literal (no quotes)
+void AppendJsonEscaped(std::string& out, std::string_view text);
+
+// Append text percent-encoded for use in a URL query
+void AppendUrlEncoded(std::string& out, std::string_view text);
+
+// Writes translate request bodies into one buffer that is reused between
+// requests, so once it has grown to the usual request size building a body
+// does not allocate. One builder per thread.
+class TranslationRequestBuilder {
+private:
+    std::string body;
+
+    static const size_t INITIAL_CAPACITY = 2048;
+
+public:
+    TranslationRequestBuilder();
+
+    // {"q":...,"source":...,"target":...,"format":"text"} for
+    // texts[queryIndex[first]] .. texts[queryIndex[first + count - 1]];
+    // several texts are sent as a "q" array
+    const std::string& Build(const std::vector<std::string>& texts, const std::vector<size_t>& queryIndex,
+                             size_t first, size_t count, std::string_view fromLang, std::string_view toLang);
+
+    // Request path with the API key; built once per configuration
+    static std::string BuildPath(const std::string& endpointPath, const std::string& apiKey);
+};
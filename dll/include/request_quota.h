@@ -0,0 +1,60 @@
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <cstddef>
+
+// Classic token bucket: refills at rate tokens per second up to burst. A
+// rate of 0 means unlimited. Consuming more than is available leaves the
+// bucket in debt, which later requests wait out.
+class TokenBucket {
+private:
+    double rate;
+    double burst;
+    double tokens;
+    std::chrono::steady_clock::time_point updated;
+
+    void Refill(std::chrono::steady_clock::time_point now);
+
+public:
+    TokenBucket();
+
+    void Configure(double ratePerSecond, double burstSize);
+    bool IsLimited() const { return rate > 0; }
+
+    // Tokens available now (unbounded when unlimited)
+    double Available(std::chrono::steady_clock::time_point now);
+    // When amount tokens (capped at burst) will be available
+    std::chrono::steady_clock::time_point ReadyAt(double amount, std::chrono::steady_clock::time_point now);
+    void Consume(double amount, std::chrono::steady_clock::time_point now);
+};
+
+// Requests and characters sent to the translation API per second. The HTTP
+// backend charges it for every request it puts on the wire, retries, hedges
+// and each part of a split batch included, counting the characters of the
+// texts in code points as the API bills them. The scheduler only waits for
+// it before dispatching, so batches answered from a cache cost nothing.
+// Thread-safe.
+class RequestQuota {
+private:
+    mutable std::mutex quotaMutex;
+    TokenBucket requestBucket;
+    TokenBucket charBucket;
+
+    static const unsigned int DEFAULT_REQUESTS_PER_SECOND = 10;
+    static const unsigned int DEFAULT_CHARS_PER_SECOND = 2000;
+
+public:
+    RequestQuota();
+
+    // Per-second limits; 0 removes the limit
+    void SetRequestQuota(unsigned int requestsPerSecond);
+    void SetCharQuota(unsigned int charsPerSecond);
+
+    // When one request of chars characters is allowed (now if it already is)
+    std::chrono::steady_clock::time_point ReadyAt(size_t chars, std::chrono::steady_clock::time_point now);
+    // Characters left in the quota now (unbounded when unlimited)
+    double CharsAvailable(std::chrono::steady_clock::time_point now);
+    // One request of chars characters was sent
+    void Charge(size_t chars, std::chrono::steady_clock::time_point now);
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// Latencies of the most recent requests, for percentile estimates
+class LatencyTracker {
+private:
+    std::vector<uint32_t> samples;
+    size_t next;
+    size_t count;
+
+public:
+    explicit LatencyTracker(size_t capacity);
+
+    void Record(uint32_t milliseconds);
+    size_t Count() const { return count; }
+    // percentile in [0, 100]; 0 when nothing has been recorded
+    uint32_t Percentile(double percentile) const;
+};
+
+// Bounded retries with "full jitter" exponential backoff: the delay before
+// retry n is uniformly random in [0, min(maxDelayMs, baseDelayMs * 2^n)],
+// so clients that failed together do not retry together
+struct RetryPolicy {
+    unsigned int maxAttempts;   // including the first; 1 disables retries
+    unsigned int baseDelayMs;
+    unsigned int maxDelayMs;
+
+    RetryPolicy() : maxAttempts(3), baseDelayMs(200), maxDelayMs(2000) {}
+    unsigned int BackoffMs(unsigned int retry) const;
+};
+
+// 429 and 5xx: the request was fine, the endpoint could not serve it now
+bool IsRetryableStatus(unsigned long httpStatus);
+// 400 and 413: the API refused what was sent, which for a request with
+// several texts may be down to one of them
+bool IsRejectedContentStatus(unsigned long httpStatus);
+
+enum class BreakerState {
+    Closed = 0,     // requests flow
+    Open = 1,       // failing fast until the cool-down has passed
+    HalfOpen = 2    // one probe request decides whether to close again
+};
+
+const char* BreakerStateToString(BreakerState state);
+
+// Opens after failureThreshold consecutive failures and rejects requests
+// for openMs; then lets a single probe through, which closes the breaker
+// on success or opens it again on failure. A threshold of 0 disables it.
+// Not thread-safe; the translation client guards it.
+class CircuitBreaker {
+private:
+    BreakerState state;
+    unsigned int failures;
+    unsigned int failureThreshold;
+    unsigned int openMs;
+    std::chrono::steady_clock::time_point openedAt;
+    bool probeInFlight;
+    uint64_t opens;
+
+    static const unsigned int DEFAULT_FAILURE_THRESHOLD = 5;
+    static const unsigned int DEFAULT_OPEN_MS = 30000;
+
+    void Trip(std::chrono::steady_clock::time_point now);
+
+public:
+    CircuitBreaker();
+
+    void SetFailureThreshold(unsigned int threshold);
+    void SetOpenTime(unsigned int openMilliseconds) { openMs = openMilliseconds; }
+    // False while the breaker is open (or a half-open probe is out)
+    bool Allow(std::chrono::steady_clock::time_point now);
+    void RecordSuccess();
+    void RecordFailure(std::chrono::steady_clock::time_point now);
+
+    BreakerState State() const { return state; }
+    uint64_t Opens() const { return opens; }
+};
+
+// Request counters of the translation client; the latency percentiles and
+// breaker state are filled in when the stats are read
+struct ResilienceStats {
+    uint64_t attempts;      // HTTP requests sent, hedges included
+    uint64_t retries;
+    uint64_t timeouts;
+    uint64_t hedges;        // hedge requests started
+    uint64_t hedgeWins;     // hedges that answered first
+    uint64_t failedFast;    // requests refused by the open breaker
+    uint64_t breakerOpens;
+    uint32_t p50Ms;
+    uint32_t p95Ms;
+    uint32_t p99Ms;
+    BreakerState breaker;
+
+    ResilienceStats()
+        : attempts(0), retries(0), timeouts(0), hedges(0), hedgeWins(0), failedFast(0), breakerOpens(0),
+          p50Ms(0), p95Ms(0), p99Ms(0), breaker(BreakerState::Closed) {}
+};
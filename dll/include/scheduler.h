@@ -0,0 +1,105 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+#include "request_quota.h"
+
+// Scheduling class of a translation; lower values are served first
+enum class TranslationPriority {
+    Direct = 0,     // the player's own outgoing messages and whispers
+    Group = 1,      // party, raid, guild
+    Public = 2      // say, yell, world/trade channels
+};
+
+static const size_t PRIORITY_COUNT = 3;
+
+// "direct", "group" or "public"
+bool ParsePriority(std::string_view name, TranslationPriority& priority);
+const char* PriorityToString(TranslationPriority priority);
+
+// Queued translation request
+struct TranslationJob {
+    uint32_t ticket;
+    std::string text;
+    std::string fromLang;
+    std::string toLang;
+    TranslationPriority priority;
+    std::chrono::steady_clock::time_point queuedAt;
+    uint64_t traceId;           // of the UnitXP call that submitted it; 0 when not traced
+};
+
+// Per priority class counters; depth is filled in when stats are read
+struct SchedulerClassStats {
+    uint64_t submitted;
+    uint64_t dispatched;
+    uint64_t shed;          // dropped because they waited too long or were displaced
+    uint64_t rejected;      // refused at submit because the queue was full
+    uint64_t totalWaitMs;
+    uint64_t maxWaitMs;
+    size_t depth;
+
+    SchedulerClassStats()
+        : submitted(0), dispatched(0), shed(0), rejected(0), totalWaitMs(0), maxWaitMs(0), depth(0) {}
+};
+
+struct SchedulerStats {
+    SchedulerClassStats classes[PRIORITY_COUNT];
+    uint64_t requests;      // batches dispatched
+    uint64_t throttled;     // times dispatch waited for quota
+
+    SchedulerStats() : requests(0), throttled(0) {}
+};
+
+// Priority queues in front of the translation client. Jobs are served
+// highest class first and oldest first within a class; a batch can take
+// jobs for the same language pair from every class. Dispatch waits for the
+// request quota, which the HTTP backend charges as it sends, and Group and
+// Public jobs that have waited past their deadline are shed instead of
+// being sent late. When the queue is full a new job displaces the oldest
+// job of a lower class, or is rejected.
+// Not thread-safe; the worker serializes access.
+class TranslationScheduler {
+private:
+    std::deque<TranslationJob> queues[PRIORITY_COUNT];
+    size_t queued;
+    size_t maxQueued;
+    unsigned int shedAfterMs[PRIORITY_COUNT];   // 0 = never shed
+    RequestQuota& quota;
+    SchedulerStats stats;
+
+    static const unsigned int DEFAULT_SHED_GROUP_MS = 15000;
+    static const unsigned int DEFAULT_SHED_PUBLIC_MS = 5000;
+
+public:
+    TranslationScheduler(size_t maxQueuedJobs, RequestQuota& requestQuota);
+
+    // False if the job was rejected; a job displaced to make room is
+    // appended to shed
+    bool Push(TranslationJob&& job, std::vector<TranslationJob>& shed);
+    void Clear();
+    bool Empty() const { return queued == 0; }
+    size_t Size() const { return queued; }
+    // Oldest job of the highest non-empty class
+    const TranslationJob& Next() const;
+
+    // Remove jobs that have waited longer than their class allows
+    void ShedExpired(std::chrono::steady_clock::time_point now, std::vector<TranslationJob>& shed);
+    // When quota allows the next request (now if it already does)
+    std::chrono::steady_clock::time_point QuotaReadyAt(std::chrono::steady_clock::time_point now);
+    // True once Next()'s language pair has enough queued work to fill a batch
+    bool BatchReady(size_t maxItems, size_t maxBytes) const;
+    // Take Next() plus queued jobs for the same language pair within the
+    // limits and the characters left in the quota
+    void CollectBatch(std::vector<TranslationJob>& batch, size_t maxItems, size_t maxBytes,
+                      std::chrono::steady_clock::time_point now);
+    void CountThrottled() { stats.throttled++; }
+
+    void SetShedDeadline(TranslationPriority priority, unsigned int milliseconds);
+    SchedulerStats GetStats() const;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string_view>
+#include <cstddef>
+
+// Writing systems told apart by the detector
+enum class Script {
+    Unknown = 0,
+    Latin,
+    Cyrillic,
+    Greek,
+    Han,
+    Kana,       // Japanese: kana, usually mixed with Han
+    Hangul,
+    Thai,
+    Arabic,
+    Hebrew,
+    Count
+};
+
+struct ScriptDetection {
+    Script script;
+    double confidence;   // Share of the letters that belong to script, 0..1
+    size_t letters;      // Letters seen, weighted by their UTF-8 length
+};
+
+// Classify UTF-8 text by the script most of its letters are written in.
+// Digits, punctuation, emoji, color codes and link payloads are ignored.
+// Pure ASCII runs are counted 16 bytes at a time with SSE2.
+ScriptDetection DetectScript(std::string_view text);
+
+// Language code the translator should use for a script ("zh", "ja", ...);
+// Latin maps to "en". nullptr for Unknown.
+const char* ScriptLanguageCode(Script script);
+const char* ScriptToString(Script script);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One translatable piece of a chat message. Segments are in message order;
+// the text between segments (whitespace) is kept verbatim when the
+// translations are put back together.
+struct TextSegment {
+    size_t start;
+    size_t length;
+};
+
+// Split message into sentences/clauses at . ! ? ; , (and their full-width
+// CJK forms). ASCII punctuation only ends a segment when followed by
+// whitespace, so "3.5" or "12,000" stay intact; item/spell links and
+// [bracketed] text are never split. Whitespace around segments is excluded.
+void SplitSegments(std::string_view message, std::vector<TextSegment>& segments);
+
+// Rebuild a message into result from per-segment translations, keeping the
+// original text between segments. translations[firstTranslation + i] is the
+// translation of segments[i]; result is overwritten.
+void JoinSegments(std::string_view message, const std::vector<TextSegment>& segments,
+                  const std::vector<std::string>& translations, size_t firstTranslation, std::string& result);
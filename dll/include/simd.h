@@ -0,0 +1,8 @@
+#pragma once
+
+// SSE2 is part of x64 and of 32-bit MSVC builds with /arch:SSE2 (the
+// default); everything that uses it keeps a scalar fallback
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CET_HAVE_SSE2 1
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <shared_mutex>
+
+#include "aho_corasick.h"
+
+// A part of a segment that a placeholder stands for
+struct MaskSpan {
+    size_t start;
+    size_t length;
+};
+
+// Replaces what has to come back unchanged from translation - item/spell
+// links, color codes, textures, numbers, player names and glossary terms -
+// with numbered placeholders "{0}", "{1}", ... The template is what gets
+// cached and sent, so "LF2M BRD" and "LF3M BRD" share one translation and
+// link payloads never reach the API. Adjacent spans share a placeholder.
+class PlaceholderMasker {
+private:
+    AhoCorasick glossary;
+    std::vector<std::string> terms;
+    std::vector<std::string> names;
+    bool enabled;
+    mutable std::shared_mutex glossaryMutex;
+
+    void RebuildLocked();
+
+public:
+    PlaceholderMasker();
+
+    PlaceholderMasker(const PlaceholderMasker&) = delete;
+    PlaceholderMasker& operator=(const PlaceholderMasker&) = delete;
+
+    void SetEnabled(bool enable);
+    // Words kept verbatim, matched case-insensitively as whole words. Terms
+    // (raid and dungeon abbreviations) and names (the player's group) are
+    // separate lists so either can be replaced without the other.
+    void SetGlossaryTerms(const std::vector<std::string>& glossaryTerms);
+    void SetNames(const std::vector<std::string>& playerNames);
+    size_t GlossarySize() const;
+
+    // templ is text with its spans replaced by placeholders; both are
+    // overwritten and their storage reused. With nothing to mask, templ is
+    // a copy of text and spans is empty.
+    void Mask(std::string_view text, std::string& templ, std::vector<MaskSpan>& spans) const;
+};
+
+// Put the masked spans of original back into a translated template.
+// Placeholders the translation lost are appended at the end, so a link is
+// never dropped; result is overwritten.
+void Unmask(std::string_view translated, std::string_view original, const std::vector<MaskSpan>& spans,
+            std::string& result);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// Opt-in span tracing. Spans are recorded into a fixed-size ring buffer and
+// exported as Chrome trace-event JSON (about:tracing, ui.perfetto.dev).
+// Each UnitXP("CET", ...) call gets a trace ID that follows its message
+// into the worker, so the queue wait, cache lookup, HTTP request and parse
+// of one message can be picked out. While tracing is off a span costs one
+// test of a relaxed flag.
+
+extern std::atomic<bool> g_traceEnabled;
+
+inline bool TraceEnabled() {
+    return g_traceEnabled.load(std::memory_order_relaxed);
+}
+
+// Enabling allocates the buffer on first use; disabling keeps what was recorded
+void SetTracing(bool enabled);
+// Write the buffered spans, oldest first; false if the file cannot be written
+bool ExportTrace(const std::string& path, size_t& events);
+void ClearTrace();
+
+// Microseconds on the trace clock; never 0
+uint64_t TraceMicros(std::chrono::steady_clock::time_point when);
+inline uint64_t TraceNowMicros() {
+    return TraceMicros(std::chrono::steady_clock::now());
+}
+
+// The trace ID of the message this thread is working on, 0 for none
+extern thread_local uint64_t t_traceId;
+uint64_t NewTraceId();
+
+// name must be a string literal (or otherwise outlive the buffer).
+// batchId links a message's span to the request it was batched into.
+void RecordTraceSpan(const char* name, uint64_t traceId, uint64_t startMicros, uint64_t endMicros,
+                     uint64_t batchId = 0);
+
+// Sets this thread's trace ID for its lifetime
+class TraceIdScope {
+private:
+    uint64_t previous;
+
+public:
+    explicit TraceIdScope(uint64_t traceId) : previous(t_traceId) { t_traceId = traceId; }
+    ~TraceIdScope() { t_traceId = previous; }
+
+    TraceIdScope(const TraceIdScope&) = delete;
+    TraceIdScope& operator=(const TraceIdScope&) = delete;
+};
+
+// Records its lifetime as a span of the current trace ID
+class TraceSpan {
+private:
+    const char* name;
+    uint64_t start;             // 0 when tracing was off
+
+public:
+    explicit TraceSpan(const char* spanName) : name(spanName), start(TraceEnabled() ? TraceNowMicros() : 0) {}
+    ~TraceSpan() {
+        if (start) {
+            RecordTraceSpan(name, t_traceId, start, TraceNowMicros());
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+// Translation result codes
+enum class TranslationResult {
+    SUCCESS = 0,
+    NETWORK_ERROR = 1,
+    API_ERROR = 2,
+    ENCODING_ERROR = 3,
+    TIMEOUT_ERROR = 4,
+    INVALID_PARAMS = 5,
+    OVERLOADED = 6,         // shed by the scheduler before it was sent
+    UNAVAILABLE = 7         // refused by the open circuit breaker, or no backend to send it to
+};
+
+// Human readable description of a translation result code
+const char* TranslationResultToString(TranslationResult result);
+// "CET translate error: <description>", the reply the addon gets for a
+// translation that failed with result; static storage
+const char* TranslationErrorReply(TranslationResult result);
+
+// A source of translations behind TranslationClient. The client answers
+// what it can from its caches, then asks its local backends in order, and
+// sends whatever is left to the remote (HTTP) backend.
+class TranslationBackend {
+public:
+    virtual ~TranslationBackend() {}
+
+    virtual const char* Name() const = 0;
+
+    // Translate texts[queryIndex[slot]] for every slot into
+    // translations[slot] and set answered[slot]; both are sized to
+    // queryIndex.size() by the caller. A local backend leaves the texts it
+    // does not know unanswered and returns SUCCESS; a remote backend
+    // answers every text or returns an error.
+    virtual TranslationResult Translate(const std::vector<std::string>& texts, const std::vector<size_t>& queryIndex,
+                                        const std::string& fromLang, const std::string& toLang,
+                                        std::vector<std::string>& translations, std::vector<bool>& answered) = 0;
+
+    // Answer one text without blocking, for the game thread; false when the
+    // text is unknown or the answer would have to wait
+    virtual bool TryTranslate(std::string_view /*text*/, std::string_view /*fromLang*/,
+                              std::string_view /*toLang*/, std::string& /*result*/) {
+        return false;
+    }
+};
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <string>
+#include <list>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <cstdint>
+
+#include "cache_key.h"
+#include "translation_backend.h"
+
+// Cache counters
+struct TranslationCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t insertions;
+    uint64_t evictions;
+    uint64_t expirations;
+    uint64_t rejections;
+
+    TranslationCacheStats()
+        : hits(0), misses(0), insertions(0), evictions(0), expirations(0), rejections(0) {}
+};
+
+// Count-min sketch of 4-bit counters used to estimate how often a key has
+// been seen recently. Counters are halved once the sample size is reached so
+// old popularity fades.
+class FrequencySketch {
+private:
+    std::vector<uint64_t> table;
+    size_t tableMask;
+    size_t sampleSize;
+    size_t additions;
+
+    size_t CounterIndex(uint64_t hash, int row, unsigned& shift) const;
+    void Age();
+
+public:
+    FrequencySketch();
+
+    void Resize(size_t expectedEntries);
+    void Increment(uint64_t hash);
+    unsigned Frequency(uint64_t hash) const;
+};
+
+// Byte-budgeted translation cache (W-TinyLFU).
+// New entries land in a small LRU window; when the window overflows its
+// oldest entry competes with the main cache's eviction victim and is only
+// admitted if the frequency sketch says it is more popular. The main cache
+// is a segmented LRU (probation/protected). All operations are O(1); TTL
+// expiry is driven by a hashed timing wheel instead of scanning.
+// Not thread-safe; callers serialize access.
+class TranslationCache {
+private:
+    enum class Segment { Window, Probation, Protected };
+
+    struct Node {
+        CacheKey key;
+        std::string value;
+        size_t charge;
+        uint64_t expireTick;
+        Segment segment;
+        bool scheduled;
+        std::list<Node*>::iterator wheelPos;
+    };
+
+    typedef std::list<Node> NodeList;
+
+    NodeList window;
+    NodeList probation;
+    NodeList protectedSegment;
+    std::unordered_map<CacheKey, NodeList::iterator, CacheKeyHash> index;
+    FrequencySketch sketch;
+
+    size_t maxBytes;
+    size_t windowBytes;
+    size_t probationBytes;
+    size_t protectedBytes;
+
+    // Timing wheel: the tick length is chosen so a full TTL fits in one
+    // revolution, so each entry is looked at once, when it is due
+    std::vector<std::list<Node*>> wheel;
+    std::chrono::steady_clock::time_point origin;
+    uint64_t tickMs;
+    uint64_t ttlTicks;
+    uint64_t lastTick;
+    uint32_t ttlSeconds;
+
+    TranslationCacheStats stats;
+
+    static const size_t WHEEL_SLOTS = 256;
+    // Node plus list links and index slot; keys are fixed size
+    static const size_t ENTRY_OVERHEAD = sizeof(Node) + 64;
+
+    size_t WindowBudget() const;
+    size_t MainBudget() const;
+    size_t ProtectedBudget() const;
+    uint64_t NowTick() const;
+    void Advance();
+    void Schedule(Node& node);
+    void Erase(NodeList::iterator it);
+    NodeList& ListFor(Segment segment);
+    size_t& BytesFor(Segment segment);
+    void MoveTo(NodeList::iterator it, Segment segment);
+    void Touch(NodeList::iterator it);
+    void EvictFromWindow();
+    void TrimProtected();
+    void TrimMain();
+    void RebuildWheel();
+    // The counted part of Get: frequency, recency and stats; null on a miss
+    const Node* Access(const CacheKey& key);
+
+public:
+    TranslationCache(size_t budgetBytes, uint32_t expirySeconds);
+
+    bool Get(const CacheKey& key, std::string& value);
+    // As Get, but the lookup is not counted in the frequency sketch, the
+    // recency order or the stats; Record counts it once it is known that
+    // no Get for the same lookup follows
+    bool Peek(const CacheKey& key, std::string& value) const;
+    void Record(const CacheKey& key);
+    void Put(const CacheKey& key, const std::string& value);
+    bool Contains(const CacheKey& key);
+    void Clear();
+
+    void SetMaxBytes(size_t budgetBytes);
+    void SetExpiry(uint32_t expirySeconds);
+
+    size_t Size() const { return index.size(); }
+    size_t Bytes() const { return windowBytes + probationBytes + protectedBytes; }
+    size_t MaxBytes() const { return maxBytes; }
+    const TranslationCacheStats& GetStats() const { return stats; }
+};
+
+// Short-lived record of lookups not worth sending again yet: texts the API
+// just returned unchanged (SUCCESS), or failed on in a way that would
+// repeat (the failure's status). Entries expire after their TTL; beyond the
+// capacity the oldest are dropped.
+// Not thread-safe; callers serialize access.
+class NegativeCache {
+private:
+    struct Entry {
+        std::chrono::steady_clock::time_point expires;
+        TranslationResult status;
+    };
+
+    std::unordered_map<CacheKey, Entry, CacheKeyHash> entries;
+    std::deque<std::pair<CacheKey, std::chrono::steady_clock::time_point>> order;
+    size_t capacity;
+
+public:
+    explicit NegativeCache(size_t maxEntries);
+
+    void Add(const CacheKey& key, std::chrono::steady_clock::duration ttl,
+             TranslationResult status = TranslationResult::SUCCESS);
+    // status is what a lookup of key should answer: SUCCESS for the text as it is
+    bool Lookup(const CacheKey& key, TranslationResult& status);
+    void Clear();
+    size_t Size() const { return entries.size(); }
+};
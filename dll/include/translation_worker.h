@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+#include "translator_core.h"
+#include "scheduler.h"
+
+// State of an asynchronous translation ticket
+enum class TicketState {
+    PENDING = 0,
+    DONE = 1,
+    FAILED = 2,
+    UNKNOWN = 3
+};
+
+// Finished translation waiting to be collected by the addon
+struct CompletedJob {
+    uint32_t ticket;
+    TranslationResult status;
+    std::string text;
+
+    CompletedJob() : ticket(0), status(TranslationResult::SUCCESS) {}
+};
+
+// Background worker that runs translations off the game's main thread.
+// Submit() only enqueues and returns a ticket; results are collected with
+// PollNext() (next finished ticket) or TakeResult() (a specific ticket).
+// Cache misses for the same language pair are gathered for up to the batch
+// window and sent as one multi-q request. Jobs are queued in a
+// TranslationScheduler, which orders them by priority class, waits for the
+// API quota and sheds stale work; shed jobs finish as OVERLOADED.
+class TranslationWorker {
+private:
+    TranslationClient& client;
+    std::thread workerThread;
+    std::mutex queueMutex;
+    std::condition_variable wakeup;
+    TranslationScheduler scheduler;
+    std::unordered_set<uint32_t> outstanding;
+    std::unordered_map<uint32_t, CompletedJob> completed;
+    std::deque<uint32_t> completedOrder;
+    uint32_t nextTicket;
+    bool running;
+    bool stopRequested;
+
+    // Batching limits
+    unsigned int batchWindowMs;
+    size_t batchMaxItems;
+    size_t batchMaxBytes;
+
+    static const size_t MAX_PENDING = 512;
+    static const size_t MAX_COMPLETED = 512;
+    static const size_t MAX_BATCH_ITEMS = 128; // v2 endpoint limit for "q"
+
+    void Run();
+    void ProcessBatch(std::vector<TranslationJob>& batch);
+    void StoreCompleted(CompletedJob&& job);
+    void StoreShed(std::vector<TranslationJob>& shed);
+
+public:
+    explicit TranslationWorker(TranslationClient& translationClient);
+    ~TranslationWorker();
+
+    bool Start();
+    void Stop();
+
+    // Returns 0 when the queue is full of work at the same or higher priority
+    uint32_t Submit(std::string_view text, std::string_view fromLang, std::string_view toLang,
+                    TranslationPriority priority = TranslationPriority::Public);
+    bool PollNext(CompletedJob& job);
+    TicketState TakeResult(uint32_t ticket, CompletedJob& job);
+    size_t PendingCount();
+
+    void SetBatchWindow(unsigned int windowMs);
+    void SetBatchMaxItems(size_t maxItems);
+    void SetBatchMaxBytes(size_t maxBytes);
+    void SetRequestQuota(unsigned int requestsPerSecond);
+    void SetCharQuota(unsigned int charsPerSecond);
+    void SetShedDeadline(TranslationPriority priority, unsigned int milliseconds);
+    SchedulerStats GetSchedulerStats();
+};
+
+// Global worker instance
+extern std::unique_ptr<TranslationWorker> g_translationWorker;
@@ -1,66 +1,167 @@
 #pragma once
 
-#include <windows.h>
-#include <winhttp.h>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <unordered_map>
 #include <memory>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
 
-// Translation result codes
-enum class TranslationResult {
-    SUCCESS = 0,
-    NETWORK_ERROR = 1,
-    API_ERROR = 2,
-    ENCODING_ERROR = 3,
-    TIMEOUT_ERROR = 4,
-    INVALID_PARAMS = 5
+#include "translation_cache.h"
+#include "translation_backend.h"
+#include "http_backend.h"
+#include "text_mask.h"
+
+// Translation memory counters: a message is a hit when every one of its
+// segments came from the cache. coalesced, negativeHits and localHits
+// count segment queries that were never sent: duplicates of one already
+// being fetched, texts answered by the negative cache or with nothing to
+// translate, and texts a local backend (phrase table) translated.
+struct TranslationMemoryStats {
+    uint64_t messages;
+    uint64_t messageHits;
+    uint64_t segments;
+    uint64_t segmentHits;
+    uint64_t coalesced;
+    uint64_t negativeHits;
+    uint64_t localHits;
+    
+    TranslationMemoryStats()
+        : messages(0), messageHits(0), segments(0), segmentHits(0), coalesced(0), negativeHits(0), localHits(0) {}
+    uint64_t SavedQueries() const { return coalesced + negativeHits + localHits; }
 };
 
-// Cache entry structure
-struct CacheEntry {
+class CacheStore;
+
+// A query one thread is fetching that others can wait for
+struct InFlightQuery {
+    bool done;
+    TranslationResult status;
     std::string translation;
-    DWORD timestamp;
     
-    CacheEntry() : translation(""), timestamp(0) {}
-    CacheEntry(const std::string& trans) 
-        : translation(trans), timestamp(GetTickCount()) {}
+    InFlightQuery() : done(false), status(TranslationResult::SUCCESS) {}
 };
 
 // Translation client class
 class TranslationClient {
 private:
-    HINTERNET hSession;
-    HINTERNET hConnect;
-    std::string apiKey;
-    std::unordered_map<std::string, CacheEntry> cache;
-    bool initialized;
+    HttpBackend remote;
+    std::vector<std::unique_ptr<TranslationBackend>> localBackends;    // asked in order before remote
+    PlaceholderMasker masker;
+    TranslationCache cache;
+    NegativeCache negativeCache;
+    std::unordered_map<CacheKey, std::shared_ptr<InFlightQuery>, CacheKeyHash> inFlight;
+    std::condition_variable inFlightDone;
+    std::unique_ptr<CacheStore> diskCache;
+    TranslationMemoryStats memoryStats;
+    std::atomic<bool> initialized;
+    
+    // Applied on the next Initialize
+    size_t diskCacheBytes;
+    bool phraseTables;
     
-    static const DWORD CACHE_EXPIRY_MS = 3600000; // 1 hour
-    static const size_t MAX_CACHE_SIZE = 1000;
+    // Requests hold clientLock shared; Initialize/Cleanup and the backend
+    // setters hold it exclusively so handles are never closed underneath
+    // the background worker.
+    mutable std::shared_mutex clientLock;
+    mutable std::mutex cacheMutex;     // also guards negativeCache, inFlight and memoryStats
+    
+    static const uint32_t DEFAULT_CACHE_EXPIRY_SECONDS = 3600; // 1 hour
+    static const size_t DEFAULT_CACHE_BYTES = 1024 * 1024;
+    static const size_t DEFAULT_DISK_CACHE_BYTES = 8 * 1024 * 1024;
+    static const size_t NEGATIVE_CACHE_ENTRIES = 4096;
+    static constexpr unsigned int FAILURE_TTL_SECONDS = 30;
+    static constexpr unsigned int UNCHANGED_TTL_SECONDS = 600;
+    
+    // Segment queries this thread is fetching: queryIndex[slot] is the text
+    // a slot stands for and keys[slot] its cache key; missSlot[i] is the
+    // slot that answers texts[i], npos when it was answered some other way
+    struct PendingQueries {
+        std::vector<CacheKey> keys;
+        std::vector<size_t> queryIndex;
+        std::vector<size_t> missSlot;
+    };
     
     // Helper methods
-    std::string UrlEncode(const std::string& text);
-    std::string HttpsRequest(const std::string& host, const std::string& path, const std::string& postData);
-    std::string ParseTranslationResponse(const std::string& jsonResponse);
-    std::string UTF8ToWide(const std::string& utf8);
-    std::string WideToUTF8(const std::wstring& wide);
-    std::string GenerateCacheKey(const std::string& text, const std::string& fromLang, const std::string& toLang);
-    void CleanExpiredCache();
+    // Translate individual segments through the caches, local backends and API;
+    // cached[i] tells whether texts[i] was answered without a request and
+    // statuses[i] is its outcome. Returns the first failure, if any.
+    TranslationResult TranslateUnits(const std::vector<std::string>& texts, const std::string& fromLang,
+                                     const std::string& toLang, std::vector<std::string>& results,
+                                     std::vector<bool>& cached, std::vector<TranslationResult>& statuses);
+    // Disk cache, local backend and API part of TranslateUnits for the slots
+    // this thread owns; translations[slot] and slotStatuses[slot] answer what
+    // is left in pending. permanent[slot] is set for a failure that would
+    // repeat for that text; see HttpBackend
+    TranslationResult FetchUnits(const std::vector<std::string>& texts, const std::string& fromLang,
+                                 const std::string& toLang, PendingQueries& pending,
+                                 std::vector<std::string>& results, std::vector<bool>& cached,
+                                 std::vector<std::string>& translations,
+                                 std::vector<TranslationResult>& slotStatuses, std::vector<bool>& permanent);
+    // Take the slots a disk cache lookup or local backend answered out of
+    // pending: fill in their texts and finish their in-flight entries.
+    // remember also puts the answers in the memory cache.
+    void ResolveAnswered(const std::vector<std::string>& texts, const std::vector<bool>& answered,
+                         const std::vector<std::string>& found, bool remember, PendingQueries& pending,
+                         std::vector<std::string>& results, std::vector<bool>& cached);
+    // Publish the outcome for keys this thread was fetching and wake waiters;
+    // statuses[slot] is keys[slot]'s outcome. Caller holds cacheMutex
+    void FinishInFlight(const std::vector<CacheKey>& keys, const std::vector<TranslationResult>& statuses,
+                        const std::vector<std::string>& translations);
+    void CleanupLocked();
     
 public:
     TranslationClient();
     ~TranslationClient();
     
+    // An empty key leaves only the local backends (offline)
     bool Initialize(const std::string& key);
     void Cleanup();
-    TranslationResult TranslateText(const std::string& text, const std::string& fromLang, 
-                                   const std::string& toLang, std::string& result);
+    // Stop the client's background threads (the connection pool's
+    // maintenance thread and the disk cache loader) but keep the memory
+    // cache; Initialize starts them again. Not from DllMain: it joins threads.
+    void Shutdown();
+    void SetEndpoint(const std::string& url);
+    void SetConnectionPoolSize(size_t size);
+    void SetKeepAliveInterval(uint32_t intervalMs);
+    void SetCacheExpiry(uint32_t seconds);
+    void SetCacheBudget(size_t bytes);
+    // Size limit of the persistent cache file; 0 disables it
+    void SetDiskCacheBudget(size_t bytes);
+    // See HttpBackend
+    void SetRequestTimeout(uint32_t timeoutMs);
+    void SetRetryAttempts(unsigned int attempts);
+    void SetHedging(bool enabled);
+    void SetBreakerThreshold(unsigned int failures);
+    void SetBreakerOpenTime(unsigned int openMs);
+    RequestQuota& Quota() { return remote.Quota(); }
+    // Answer from CET_phrases_<from>_<to>.tsv tables before the API
+    void SetPhraseTables(bool enabled);
+    // Placeholders for links, numbers and glossary words; see PlaceholderMasker
+    void SetMasking(bool enabled);
+    void SetGlossaryTerms(const std::vector<std::string>& terms);
+    void SetGlossaryNames(const std::vector<std::string>& names);
+    TranslationResult TranslateText(std::string_view text, std::string_view fromLang, 
+                                   std::string_view toLang, std::string& result);
+    // Translate several texts for one language pair in a single API request;
+    // results[i] and statuses[i] correspond to texts[i]. A text that fails
+    // does not fail the others; returns the first failure, if any.
+    TranslationResult TranslateBatch(const std::vector<std::string>& texts, const std::string& fromLang,
+                                     const std::string& toLang, std::vector<std::string>& results,
+                                     std::vector<TranslationResult>& statuses);
+    // Memory (and, if it is free, disk) cache lookup for the game thread;
+    // result's buffer is reused, so a hit does not allocate once it has grown
+    bool LookupCached(std::string_view text, std::string_view fromLang,
+                      std::string_view toLang, std::string& result);
+    TranslationMemoryStats GetMemoryStats() const;
+    // Memory cache counters, plus its entry count and size in bytes
+    TranslationCacheStats GetCacheStats(size_t& entries, size_t& bytes) const;
+    ResilienceStats GetResilienceStats() const;
     bool IsInitialized() const { return initialized; }
 };
 
 // Global translation instance
 extern std::unique_ptr<TranslationClient> g_translator;
-
-// Static buffers for Lua interface
-extern char g_translation_buffer[4096];
-extern char g_error_buffer[256];
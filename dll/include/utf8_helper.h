@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+// UTF-8 validation and repair. Validation follows the Unicode well-formed
+// byte sequence table, so overlong forms, surrogates and code points past
+// U+10FFFF are rejected. Runs of ASCII are checked 16 bytes at a time with
+// SSE2 where available.
+class UTF8Helper {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    // Offset of the first byte that is not part of a well-formed sequence,
+    // or npos if the whole text is valid
+    static size_t FindInvalid(std::string_view text);
+    static bool IsValid(std::string_view text) { return FindInvalid(text) == npos; }
+
+    // Copy of text with every maximal ill-formed subsequence replaced by
+    // U+FFFD, cut at a character boundary so it is at most maxBytes long
+    static std::string Repair(std::string_view text, size_t maxBytes = npos);
+
+    // Longest prefix of a valid text that fits in maxBytes without splitting
+    // a character
+    static size_t SafeTruncateLength(std::string_view text, size_t maxBytes);
+
+    // Characters in a valid text: every byte that does not continue a sequence
+    static size_t CodePointCount(std::string_view text) {
+        size_t count = 0;
+        for (char c : text) {
+            count += (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+        }
+        return count;
+    }
+
+    // Repair text coming back from the API before it reaches the chat frame
+    static std::string FixUTF8String(const std::string& input) { return Repair(input); }
+};
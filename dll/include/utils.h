@@ -2,14 +2,25 @@
 
 #include <string>
 #include <vector>
+#include <ctime>
+
+#ifndef _WIN32
+// The MSVC name, so callers need no #ifdef
+inline void localtime_s(std::tm* result, const std::time_t* when) { localtime_r(when, result); }
+#endif
 
 // Utility functions
 std::string GetCurrentTimestamp();
 std::string GetDllPath();
+std::string GetDllDirectoryPath();
+// directory + separator + name, with the platform's separator
+std::string JoinPath(const std::string& directory, const std::string& name);
 std::vector<std::string> SplitString(const std::string& str, char delimiter);
 std::string TrimString(const std::string& str);
 bool IsValidLanguageCode(const std::string& lang);
 
+#ifdef _WIN32
 // Memory utility functions
 bool IsValidMemoryAddress(void* addr);
 void* SafeGetProcAddress(HMODULE hModule, const char* procName);
+#endif
@@ -0,0 +1,176 @@
+// aho_corasick.cpp - Multi-pattern string matching for CET
+
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+#include "../include/aho_corasick.h"
+
+using namespace std;
+
+AhoCorasick::AhoCorasick(bool foldAsciiCase) : foldCase(foldAsciiCase), built(false) {
+    Clear();
+}
+
+void AhoCorasick::Clear() {
+    nodes.assign(1, Node{ 0, 0, ROOT, NO_MATCH, NO_MATCH });
+    building.assign(1, vector<Edge>());
+    edges.clear();
+    patternLengths.clear();
+    fill(begin(rootNext), end(rootNext), ROOT);
+    built = false;
+}
+
+uint8_t AhoCorasick::Fold(char c) const {
+    uint8_t byte = static_cast<uint8_t>(c);
+    if (foldCase && byte >= 'A' && byte <= 'Z') {
+        byte = static_cast<uint8_t>(byte + ('a' - 'A'));
+    }
+    return byte;
+}
+
+uint32_t AhoCorasick::Add(string_view pattern) {
+    if (pattern.empty()) {
+        return NO_MATCH;
+    }
+
+    uint32_t node = ROOT;
+    for (char c : pattern) {
+        uint8_t byte = Fold(c);
+        uint32_t next = NO_MATCH;
+        for (const Edge& edge : building[node]) {
+            if (edge.byte == byte) {
+                next = edge.target;
+                break;
+            }
+        }
+
+        if (next == NO_MATCH) {
+            next = static_cast<uint32_t>(nodes.size());
+            nodes.push_back(Node{ 0, 0, ROOT, NO_MATCH, NO_MATCH });
+            building.emplace_back();
+            building[node].push_back(Edge{ byte, next });
+        }
+        node = next;
+    }
+
+    if (nodes[node].output == NO_MATCH) {
+        nodes[node].output = static_cast<uint32_t>(patternLengths.size());
+        patternLengths.push_back(static_cast<uint32_t>(pattern.size()));
+    }
+    built = false;
+    return nodes[node].output;
+}
+
+uint32_t AhoCorasick::Child(uint32_t node, uint8_t byte) const {
+    auto first = edges.begin() + nodes[node].firstEdge;
+    auto last = first + nodes[node].edgeCount;
+    auto it = lower_bound(first, last, byte, [](const Edge& edge, uint8_t value) { return edge.byte < value; });
+    return (it != last && it->byte == byte) ? it->target : NO_MATCH;
+}
+
+uint32_t AhoCorasick::Step(uint32_t state, uint8_t byte) const {
+    while (state != ROOT) {
+        uint32_t next = Child(state, byte);
+        if (next != NO_MATCH) {
+            return next;
+        }
+        state = nodes[state].fail;
+    }
+    return rootNext[byte];
+}
+
+void AhoCorasick::Build() {
+    // Flatten the edge lists, sorted for binary search
+    edges.clear();
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        vector<Edge>& list = building[i];
+        sort(list.begin(), list.end(), [](const Edge& a, const Edge& b) { return a.byte < b.byte; });
+        nodes[i].firstEdge = static_cast<uint32_t>(edges.size());
+        nodes[i].edgeCount = static_cast<uint32_t>(list.size());
+        edges.insert(edges.end(), list.begin(), list.end());
+    }
+
+    fill(begin(rootNext), end(rootNext), ROOT);
+    for (const Edge& edge : building[ROOT]) {
+        rootNext[edge.byte] = edge.target;
+    }
+
+    // Failure links breadth first: a node's link depends only on shallower nodes
+    deque<uint32_t> queue;
+    for (const Edge& edge : building[ROOT]) {
+        nodes[edge.target].fail = ROOT;
+        nodes[edge.target].nextOutput = NO_MATCH;
+        queue.push_back(edge.target);
+    }
+
+    while (!queue.empty()) {
+        uint32_t node = queue.front();
+        queue.pop_front();
+
+        for (const Edge& edge : building[node]) {
+            uint32_t fail = Step(nodes[node].fail, edge.byte);
+            Node& child = nodes[edge.target];
+            child.fail = fail;
+            child.nextOutput = nodes[fail].output != NO_MATCH ? fail : nodes[fail].nextOutput;
+            queue.push_back(edge.target);
+        }
+    }
+
+    built = true;
+}
+
+void AhoCorasick::FindLongest(string_view text, vector<PatternMatch>& matches, MatchFilter accept) const {
+    matches.clear();
+    if (!built || patternLengths.empty() || text.empty()) {
+        return;
+    }
+
+    // Longest accepted match starting at each position
+    static thread_local vector<uint32_t> longest;
+    longest.assign(text.size(), NO_MATCH);
+
+    uint32_t state = ROOT;
+    for (size_t i = 0; i < text.size(); ++i) {
+        state = Step(state, Fold(text[i]));
+
+        uint32_t node = nodes[state].output != NO_MATCH ? state : nodes[state].nextOutput;
+        for (; node != NO_MATCH; node = nodes[node].nextOutput) {
+            uint32_t pattern = nodes[node].output;
+            size_t length = patternLengths[pattern];
+            size_t start = i + 1 - length;
+            if (accept && !accept(text, start, length)) {
+                continue;
+            }
+            if (longest[start] == NO_MATCH || length > patternLengths[longest[start]]) {
+                longest[start] = pattern;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < text.size();) {
+        if (longest[i] == NO_MATCH) {
+            ++i;
+            continue;
+        }
+        size_t length = patternLengths[longest[i]];
+        matches.push_back(PatternMatch{ i, length, longest[i] });
+        i += length;
+    }
+}
+
+static inline bool IsWordByte(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '\'';
+}
+
+bool OnWordBoundary(string_view text, size_t start, size_t length) {
+    size_t end = start + length;
+    if (start > 0 && IsWordByte(text[start - 1]) && IsWordByte(text[start])) {
+        return false;
+    }
+    if (end < text.size() && IsWordByte(text[end]) && IsWordByte(text[end - 1])) {
+        return false;
+    }
+    return true;
+}
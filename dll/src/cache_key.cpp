@@ -0,0 +1,199 @@
+// cache_key.cpp - Normalized, hashed translation cache keys for CET
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <cstring>
+
+#include "../include/cache_key.h"
+
+using namespace std;
+
+// Ids are persisted in CET_cache.bin: only ever append to this table
+static const char* const LANGUAGE_CODES[] = {
+    "af", "sq", "am", "ar", "hy", "az", "eu", "be", "bn", "bs", "bg", "ca", "ceb", "ny",
+    "zh", "zh-cn", "zh-tw", "co", "hr", "cs", "da", "nl", "en", "eo", "et", "tl", "fi",
+    "fr", "fy", "gl", "ka", "de", "el", "gu", "ht", "ha", "haw", "iw", "he", "hi", "hmn",
+    "hu", "is", "ig", "id", "ga", "it", "ja", "jw", "kn", "kk", "km", "ko", "ku", "ky",
+    "lo", "la", "lv", "lt", "lb", "mk", "mg", "ms", "ml", "mt", "mi", "mr", "mn", "my",
+    "ne", "no", "or", "ps", "fa", "pl", "pt", "pa", "ro", "ru", "sm", "gd", "sr", "st",
+    "sn", "sd", "si", "sk", "sl", "so", "es", "su", "sw", "sv", "tg", "ta", "te", "th",
+    "tr", "uk", "ur", "ug", "uz", "vi", "cy", "xh", "yi", "yo", "zu"
+};
+
+static inline uint64_t RotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t FinalMix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint64_t HashBytes(string_view bytes) {
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char c : bytes) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static inline bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Feed the canonical form of text to sink one byte at a time, without
+// building it in memory
+template <typename Sink>
+static void ForEachCanonicalByte(string_view text, Sink& sink) {
+    bool pendingSpace = false;
+    bool emitted = false;
+    size_t i = 0;
+
+    auto emit = [&](char c) {
+        if (pendingSpace) {
+            sink(' ');
+            pendingSpace = false;
+        }
+        sink(c);
+        emitted = true;
+    };
+
+    while (i < text.size()) {
+        char c = text[i];
+
+        if (IsSpace(c)) {
+            pendingSpace = emitted;
+            ++i;
+            continue;
+        }
+
+        // Only ASCII is folded; multi-byte UTF-8 passes through untouched
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+        emit(c);
+        ++i;
+    }
+}
+
+// Streaming 128-bit hash (MurmurHash3 x64 block mixing) over canonical bytes
+class CanonicalHasher {
+private:
+    uint64_t h1;
+    uint64_t h2;
+    uint64_t block;
+    unsigned filled;
+    uint64_t length;
+
+    static const uint64_t C1 = 0x87c37b91114253d5ULL;
+    static const uint64_t C2 = 0x4cf5ad432745937fULL;
+
+    void MixBlock(uint64_t k1, uint64_t k2) {
+        k1 *= C1; k1 = RotateLeft(k1, 31); k1 *= C2; h1 ^= k1;
+        h1 = RotateLeft(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= C2; k2 = RotateLeft(k2, 33); k2 *= C1; h2 ^= k2;
+        h2 = RotateLeft(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+public:
+    explicit CanonicalHasher(uint64_t seed) : h1(seed), h2(seed), block(0), filled(0), length(0) {}
+
+    void operator()(char c) {
+        block |= static_cast<uint64_t>(static_cast<unsigned char>(c)) << (filled * 8);
+        ++length;
+        if (++filled == 8) {
+            MixBlock(block, RotateLeft(block, 32) ^ length);
+            block = 0;
+            filled = 0;
+        }
+    }
+
+    void Finish(uint64_t& high, uint64_t& low) {
+        if (filled > 0) {
+            MixBlock(block, RotateLeft(block, 32) ^ length);
+        }
+
+        h1 ^= length;
+        h2 ^= length;
+        h1 += h2;
+        h2 += h1;
+        h1 = FinalMix(h1);
+        h2 = FinalMix(h2);
+        h1 += h2;
+        h2 += h1;
+
+        high = h1;
+        low = h2;
+    }
+};
+
+uint16_t LanguageId(string_view code) {
+    static const unordered_map<string_view, uint16_t> ids = [] {
+        unordered_map<string_view, uint16_t> table;
+        for (size_t i = 0; i < sizeof(LANGUAGE_CODES) / sizeof(LANGUAGE_CODES[0]); ++i) {
+            table.emplace(LANGUAGE_CODES[i], static_cast<uint16_t>(i + 1));
+        }
+        return table;
+    }();
+
+    char lower[16];
+    if (code.size() <= sizeof(lower)) {
+        for (size_t i = 0; i < code.size(); ++i) {
+            char c = code[i];
+            lower[i] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+
+        auto found = ids.find(string_view(lower, code.size()));
+        if (found != ids.end()) {
+            return found->second;
+        }
+    }
+
+    return static_cast<uint16_t>(0x8000 | (HashBytes(code) & 0x7fff));
+}
+
+CacheKey MakeCacheKey(string_view text, string_view fromLang, string_view toLang) {
+    CacheKey key;
+    key.fromLanguage = LanguageId(fromLang);
+    key.toLanguage = LanguageId(toLang);
+
+    // Hashed ids can collide, so unknown codes also seed the text hash
+    uint64_t seed = ((static_cast<uint64_t>(key.fromLanguage) << 16) | key.toLanguage) * 0x9e3779b97f4a7c15ULL;
+    if (key.fromLanguage & 0x8000) {
+        seed ^= HashBytes(fromLang);
+    }
+    if (key.toLanguage & 0x8000) {
+        seed ^= RotateLeft(HashBytes(toLang), 1);
+    }
+
+    CanonicalHasher hasher(seed);
+    ForEachCanonicalByte(text, hasher);
+    hasher.Finish(key.hashHigh, key.hashLow);
+    return key;
+}
+
+string CanonicalizeText(string_view text) {
+    string result;
+    result.reserve(text.size());
+
+    auto append = [&result](char c) { result += c; };
+    ForEachCanonicalByte(text, append);
+    return result;
+}
+
+string SerializeCacheKey(const CacheKey& key) {
+    char buffer[CACHE_KEY_BYTES];
+    memcpy(buffer, &key.hashHigh, 8);
+    memcpy(buffer + 8, &key.hashLow, 8);
+    memcpy(buffer + 16, &key.fromLanguage, 2);
+    memcpy(buffer + 18, &key.toLanguage, 2);
+    return string(buffer, sizeof(buffer));
+}
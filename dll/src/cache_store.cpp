@@ -0,0 +1,534 @@
+// cache_store.cpp - Persistent on-disk translation cache for CET
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#endif
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+
+#include "../include/cache_store.h"
+#include "../include/logging.h"
+
+using namespace std;
+
+static const char CACHE_MAGIC[4] = { 'C', 'E', 'T', 'C' };
+
+static uint32_t ReadU32(const char* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static void WriteU32(string& buffer, uint32_t value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// File access for the store: the cache file is opened for reading and
+// appending, compaction writes a new file and renames it over the old one
+#ifdef _WIN32
+typedef HANDLE CacheFileHandle;
+static const CacheFileHandle NO_CACHE_FILE = INVALID_HANDLE_VALUE;
+
+static CacheFileHandle OpenCacheFile(const string& filePath) {
+    return CreateFileA(filePath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                       nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+}
+
+static CacheFileHandle CreateCacheFile(const string& filePath) {
+    return CreateFileA(filePath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+}
+
+static void CloseCacheFile(CacheFileHandle hFile) {
+    CloseHandle(hFile);
+}
+
+static bool SeekTo(CacheFileHandle hFile, uint64_t offset) {
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<LONGLONG>(offset);
+    return SetFilePointerEx(hFile, position, nullptr, FILE_BEGIN) != 0;
+}
+
+static bool WriteAll(CacheFileHandle hFile, const string& buffer) {
+    DWORD written = 0;
+    return WriteFile(hFile, buffer.data(), static_cast<DWORD>(buffer.size()), &written, nullptr) &&
+           written == buffer.size();
+}
+
+static bool ReadAt(CacheFileHandle hFile, uint64_t offset, string& buffer) {
+    DWORD bytesRead = 0;
+    return SeekTo(hFile, offset) &&
+           ReadFile(hFile, &buffer[0], static_cast<DWORD>(buffer.size()), &bytesRead, nullptr) &&
+           bytesRead == buffer.size();
+}
+
+// Cut the file off at the current position
+static bool TruncateHere(CacheFileHandle hFile, uint64_t /*offset*/) {
+    return SetEndOfFile(hFile) != 0;
+}
+
+static bool FlushCacheFile(CacheFileHandle hFile) {
+    return FlushFileBuffers(hFile) != 0;
+}
+
+static bool ReplaceCacheFile(const string& from, const string& to) {
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+static void RemoveCacheFile(const string& filePath) {
+    DeleteFileA(filePath.c_str());
+}
+#else
+typedef int CacheFileHandle;
+static const CacheFileHandle NO_CACHE_FILE = -1;
+
+static CacheFileHandle OpenCacheFile(const string& filePath) {
+    return open(filePath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+}
+
+static CacheFileHandle CreateCacheFile(const string& filePath) {
+    return open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+}
+
+static void CloseCacheFile(CacheFileHandle fd) {
+    close(fd);
+}
+
+static bool SeekTo(CacheFileHandle fd, uint64_t offset) {
+    return lseek(fd, static_cast<off_t>(offset), SEEK_SET) != static_cast<off_t>(-1);
+}
+
+static bool WriteAll(CacheFileHandle fd, const string& buffer) {
+    size_t done = 0;
+    while (done < buffer.size()) {
+        ssize_t written = write(fd, buffer.data() + done, buffer.size() - done);
+        if (written <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+static bool ReadAt(CacheFileHandle fd, uint64_t offset, string& buffer) {
+    return pread(fd, &buffer[0], buffer.size(), static_cast<off_t>(offset)) ==
+           static_cast<ssize_t>(buffer.size());
+}
+
+static bool TruncateHere(CacheFileHandle fd, uint64_t offset) {
+    return ftruncate(fd, static_cast<off_t>(offset)) == 0;
+}
+
+static bool FlushCacheFile(CacheFileHandle fd) {
+    return fsync(fd) == 0;
+}
+
+static bool ReplaceCacheFile(const string& from, const string& to) {
+    return rename(from.c_str(), to.c_str()) == 0;
+}
+
+static void RemoveCacheFile(const string& filePath) {
+    unlink(filePath.c_str());
+}
+#endif
+
+CacheStore::CacheStore()
+    : hWrite(NO_CACHE_FILE), loaded(false), fileBytes(0), liveBytes(0),
+      maxBytes(8 * 1024 * 1024), appendsSinceCheck(0) {
+}
+
+CacheStore::~CacheStore() {
+    Close();
+}
+
+uint64_t CacheStore::HashKey(string_view key) {
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char c : key) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint32_t CacheStore::Checksum(string_view key, string_view value) {
+    // 32-bit FNV-1a over key and value; catches torn writes at the file tail
+    uint32_t hash = 0x811c9dc5u;
+    for (string_view part : { key, value }) {
+        for (char c : part) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 0x01000193u;
+        }
+    }
+    return hash;
+}
+
+uint64_t CacheStore::RecordSize(const Location& location) {
+    return RECORD_HEADER_SIZE + location.keyLength + location.valueLength;
+}
+
+void CacheStore::EncodeRecord(string& buffer, string_view key, string_view value) {
+    WriteU32(buffer, static_cast<uint32_t>(key.size()));
+    WriteU32(buffer, static_cast<uint32_t>(value.size()));
+    WriteU32(buffer, Checksum(key, value));
+    buffer.append(key.data(), key.size());
+    buffer.append(value.data(), value.size());
+}
+
+void CacheStore::Open(const string& filePath, size_t maxFileBytes) {
+    Close();
+
+    path = filePath;
+    SetMaxBytes(maxFileBytes);
+
+    // Mapping and indexing happen off the caller's thread
+    loaderThread = thread(&CacheStore::Load, this);
+}
+
+void CacheStore::Close() {
+    if (loaderThread.joinable()) {
+        loaderThread.join();
+    }
+
+    lock_guard<mutex> lock(storeMutex);
+    CloseLocked();
+}
+
+void CacheStore::CloseLocked() {
+    loaded = false;
+    mapping.Close();
+
+    if (hWrite != NO_CACHE_FILE) {
+        CloseCacheFile(hWrite);
+        hWrite = NO_CACHE_FILE;
+    }
+
+    index.clear();
+    fileBytes = 0;
+    liveBytes = 0;
+    appendsSinceCheck = 0;
+}
+
+void CacheStore::SetMaxBytes(size_t maxFileBytes) {
+    lock_guard<mutex> lock(storeMutex);
+    maxBytes = max<size_t>(maxFileBytes, 64 * 1024);
+}
+
+size_t CacheStore::Size() const {
+    lock_guard<mutex> lock(storeMutex);
+    return index.size();
+}
+
+void CacheStore::Load() {
+    lock_guard<mutex> lock(storeMutex);
+
+    unordered_map<uint64_t, Location> newIndex;
+    uint64_t validEnd = 0;
+    uint64_t live = 0;
+    bool clean = true;
+
+    if (mapping.Open(path)) {
+        clean = BuildIndex(newIndex, validEnd, live);
+    }
+
+    index.swap(newIndex);
+    fileBytes = validEnd;
+    liveBytes = live;
+
+    if (!OpenForAppend()) {
+        LOG_ERROR("Failed to open disk cache for writing: ", path);
+        CloseLocked();
+        return;
+    }
+
+    if (!clean && fileBytes > HEADER_SIZE) {
+        LOG_WARNING("Disk cache has a damaged tail, compacting");
+    }
+    if ((!clean && fileBytes > HEADER_SIZE) || NeedsCompaction()) {
+        CompactLocked();
+        if (hWrite == NO_CACHE_FILE) {
+            return;
+        }
+    }
+
+    loaded = true;
+    LOG_INFO("Disk cache loaded: ", index.size(), " entries, ",
+             fileBytes, " bytes");
+}
+
+bool CacheStore::BuildIndex(unordered_map<uint64_t, Location>& newIndex, uint64_t& validEnd, uint64_t& live) {
+    const char* data = mapping.Data();
+    uint64_t size = mapping.Size();
+
+    validEnd = 0;
+    live = 0;
+
+    if (size < HEADER_SIZE || memcmp(data, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        ReadU32(data + 4) != FORMAT_VERSION) {
+        LOG_WARNING("Ignoring disk cache with unknown format: ", path);
+        return false;
+    }
+
+    uint64_t pos = HEADER_SIZE;
+    while (pos + RECORD_HEADER_SIZE <= size) {
+        Location location;
+        location.offset = pos;
+        location.keyLength = ReadU32(data + pos);
+        location.valueLength = ReadU32(data + pos + 4);
+
+        if (location.keyLength == 0 || location.keyLength > MAX_FIELD_LENGTH ||
+            location.valueLength > MAX_FIELD_LENGTH || pos + RecordSize(location) > size) {
+            break;
+        }
+
+        string_view key(data + pos + RECORD_HEADER_SIZE, location.keyLength);
+        string_view value(key.data() + key.size(), location.valueLength);
+        if (Checksum(key, value) != ReadU32(data + pos + 8)) {
+            break;
+        }
+
+        // Later records supersede earlier ones
+        auto result = newIndex.emplace(HashKey(key), location);
+        if (!result.second) {
+            live -= RecordSize(result.first->second);
+            result.first->second = location;
+        }
+        live += RecordSize(location);
+        pos += RecordSize(location);
+    }
+
+    validEnd = pos;
+    return pos == size;
+}
+
+bool CacheStore::OpenForAppend() {
+    hWrite = OpenCacheFile(path);
+    if (hWrite == NO_CACHE_FILE) {
+        return false;
+    }
+
+    if (fileBytes >= HEADER_SIZE) {
+        return true;
+    }
+
+    // New or unusable file: start over with a fresh header. The mapping has
+    // to go first, a mapped file cannot be truncated.
+    mapping.Close();
+    index.clear();
+    liveBytes = 0;
+
+    string header(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    WriteU32(header, FORMAT_VERSION);
+    header.append(HEADER_SIZE - header.size(), '\0');
+
+    if (!SeekTo(hWrite, 0) || !WriteAll(hWrite, header) || !TruncateHere(hWrite, header.size())) {
+        CloseCacheFile(hWrite);
+        hWrite = NO_CACHE_FILE;
+        return false;
+    }
+
+    fileBytes = HEADER_SIZE;
+    return true;
+}
+
+bool CacheStore::ReadRecord(const Location& location, string& key, string& value) {
+    uint64_t dataStart = location.offset + RECORD_HEADER_SIZE;
+
+    // Records present at startup are served straight from the mapping
+    if (mapping.IsOpen() && location.offset + RecordSize(location) <= mapping.Size()) {
+        const char* data = mapping.Data() + dataStart;
+        key.assign(data, location.keyLength);
+        value.assign(data + location.keyLength, location.valueLength);
+        return true;
+    }
+
+    // Appended this session, beyond the end of the mapping
+    string buffer(location.keyLength + location.valueLength, '\0');
+    if (hWrite == NO_CACHE_FILE || !ReadAt(hWrite, dataStart, buffer)) {
+        return false;
+    }
+
+    key.assign(buffer, 0, location.keyLength);
+    value.assign(buffer, location.keyLength, string::npos);
+    return true;
+}
+
+bool CacheStore::LookupLocked(string_view key, string& value) {
+    auto found = index.find(HashKey(key));
+    if (found == index.end() || found->second.keyLength != key.size()) {
+        return false;
+    }
+
+    string storedKey;
+    string storedValue;
+    if (!ReadRecord(found->second, storedKey, storedValue) || storedKey != key) {
+        return false;
+    }
+
+    value.swap(storedValue);
+    return true;
+}
+
+bool CacheStore::Lookup(string_view key, string& value) {
+    if (!loaded) {
+        return false;
+    }
+
+    lock_guard<mutex> lock(storeMutex);
+    return loaded && LookupLocked(key, value);
+}
+
+bool CacheStore::TryLookup(string_view key, string& value) {
+    if (!loaded) {
+        return false;
+    }
+
+    unique_lock<mutex> lock(storeMutex, try_to_lock);
+    return lock.owns_lock() && loaded && LookupLocked(key, value);
+}
+
+void CacheStore::Append(const string& key, const string& value) {
+    if (!loaded || key.empty() || key.size() > MAX_FIELD_LENGTH || value.size() > MAX_FIELD_LENGTH) {
+        return;
+    }
+
+    lock_guard<mutex> lock(storeMutex);
+    if (!loaded || hWrite == NO_CACHE_FILE) {
+        return;
+    }
+
+    uint64_t hash = HashKey(key);
+    auto found = index.find(hash);
+    if (found != index.end()) {
+        string storedKey;
+        string storedValue;
+        if (ReadRecord(found->second, storedKey, storedValue) && storedKey == key && storedValue == value) {
+            return;
+        }
+    }
+
+    string record;
+    record.reserve(RECORD_HEADER_SIZE + key.size() + value.size());
+    EncodeRecord(record, key, value);
+
+    if (!SeekTo(hWrite, fileBytes) || !WriteAll(hWrite, record)) {
+        LOG_ERROR("Failed to append to disk cache");
+        return;
+    }
+
+    Location location;
+    location.offset = fileBytes;
+    location.keyLength = static_cast<uint32_t>(key.size());
+    location.valueLength = static_cast<uint32_t>(value.size());
+
+    if (found != index.end()) {
+        liveBytes -= RecordSize(found->second);
+        found->second = location;
+    } else {
+        index.emplace(hash, location);
+    }
+    liveBytes += record.size();
+    fileBytes += record.size();
+
+    if (++appendsSinceCheck >= COMPACTION_CHECK_INTERVAL) {
+        appendsSinceCheck = 0;
+        if (NeedsCompaction()) {
+            CompactLocked();
+        }
+    }
+}
+
+bool CacheStore::NeedsCompaction() const {
+    uint64_t garbage = fileBytes - HEADER_SIZE - liveBytes;
+    return (garbage > liveBytes && garbage > 64 * 1024) || fileBytes > maxBytes;
+}
+
+void CacheStore::CompactLocked() {
+    string tempPath = path + ".tmp";
+    CacheFileHandle hTemp = CreateCacheFile(tempPath);
+    if (hTemp == NO_CACHE_FILE) {
+        LOG_ERROR("Failed to create disk cache compaction file: ", tempPath);
+        return;
+    }
+
+    // Oldest records first, so the size limit drops the oldest translations.
+    // Trim to 3/4 of the limit to leave room before the next compaction.
+    vector<Location> records;
+    records.reserve(index.size());
+    for (const auto& entry : index) {
+        records.push_back(entry.second);
+    }
+    sort(records.begin(), records.end(),
+         [](const Location& a, const Location& b) { return a.offset < b.offset; });
+
+    uint64_t budget = maxBytes / 4 * 3;
+    uint64_t total = HEADER_SIZE + liveBytes;
+    size_t first = 0;
+    while (first < records.size() && total > budget) {
+        total -= RecordSize(records[first]);
+        ++first;
+    }
+
+    string buffer(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    WriteU32(buffer, FORMAT_VERSION);
+    buffer.append(HEADER_SIZE - buffer.size(), '\0');
+
+    unordered_map<uint64_t, Location> newIndex;
+    uint64_t newSize = HEADER_SIZE;
+    bool ok = true;
+    string key;
+    string value;
+
+    for (size_t i = first; i < records.size() && ok; ++i) {
+        if (!ReadRecord(records[i], key, value)) {
+            continue;
+        }
+
+        Location location = records[i];
+        location.offset = newSize;
+        EncodeRecord(buffer, key, value);
+        newIndex.emplace(HashKey(key), location);
+        newSize += RecordSize(location);
+
+        if (buffer.size() >= 64 * 1024) {
+            ok = WriteAll(hTemp, buffer);
+            buffer.clear();
+        }
+    }
+    ok = ok && WriteAll(hTemp, buffer) && FlushCacheFile(hTemp);
+    CloseCacheFile(hTemp);
+
+    if (!ok) {
+        LOG_ERROR("Failed to write compacted disk cache");
+        RemoveCacheFile(tempPath);
+        return;
+    }
+
+    // The file can only be replaced once nothing maps or holds it open
+    mapping.Close();
+    CloseCacheFile(hWrite);
+    hWrite = NO_CACHE_FILE;
+
+    if (ReplaceCacheFile(tempPath, path)) {
+        LOG_INFO("Disk cache compacted: ", fileBytes, " -> ", newSize, " bytes");
+        index.swap(newIndex);
+        fileBytes = newSize;
+        liveBytes = newSize - HEADER_SIZE;
+    } else {
+        LOG_ERROR("Failed to replace disk cache with compacted file");
+        RemoveCacheFile(tempPath);
+    }
+
+    mapping.Open(path);
+    if (!OpenForAppend()) {
+        LOG_ERROR("Failed to reopen disk cache: ", path);
+        CloseLocked();
+    }
+}
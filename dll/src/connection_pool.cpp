@@ -0,0 +1,1039 @@
+// connection_pool.cpp - Persistent HTTP connections for CET
+// Keeps warm connections to the translation endpoint between requests:
+// WinHTTP sessions on Windows, plain HTTP/1.1 sockets elsewhere
+
+#ifdef _WIN32
+#include <windows.h>
+#include <winhttp.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#endif
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+#include "../include/connection_pool.h"
+#include "../include/logging.h"
+
+using namespace std;
+
+// Millisecond tick count for deadlines and idle times; the casts keep the
+// comparisons correct across its 49.7 day wrap
+static inline uint32_t TickCount() {
+    return static_cast<uint32_t>(
+        chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static inline bool DeadlinePassed(uint32_t deadline) {
+    return static_cast<int32_t>(TickCount() - deadline) >= 0;
+}
+
+// Upper bound on one keep-alive probe; probes are also kept within the
+// keep-alive interval so a dead server cannot stall the maintenance thread
+static const uint32_t MAX_PROBE_TIMEOUT_MS = 10000;
+
+static inline int RemainingMs(uint32_t deadline) {
+    int32_t remaining = static_cast<int32_t>(deadline - TickCount());
+    return remaining > 0 ? remaining : 1;
+}
+
+PostControl::PostControl(uint32_t timeoutMilliseconds)
+#ifdef _WIN32
+    : hRequest(nullptr), inCall(false),
+#else
+    : requestSocket(-1),
+#endif
+      cancelled(false), timedOut(false), timeoutMs(timeoutMilliseconds) {
+}
+
+bool PostControl::Cancelled() {
+    lock_guard<mutex> lock(controlMutex);
+    return cancelled;
+}
+
+bool PostControl::TimedOut() {
+    lock_guard<mutex> lock(controlMutex);
+    return timedOut;
+}
+
+ConnectionPool::ConnectionPool()
+    : stopRequested(false), probeControl(nullptr), port(443), secure(true), keepAliveMs(45000), firstRequestDone(false) {
+}
+
+ConnectionPool::~ConnectionPool() {
+    Close();
+}
+
+#ifdef _WIN32
+// Closing the handle is the only way to abort a synchronous WinHTTP call, so
+// Cancel does it while the owner is blocked in one. Between calls it only
+// sets the flag: the owner checks it before every call and closes the
+// handle itself, so no call is started on a handle closed underneath it.
+void PostControl::Cancel() {
+    lock_guard<mutex> lock(controlMutex);
+    cancelled = true;
+    if (hRequest && inCall) {
+        WinHttpCloseHandle(hRequest);
+        hRequest = nullptr;
+    }
+}
+
+bool ConnectionPool::ParseEndpoint(const string& url) {
+    wstring wUrl(url.begin(), url.end());
+
+    URL_COMPONENTS parts = {};
+    parts.dwStructSize = sizeof(parts);
+    parts.dwSchemeLength = (DWORD)-1;
+    parts.dwHostNameLength = (DWORD)-1;
+    parts.dwUrlPathLength = (DWORD)-1;
+    parts.dwExtraInfoLength = (DWORD)-1;
+
+    if (!WinHttpCrackUrl(wUrl.c_str(), 0, 0, &parts)) {
+        LOG_ERROR("Invalid translation endpoint: ", url);
+        return false;
+    }
+
+    host.assign(parts.lpszHostName, parts.dwHostNameLength);
+    port = parts.nPort;
+    secure = (parts.nScheme == INTERNET_SCHEME_HTTPS);
+
+    wstring wPath(parts.lpszUrlPath, parts.dwUrlPathLength);
+    path.assign(wPath.begin(), wPath.end());
+    if (path.empty()) {
+        path = "/";
+    }
+
+    return !host.empty();
+}
+
+bool ConnectionPool::OpenConnection(Connection& connection) {
+    connection.hSession = WinHttpOpen(L"CET Translator/1.0",
+                                      WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+                                      WINHTTP_NO_PROXY_NAME,
+                                      WINHTTP_NO_PROXY_BYPASS,
+                                      0);
+    if (!connection.hSession) {
+        LOG_ERROR("Failed to initialize WinHTTP session");
+        return false;
+    }
+    // WinHttpConnect below only records the server; the TCP connects happen
+    // inside requests and are reported through this callback
+    WinHttpSetStatusCallback(connection.hSession, &ConnectionPool::StatusCallback,
+                             WINHTTP_CALLBACK_FLAG_CONNECT_TO_SERVER, 0);
+
+    connection.hConnect = WinHttpConnect(connection.hSession, host.c_str(), port, 0);
+    if (!connection.hConnect) {
+        LOG_ERROR("Failed to connect to translation endpoint");
+        WinHttpCloseHandle(connection.hSession);
+        connection.hSession = nullptr;
+        return false;
+    }
+
+    connection.lastUsed = 0;
+    return true;
+}
+
+void CALLBACK ConnectionPool::StatusCallback(HINTERNET, DWORD_PTR context, DWORD status, LPVOID, DWORD) {
+    // context is the pool, passed to WinHttpSendRequest by Exchange; the
+    // callback runs on the thread making the request, which holds no pool lock
+    if (status != WINHTTP_CALLBACK_STATUS_CONNECTED_TO_SERVER || !context) {
+        return;
+    }
+    ConnectionPool* pool = reinterpret_cast<ConnectionPool*>(context);
+    lock_guard<mutex> lock(pool->poolMutex);
+    pool->stats.connectionsOpened++;
+}
+
+void ConnectionPool::CloseConnection(Connection& connection) {
+    if (connection.hConnect) {
+        WinHttpCloseHandle(connection.hConnect);
+        connection.hConnect = nullptr;
+    }
+
+    if (connection.hSession) {
+        WinHttpCloseHandle(connection.hSession);
+        connection.hSession = nullptr;
+    }
+}
+
+bool ConnectionPool::Attach(PostControl* control, HINTERNET hRequest) {
+    if (!control) {
+        return true;
+    }
+    lock_guard<mutex> lock(control->controlMutex);
+    if (control->cancelled) {
+        return false;
+    }
+    control->hRequest = hRequest;
+    return true;
+}
+
+bool ConnectionPool::EnterCall(PostControl* control) {
+    if (!control) {
+        return true;
+    }
+    lock_guard<mutex> lock(control->controlMutex);
+    if (control->cancelled) {
+        return false;
+    }
+    control->inCall = true;
+    return true;
+}
+
+void ConnectionPool::LeaveCall(PostControl* control) {
+    if (!control) {
+        return;
+    }
+    lock_guard<mutex> lock(control->controlMutex);
+    control->inCall = false;
+}
+
+void ConnectionPool::CloseRequest(PostControl* control, HINTERNET hRequest) {
+    if (!control) {
+        WinHttpCloseHandle(hRequest);
+        return;
+    }
+    // Cancel() may have closed it already
+    lock_guard<mutex> lock(control->controlMutex);
+    if (control->hRequest) {
+        WinHttpCloseHandle(control->hRequest);
+        control->hRequest = nullptr;
+    }
+}
+
+bool ConnectionPool::Exchange(Connection& connection, const char* method, const string& pathAndQuery,
+                              const string& body, const ResponseSink* sink, uint32_t& statusCode,
+                              PostControl* control, uint32_t deadline) {
+    // Convert strings to wide strings
+    wstring wMethod(method, method + strlen(method));
+    wstring wPath(pathAndQuery.begin(), pathAndQuery.end());
+
+    // Open request
+    HINTERNET hRequest = WinHttpOpenRequest(connection.hConnect,
+                                           wMethod.c_str(),
+                                           wPath.c_str(),
+                                           nullptr,
+                                           WINHTTP_NO_REFERER,
+                                           WINHTTP_DEFAULT_ACCEPT_TYPES,
+                                           secure ? WINHTTP_FLAG_SECURE : 0);
+    if (!hRequest) {
+        LOG_ERROR("Failed to open HTTP request");
+        return false;
+    }
+    if (!Attach(control, hRequest)) {
+        WinHttpCloseHandle(hRequest);
+        return false;
+    }
+
+    bool ok = false;
+    DWORD error = 0;
+    // One blocking step on hRequest, skipped once the control is cancelled
+    auto call = [&](auto&& step) {
+        if (!EnterCall(control)) {
+            error = ERROR_WINHTTP_OPERATION_CANCELLED;
+            return false;
+        }
+        bool done = step() != FALSE;
+        if (!done) {
+            error = GetLastError();
+        }
+        LeaveCall(control);
+        return done;
+    };
+    if (control) {
+        // WinHTTP applies these to each step; the read loop below also
+        // checks the deadline for the request as a whole
+        int remaining = RemainingMs(deadline);
+        WinHttpSetTimeouts(hRequest, remaining, remaining, remaining, remaining);
+    }
+
+    // Set headers
+    if (strcmp(method, "HEAD") != 0) {
+        WinHttpAddRequestHeaders(hRequest, L"Content-Type: application/json\r\n", (DWORD)-1, WINHTTP_ADDREQ_FLAG_ADD);
+    }
+
+    // Send request
+    bool sent = call([&] {
+        return WinHttpSendRequest(hRequest,
+                                  WINHTTP_NO_ADDITIONAL_HEADERS, 0,
+                                  (LPVOID)body.c_str(), (DWORD)body.length(),
+                                  (DWORD)body.length(), reinterpret_cast<DWORD_PTR>(this));
+    });
+
+    if (sent && call([&] { return WinHttpReceiveResponse(hRequest, nullptr); })) {
+        DWORD code = 0;
+        DWORD statusSize = sizeof(code);
+        WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                            WINHTTP_HEADER_NAME_BY_INDEX, &code, &statusSize, WINHTTP_NO_HEADER_INDEX);
+        statusCode = code;
+
+        // Reading the body to the end lets WinHTTP return the socket to the keep-alive pool
+        DWORD bytesAvailable = 0;
+        char buffer[8192];
+
+        ok = true;
+        while (true) {
+            if (control && (control->Cancelled() || DeadlinePassed(deadline))) {
+                ok = false;
+                break;
+            }
+            if (!call([&] { return WinHttpQueryDataAvailable(hRequest, &bytesAvailable); })) {
+                ok = false;
+                break;
+            }
+            if (bytesAvailable == 0) {
+                break;
+            }
+
+            DWORD bytesRead = 0;
+            DWORD bytesToRead = min<DWORD>(bytesAvailable, sizeof(buffer));
+
+            if (!call([&] { return WinHttpReadData(hRequest, buffer, bytesToRead, &bytesRead); })) {
+                // A dropped connection or a Cancel() mid-body: the body is
+                // incomplete, so this is a transport failure, not a short answer
+                ok = false;
+                break;
+            }
+            if (bytesRead == 0) {
+                break;
+            }
+            if (sink) {
+                (*sink)(buffer, bytesRead);
+            }
+        }
+    }
+
+    if (!ok && control && (error == ERROR_WINHTTP_TIMEOUT || DeadlinePassed(deadline))) {
+        lock_guard<mutex> lock(control->controlMutex);
+        control->timedOut = !control->cancelled;
+    }
+
+    CloseRequest(control, hRequest);
+    return ok;
+}
+
+#else
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// WinHTTP's receive timeout, for requests without a PostControl
+static const uint32_t DEFAULT_TIMEOUT_MS = 30000;
+static const size_t MAX_RESPONSE_HEAD = 64 * 1024;
+
+void PostControl::Cancel() {
+    // The pool owns the socket; shutting it down wakes the poll in progress
+    // and the pool closes it afterwards
+    lock_guard<mutex> lock(controlMutex);
+    cancelled = true;
+    if (requestSocket >= 0) {
+        shutdown(requestSocket, SHUT_RDWR);
+    }
+}
+
+static bool StartsWithNoCase(const string& text, const char* prefix) {
+    size_t length = strlen(prefix);
+    if (text.size() < length) {
+        return false;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        if (tolower(static_cast<unsigned char>(text[i])) != prefix[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ConnectionPool::ParseEndpoint(const string& url) {
+    // scheme://host[:port][/path][?query]; the query is not part of the path
+    size_t schemeEnd = url.find("://");
+    if (schemeEnd == string::npos || (!StartsWithNoCase(url, "http://") && !StartsWithNoCase(url, "https://"))) {
+        LOG_ERROR("Invalid translation endpoint: ", url);
+        return false;
+    }
+    secure = StartsWithNoCase(url, "https://");
+    if (secure) {
+        LOG_ERROR("HTTPS endpoints need WinHTTP; use an http:// endpoint on this platform: ", url);
+        return false;
+    }
+
+    size_t hostStart = schemeEnd + 3;
+    size_t pathStart = url.find_first_of("/?", hostStart);
+    string authority = url.substr(hostStart, pathStart == string::npos ? string::npos : pathStart - hostStart);
+
+    // [v6 address]:port or name:port
+    port = 80;
+    size_t portColon = string::npos;
+    if (!authority.empty() && authority[0] == '[') {
+        size_t close = authority.find(']');
+        if (close == string::npos) {
+            LOG_ERROR("Invalid translation endpoint: ", url);
+            return false;
+        }
+        host = authority.substr(1, close - 1);
+        portColon = close + 1 < authority.size() && authority[close + 1] == ':' ? close + 1 : string::npos;
+    } else {
+        portColon = authority.find(':');
+        host = authority.substr(0, portColon);
+    }
+    if (portColon != string::npos) {
+        unsigned long number = strtoul(authority.c_str() + portColon + 1, nullptr, 10);
+        if (number == 0 || number > 65535) {
+            LOG_ERROR("Invalid translation endpoint port: ", url);
+            return false;
+        }
+        port = static_cast<uint16_t>(number);
+    }
+
+    path.clear();
+    if (pathStart != string::npos && url[pathStart] == '/') {
+        path = url.substr(pathStart, url.find('?', pathStart) - pathStart);
+    }
+    if (path.empty()) {
+        path = "/";
+    }
+
+    return !host.empty();
+}
+
+bool ConnectionPool::OpenConnection(Connection& connection) {
+    // Sockets are connected on first use, which happens on the maintenance
+    // thread's warm-up; stats.connectionsOpened counts those connects
+    connection.socket = -1;
+    connection.lastUsed = 0;
+    return true;
+}
+
+void ConnectionPool::CloseConnection(Connection& connection) {
+    if (connection.socket >= 0) {
+        close(connection.socket);
+        connection.socket = -1;
+    }
+}
+
+bool ConnectionPool::Attach(PostControl* control, int socket) {
+    if (!control) {
+        return true;
+    }
+    lock_guard<mutex> lock(control->controlMutex);
+    if (control->cancelled) {
+        return false;
+    }
+    control->requestSocket = socket;
+    return true;
+}
+
+void ConnectionPool::Detach(PostControl* control) {
+    if (control) {
+        lock_guard<mutex> lock(control->controlMutex);
+        control->requestSocket = -1;
+    }
+}
+
+// Wait until fd is ready for events or the deadline passes
+static bool WaitFor(int fd, short events, uint32_t deadline) {
+    while (!DeadlinePassed(deadline)) {
+        pollfd entry = { fd, events, 0 };
+        int ready = poll(&entry, 1, RemainingMs(deadline));
+        if (ready > 0) {
+            return true;
+        }
+        if (ready < 0 && errno != EINTR) {
+            return false;
+        }
+    }
+    return false;
+}
+
+// Non-blocking TCP connection to host:port, or -1
+static int ConnectSocket(const string& host, uint16_t port, uint32_t deadline) {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &addresses) != 0) {
+        return -1;
+    }
+
+    int fd = -1;
+    for (addrinfo* address = addresses; address && fd < 0; address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+        bool connected = connect(fd, address->ai_addr, address->ai_addrlen) == 0;
+        if (!connected && errno == EINPROGRESS && WaitFor(fd, POLLOUT, deadline)) {
+            int error = 0;
+            socklen_t length = sizeof(error);
+            connected = getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0;
+        }
+        if (!connected) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+
+    if (fd >= 0) {
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    }
+    return fd;
+}
+
+static bool SendAll(int fd, const char* data, size_t size, uint32_t deadline) {
+    while (size > 0) {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent > 0) {
+            data += sent;
+            size -= static_cast<size_t>(sent);
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            if (!WaitFor(fd, POLLOUT, deadline)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Incremental reader for one HTTP/1.1 response: status line and headers,
+// then a body delimited by Content-Length, chunked encoding or the end of
+// the connection
+class ResponseReader {
+private:
+    enum class Stage { Head, Body, ChunkSize, ChunkData, ChunkEnd, Trailer, Done };
+
+    Stage stage;
+    string head;
+    string line;
+    uint64_t remaining;
+    bool untilClose;
+    const ConnectionPool::ResponseSink* sink;
+
+    bool ParseHead() {
+        // "HTTP/1.1 200 OK"
+        if (head.compare(0, 5, "HTTP/") != 0) {
+            return false;
+        }
+        size_t space = head.find(' ');
+        if (space == string::npos) {
+            return false;
+        }
+        statusCode = static_cast<uint32_t>(strtoul(head.c_str() + space + 1, nullptr, 10));
+        keepAlive = head.compare(0, 8, "HTTP/1.0") != 0;
+
+        bool chunked = false;
+        bool haveLength = false;
+        size_t lineStart = head.find("\r\n") + 2;
+        while (lineStart < head.size()) {
+            size_t lineEnd = head.find("\r\n", lineStart);
+            string header = head.substr(lineStart, lineEnd - lineStart);
+            lineStart = lineEnd == string::npos ? head.size() : lineEnd + 2;
+
+            size_t colon = header.find(':');
+            if (colon == string::npos) {
+                continue;
+            }
+            string name = header.substr(0, colon);
+            for (char& c : name) {
+                c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+            }
+            size_t valueStart = header.find_first_not_of(' ', colon + 1);
+            string value = valueStart == string::npos ? string() : header.substr(valueStart);
+
+            if (name == "content-length") {
+                remaining = strtoull(value.c_str(), nullptr, 10);
+                haveLength = true;
+            } else if (name == "transfer-encoding") {
+                chunked = StartsWithNoCase(value, "chunked");
+            } else if (name == "connection") {
+                if (StartsWithNoCase(value, "close")) {
+                    keepAlive = false;
+                } else if (StartsWithNoCase(value, "keep-alive")) {
+                    keepAlive = true;
+                }
+            }
+        }
+
+        if (headOnly || statusCode == 204 || statusCode == 304 || (statusCode >= 100 && statusCode < 200)) {
+            stage = Stage::Done;
+        } else if (chunked) {
+            stage = Stage::ChunkSize;
+        } else if (haveLength) {
+            stage = remaining == 0 ? Stage::Done : Stage::Body;
+        } else {
+            // Neither: the body runs until the server closes the connection
+            untilClose = true;
+            keepAlive = false;
+            stage = Stage::Body;
+        }
+        return true;
+    }
+
+    void Emit(const char* data, size_t size) {
+        if (sink && size > 0) {
+            (*sink)(data, size);
+        }
+    }
+
+public:
+    uint32_t statusCode;
+    bool keepAlive;
+    bool headOnly;
+
+    ResponseReader(const ConnectionPool::ResponseSink* responseSink, bool headRequest)
+        : stage(Stage::Head), remaining(0), untilClose(false), sink(responseSink), statusCode(0),
+          keepAlive(true), headOnly(headRequest) {}
+
+    bool Done() const { return stage == Stage::Done; }
+    bool Started() const { return !head.empty(); }
+
+    // The connection was closed: fine only for a body that runs until then
+    bool Close() {
+        if (untilClose && stage == Stage::Body) {
+            stage = Stage::Done;
+        }
+        return Done();
+    }
+
+    // False on a malformed response
+    bool Feed(const char* data, size_t size) {
+        size_t pos = 0;
+        while (pos < size && stage != Stage::Done) {
+            switch (stage) {
+                case Stage::Head: {
+                    // Headers end with an empty line; the terminator may straddle reads
+                    size_t before = head.size();
+                    head.append(data + pos, size - pos);
+                    size_t end = head.find("\r\n\r\n", before >= 3 ? before - 3 : 0);
+                    if (end == string::npos) {
+                        if (head.size() > MAX_RESPONSE_HEAD) {
+                            return false;
+                        }
+                        return true;
+                    }
+                    pos += end + 4 - before;
+                    head.resize(end + 2);
+                    if (!ParseHead()) {
+                        return false;
+                    }
+                    break;
+                }
+                case Stage::Body: {
+                    size_t take = untilClose ? size - pos : static_cast<size_t>(min<uint64_t>(remaining, size - pos));
+                    Emit(data + pos, take);
+                    pos += take;
+                    if (!untilClose) {
+                        remaining -= take;
+                        if (remaining == 0) {
+                            stage = Stage::Done;
+                        }
+                    }
+                    break;
+                }
+                case Stage::ChunkSize:
+                case Stage::ChunkEnd:
+                case Stage::Trailer: {
+                    char c = data[pos++];
+                    if (c != '\n') {
+                        if (c != '\r') {
+                            line += c;
+                        }
+                        if (line.size() > 1024) {
+                            return false;
+                        }
+                        break;
+                    }
+                    if (stage == Stage::ChunkSize) {
+                        // "1a3;extension"
+                        char* end = nullptr;
+                        remaining = strtoull(line.c_str(), &end, 16);
+                        if (end == line.c_str()) {
+                            return false;
+                        }
+                        stage = remaining == 0 ? Stage::Trailer : Stage::ChunkData;
+                    } else if (stage == Stage::ChunkEnd) {
+                        if (!line.empty()) {
+                            return false;
+                        }
+                        stage = Stage::ChunkSize;
+                    } else if (line.empty()) {
+                        stage = Stage::Done;
+                    }
+                    line.clear();
+                    break;
+                }
+                case Stage::ChunkData: {
+                    size_t take = static_cast<size_t>(min<uint64_t>(remaining, size - pos));
+                    Emit(data + pos, take);
+                    pos += take;
+                    remaining -= take;
+                    if (remaining == 0) {
+                        stage = Stage::ChunkEnd;
+                    }
+                    break;
+                }
+                case Stage::Done:
+                    break;
+            }
+        }
+        return true;
+    }
+};
+
+bool ConnectionPool::Exchange(Connection& connection, const char* method, const string& pathAndQuery,
+                              const string& body, const ResponseSink* sink, uint32_t& statusCode,
+                              PostControl* control, uint32_t deadline) {
+    if (!control) {
+        deadline = TickCount() + DEFAULT_TIMEOUT_MS;
+    }
+    bool headRequest = strcmp(method, "HEAD") == 0;
+
+    string request;
+    request.reserve(256 + body.size());
+    request.append(method).append(" ").append(pathAndQuery).append(" HTTP/1.1\r\nHost: ").append(host);
+    if (port != 80) {
+        request.append(":").append(to_string(port));
+    }
+    request.append("\r\nUser-Agent: CET Translator/1.0\r\n");
+    if (!headRequest) {
+        request.append("Content-Type: application/json\r\nContent-Length: ").append(to_string(body.size()));
+        request.append("\r\n");
+    }
+    request.append("\r\n").append(body);
+
+    bool ok = false;
+    // A kept-alive socket the server has closed in the meantime fails before
+    // any of the response arrives; the request is then sent once more on a
+    // new connection, as WinHTTP does
+    for (int attempt = 0; attempt < 2 && !ok; ++attempt) {
+        bool reused = connection.socket >= 0;
+        if (!reused) {
+            connection.socket = ConnectSocket(host, port, deadline);
+            if (connection.socket < 0) {
+                LOG_ERROR("Failed to connect to translation endpoint");
+                break;
+            }
+            lock_guard<mutex> lock(poolMutex);
+            stats.connectionsOpened++;
+        }
+
+        if (!Attach(control, connection.socket)) {
+            break;
+        }
+
+        ResponseReader reader(sink, headRequest);
+        bool failed = !SendAll(connection.socket, request.data(), request.size(), deadline);
+        char buffer[8192];
+        while (!failed && !reader.Done()) {
+            if (control && control->Cancelled()) {
+                failed = true;
+                break;
+            }
+            ssize_t received = recv(connection.socket, buffer, sizeof(buffer), 0);
+            if (received > 0) {
+                failed = !reader.Feed(buffer, static_cast<size_t>(received));
+            } else if (received == 0) {
+                failed = !reader.Close();
+                break;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                failed = !WaitFor(connection.socket, POLLIN, deadline);
+            } else {
+                failed = true;
+            }
+        }
+        Detach(control);
+
+        ok = !failed && reader.Done();
+        if (ok) {
+            statusCode = reader.statusCode;
+        }
+        if (!ok || !reader.keepAlive) {
+            CloseConnection(connection);
+        }
+
+        bool stale = !ok && reused && !reader.Started() && !DeadlinePassed(deadline) &&
+                     !(control && control->Cancelled());
+        if (!stale) {
+            break;
+        }
+    }
+
+    if (!ok && control && DeadlinePassed(deadline)) {
+        lock_guard<mutex> lock(control->controlMutex);
+        control->timedOut = !control->cancelled;
+    }
+    return ok;
+}
+
+#endif
+
+bool ConnectionPool::Probe(Connection& connection, PostControl& control) {
+    // HEAD on the endpoint path: the status is irrelevant, only the round trip
+    // that establishes or refreshes the keep-alive socket matters
+    uint32_t statusCode = 0;
+    return Exchange(connection, "HEAD", path, string(), nullptr, statusCode, &control,
+                    TickCount() + control.timeoutMs);
+}
+
+bool ConnectionPool::Open(const string& endpointUrl, size_t poolSize, uint32_t keepAliveIntervalMs) {
+    Close();
+
+    if (!ParseEndpoint(endpointUrl)) {
+        return false;
+    }
+
+    lock_guard<mutex> lock(poolMutex);
+
+    keepAliveMs = max<uint32_t>(keepAliveIntervalMs, 1000);
+    stats = ConnectionPoolStats();
+    firstRequestDone = false;
+    connections.assign(max<size_t>(1, poolSize), Connection());
+
+    for (Connection& connection : connections) {
+        if (!OpenConnection(connection)) {
+            for (Connection& opened : connections) {
+                CloseConnection(opened);
+            }
+            connections.clear();
+            return false;
+        }
+    }
+
+    // Warm-up happens on the maintenance thread so init_translator does not
+    // block the game on DNS and TLS handshakes
+    stopRequested = false;
+    try {
+        maintenanceThread = thread(&ConnectionPool::MaintenanceLoop, this);
+    } catch (const exception& e) {
+        LOG_WARNING("Connection pool maintenance thread unavailable: ", e.what());
+    }
+
+    LOG_INFO("Connection pool opened with ", connections.size(), " connection(s) to ", endpointUrl.substr(0, endpointUrl.find('?')));
+    return true;
+}
+
+void ConnectionPool::Close() {
+    {
+        lock_guard<mutex> lock(poolMutex);
+        stopRequested = true;
+        // A probe to an unresponsive server would otherwise hold the join
+        // below for its whole timeout
+        if (probeControl) {
+            probeControl->Cancel();
+        }
+    }
+
+    maintenanceWakeup.notify_all();
+    available.notify_all();
+    if (maintenanceThread.joinable()) {
+        maintenanceThread.join();
+    }
+
+    lock_guard<mutex> lock(poolMutex);
+    if (connections.empty()) {
+        return;
+    }
+
+    for (Connection& connection : connections) {
+        CloseConnection(connection);
+    }
+    connections.clear();
+
+    LOG_INFO("Connection pool closed: ", stats.connectionsOpened, " connection(s), ",
+             stats.warmups, " warmed, ",
+             stats.probes, " keep-alive probe(s), ", stats.requests, " request(s), ",
+             "first request ", stats.firstRequestMs, " ms");
+}
+
+size_t ConnectionPool::Acquire(uint32_t deadline, PostControl* control) {
+    // Returns the index of an idle slot, or SIZE_MAX when the pool is closing
+    // or the request is cancelled or out of time before a slot frees up
+    unique_lock<mutex> lock(poolMutex);
+
+    while (true) {
+        if (stopRequested || connections.empty()) {
+            return SIZE_MAX;
+        }
+
+        // Prefer the most recently used slot; its socket is the most likely to still be open
+        size_t best = SIZE_MAX;
+        for (size_t i = 0; i < connections.size(); ++i) {
+            if (!connections[i].busy &&
+                (best == SIZE_MAX || connections[i].lastUsed > connections[best].lastUsed)) {
+                best = i;
+            }
+        }
+
+        if (best != SIZE_MAX) {
+            connections[best].busy = true;
+            return best;
+        }
+
+        if (!control) {
+            available.wait(lock);
+            continue;
+        }
+
+        if (control->Cancelled() || DeadlinePassed(deadline)) {
+            return SIZE_MAX;
+        }
+        // Short waits, so a cancelled request does not sit here until a slot frees
+        available.wait_for(lock, chrono::milliseconds(min<int>(RemainingMs(deadline), 50)));
+    }
+}
+
+void ConnectionPool::Release(size_t index) {
+    {
+        lock_guard<mutex> lock(poolMutex);
+        if (index < connections.size()) {
+            connections[index].busy = false;
+            connections[index].lastUsed = TickCount();
+        }
+    }
+    available.notify_one();
+}
+
+bool ConnectionPool::Post(const string& pathAndQuery, const string& body,
+                          string& response, uint32_t& statusCode, PostControl* control) {
+    response.clear();
+    return Post(pathAndQuery, body, [&response](const char* data, size_t size) { response.append(data, size); },
+                statusCode, control);
+}
+
+bool ConnectionPool::Post(const string& pathAndQuery, const string& body,
+                          const ResponseSink& sink, uint32_t& statusCode, PostControl* control) {
+    statusCode = 0;
+
+    uint32_t startTime = TickCount();
+    uint32_t deadline = startTime + (control ? control->timeoutMs : 0);
+
+    size_t index = Acquire(deadline, control);
+    if (index == SIZE_MAX) {
+        if (control && DeadlinePassed(deadline)) {
+            lock_guard<mutex> lock(control->controlMutex);
+            control->timedOut = true;
+        }
+        return false;
+    }
+
+    bool ok = Exchange(connections[index], "POST", pathAndQuery, body, &sink, statusCode, control, deadline);
+
+    uint32_t elapsed = TickCount() - startTime;
+    Release(index);
+
+    lock_guard<mutex> lock(poolMutex);
+    stats.requests++;
+    if (!ok) {
+        stats.failures++;
+    }
+    if (!firstRequestDone) {
+        firstRequestDone = true;
+        stats.firstRequestMs = elapsed;
+        LOG_DEBUG("First translation request completed in ", elapsed, " ms");
+    }
+
+    return ok;
+}
+
+void ConnectionPool::MaintenanceLoop() {
+    bool warmed = false;
+
+    while (true) {
+        // Pick one slot that needs work: every slot once for warm-up, then
+        // slots idle for longer than the keep-alive interval
+        size_t index = SIZE_MAX;
+        {
+            unique_lock<mutex> lock(poolMutex);
+
+            if (warmed) {
+                maintenanceWakeup.wait_for(lock, chrono::milliseconds(max<uint32_t>(keepAliveMs / 4, 1000)),
+                                           [this] { return stopRequested; });
+            }
+            if (stopRequested) {
+                break;
+            }
+
+            uint32_t now = TickCount();
+            for (size_t i = 0; i < connections.size(); ++i) {
+                Connection& connection = connections[i];
+                bool cold = connection.lastUsed == 0;
+                bool idle = !cold && now - connection.lastUsed >= keepAliveMs;
+                if (!connection.busy && ((!warmed && cold) || (warmed && idle))) {
+                    connection.busy = true;
+                    index = i;
+                    break;
+                }
+            }
+
+            if (index == SIZE_MAX) {
+                warmed = true;
+                continue;
+            }
+        }
+
+        uint32_t startTime = TickCount();
+        bool cold = connections[index].lastUsed == 0;
+        PostControl control(min<uint32_t>(keepAliveMs, MAX_PROBE_TIMEOUT_MS));
+        bool started = false;
+        {
+            // Published under the same lock Close() sets stopRequested with,
+            // so a probe is either cancelled there or never started
+            lock_guard<mutex> lock(poolMutex);
+            if (!stopRequested) {
+                probeControl = &control;
+                started = true;
+            }
+        }
+        bool ok = started && Probe(connections[index], control);
+        uint32_t elapsed = TickCount() - startTime;
+
+        {
+            lock_guard<mutex> lock(poolMutex);
+            probeControl = nullptr;
+            if (cold) {
+                if (ok) {
+                    stats.warmups++;
+                }
+            } else {
+                stats.probes++;
+            }
+        }
+
+        if (cold) {
+            LOG_DEBUG("Connection ", index, ok ? " warmed in " : " warm-up failed after ", elapsed, " ms");
+        } else if (!ok) {
+            LOG_DEBUG("Keep-alive probe failed on connection ", index);
+        }
+
+        // A failed warm-up still counts as used so it is retried on the probe interval
+        Release(index);
+    }
+}
+
+size_t ConnectionPool::Size() {
+    lock_guard<mutex> lock(poolMutex);
+    return connections.size();
+}
+
+ConnectionPoolStats ConnectionPool::GetStats() {
+    lock_guard<mutex> lock(poolMutex);
+    return stats;
+}
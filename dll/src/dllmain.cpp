@@ -6,6 +6,7 @@
 
 #include "../include/lua_interface.h"
 #include "../include/translator_core.h"
+#include "../include/translation_worker.h"
 #include "../include/logging.h"
 #include "../include/utils.h"
 
@@ -41,6 +42,9 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserv
             return FALSE;
         }
 
+        // Background worker for non-blocking translations (thread starts on first use)
+        g_translationWorker = std::make_unique<TranslationWorker>(*g_translator);
+
         // Initialize Lua interface
         if (!InitializeLuaInterface()) {
             LOG_ERROR("Failed to initialize Lua interface");
@@ -53,14 +57,29 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserv
     }
     case DLL_PROCESS_DETACH:
     {
+        // Process exit: the other threads are already gone, possibly killed
+        // while holding a lock, so nothing here may wait. The globals are
+        // leaked on purpose; their destructors would.
+        if (lpReserved != nullptr) {
+            static_cast<void>(g_translationWorker.release());
+            static_cast<void>(g_translator.release());
+            break;
+        }
+
         LOG_INFO("CET Library: DLL_PROCESS_DETACH");
         
-        // Cleanup in reverse order
+        // FreeLibrary holds the loader lock, so no thread may be joined here.
+        // UnitXP("CET", "shutdown") stops them beforehand (the addon sends
+        // it at PLAYER_LOGOUT); without it the state is left to the process.
         CleanupLuaInterface();
         
-        if (g_translator) {
-            g_translator->Cleanup();
+        if (IsCETShutdown()) {
+            g_translationWorker.reset();
             g_translator.reset();
+        } else {
+            LOG_ERROR("CET unloaded without UnitXP(\"CET\", \"shutdown\"); background threads left running");
+            static_cast<void>(g_translationWorker.release());
+            static_cast<void>(g_translator.release());
         }
         
         CleanupLogging();
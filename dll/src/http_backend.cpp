@@ -0,0 +1,524 @@
+// http_backend.cpp - Google Translate requests for CET
+// Deadlines, retries, hedging and circuit breaking around the connection pool
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+
+#include "../include/http_backend.h"
+#include "../include/connection_pool.h"
+#include "../include/json_parser.h"
+#include "../include/utf8_helper.h"
+#include "../include/request_builder.h"
+#include "../include/logging.h"
+#include "../include/metrics.h"
+#include "../include/trace.h"
+
+using namespace std;
+
+HttpBackend::HttpBackend()
+    : endpointUrl(DEFAULT_ENDPOINT), poolSize(2), keepAliveMs(45000), latencies(LATENCY_SAMPLES),
+      requestTimeoutMs(DEFAULT_REQUEST_TIMEOUT_MS), hedgeRequests(false), hedgeStop(false) {
+}
+
+HttpBackend::~HttpBackend() {
+    Close();
+}
+
+bool HttpBackend::Open(const string& apiKey) {
+    Close();
+    
+    // Open persistent connections to the configured endpoint; they are warmed in the background
+    pool = make_unique<ConnectionPool>();
+    if (!pool->Open(endpointUrl, poolSize, keepAliveMs)) {
+        LOG_ERROR("Failed to connect to translation endpoint: ", endpointUrl);
+        pool.reset();
+        return false;
+    }
+    
+    // Constant per configuration, so built once instead of per request
+    requestPath = TranslationRequestBuilder::BuildPath(pool->EndpointPath(), apiKey);
+    return true;
+}
+
+void HttpBackend::Close() {
+    {
+        lock_guard<mutex> lock(hedgeMutex);
+        hedgeStop = true;
+    }
+    hedgeWakeup.notify_all();
+    if (hedgeThread.joinable()) {
+        hedgeThread.join();
+    }
+    
+    if (pool) {
+        pool->Close();
+        pool.reset();
+    }
+}
+
+void HttpBackend::SetEndpoint(const string& url) {
+    endpointUrl = url.empty() ? DEFAULT_ENDPOINT : url;
+}
+
+void HttpBackend::SetConnectionPoolSize(size_t size) {
+    poolSize = max<size_t>(1, min<size_t>(size, 8));
+}
+
+void HttpBackend::SetKeepAliveInterval(uint32_t intervalMs) {
+    keepAliveMs = intervalMs;
+}
+
+void HttpBackend::SetRequestTimeout(uint32_t timeoutMs) {
+    requestTimeoutMs = max<uint32_t>(timeoutMs, 500);
+}
+
+void HttpBackend::SetRetryAttempts(unsigned int attempts) {
+    retryPolicy.maxAttempts = max<unsigned int>(1, min<unsigned int>(attempts, 5));
+}
+
+void HttpBackend::SetHedging(bool enabled) {
+    hedgeRequests = enabled;
+}
+
+void HttpBackend::SetBreakerThreshold(unsigned int failures) {
+    lock_guard<mutex> lock(resilienceMutex);
+    breaker.SetFailureThreshold(failures);
+}
+
+void HttpBackend::SetBreakerOpenTime(unsigned int openMs) {
+    lock_guard<mutex> lock(resilienceMutex);
+    breaker.SetOpenTime(openMs);
+}
+
+// Outcome of one Post as a result code
+static TranslationResult PostResult(bool ok, PostControl& control, uint32_t statusCode) {
+    if (!ok) {
+        return control.TimedOut() ? TranslationResult::TIMEOUT_ERROR : TranslationResult::NETWORK_ERROR;
+    }
+    return (statusCode >= 200 && statusCode < 300) ? TranslationResult::SUCCESS : TranslationResult::API_ERROR;
+}
+
+// Second request of a hedged attempt, queued for the helper thread. The
+// attempt owns it and does not return before it is withdrawn or finished;
+// the fields below the request's are guarded by hedgeMutex.
+struct HedgeAttempt {
+    const string& path;
+    const string& postData;
+    size_t chars;
+    uint64_t traceId;
+    chrono::steady_clock::time_point sendAt;
+    chrono::steady_clock::time_point deadline;
+    PostControl& primary;
+
+    PostControl* control;    // while the hedge is in flight
+    bool started;
+    bool finished;
+    TranslationResult status;
+    uint32_t statusCode;
+    string body;
+
+    HedgeAttempt(const string& requestPath, const string& requestData, size_t requestChars, PostControl& primaryControl)
+        : path(requestPath), postData(requestData), chars(requestChars), traceId(t_traceId), primary(primaryControl),
+          control(nullptr), started(false), finished(false), status(TranslationResult::NETWORK_ERROR), statusCode(0) {}
+};
+
+bool HttpBackend::QueueHedge(HedgeAttempt& hedge) {
+    lock_guard<mutex> lock(hedgeMutex);
+    if (!hedgeThread.joinable()) {
+        hedgeStop = false;
+        try {
+            hedgeThread = thread(&HttpBackend::HedgeLoop, this);
+        } catch (const exception& e) {
+            LOG_WARNING("Hedge thread unavailable, sending without hedging: ", e.what());
+            return false;
+        }
+    }
+    hedgeQueue.push_back(&hedge);
+    hedgeWakeup.notify_all();
+    return true;
+}
+
+void HttpBackend::FinishHedge(HedgeAttempt& hedge, bool cancelSent) {
+    unique_lock<mutex> lock(hedgeMutex);
+    auto queued = find(hedgeQueue.begin(), hedgeQueue.end(), &hedge);
+    if (queued != hedgeQueue.end()) {
+        hedgeQueue.erase(queued);
+        return;
+    }
+    if (cancelSent && hedge.control) {
+        hedge.control->Cancel();
+    }
+    hedgeFinished.wait(lock, [&hedge] { return hedge.finished; });
+}
+
+void HttpBackend::HedgeLoop() {
+    // Hedges go out one at a time, earliest first; hedging is for the odd
+    // slow request, so a second one due meanwhile waits its turn
+    unique_lock<mutex> lock(hedgeMutex);
+    while (!hedgeStop) {
+        if (hedgeQueue.empty()) {
+            hedgeWakeup.wait(lock);
+            continue;
+        }
+        auto next = min_element(hedgeQueue.begin(), hedgeQueue.end(),
+                                [](const HedgeAttempt* a, const HedgeAttempt* b) { return a->sendAt < b->sendAt; });
+        if (chrono::steady_clock::now() < (*next)->sendAt) {
+            hedgeWakeup.wait_until(lock, (*next)->sendAt);
+            continue;
+        }
+        
+        HedgeAttempt& hedge = **next;
+        hedgeQueue.erase(next);
+        lock.unlock();
+        SendHedge(hedge);
+        lock.lock();
+        hedge.finished = true;
+        hedgeFinished.notify_all();
+    }
+}
+
+void HttpBackend::SendHedge(HedgeAttempt& hedge) {
+    auto now = chrono::steady_clock::now();
+    if (now >= hedge.deadline) {
+        return;
+    }
+    PostControl control(static_cast<uint32_t>(
+        max<long long>(chrono::duration_cast<chrono::milliseconds>(hedge.deadline - now).count(), 1)));
+    {
+        lock_guard<mutex> lock(hedgeMutex);
+        hedge.control = &control;
+        hedge.started = true;
+    }
+    
+    TraceIdScope trace(hedge.traceId);
+    TraceSpan hedgeSpan("hedge");
+    quota.Charge(hedge.chars, now);
+    CountMetric(Metric::ApiRequests);
+    CountMetric(Metric::BytesOut, hedge.postData.size());
+    uint32_t code = 0;
+    bool ok = pool->Post(hedge.path, hedge.postData, hedge.body, code, &control);
+    CountMetric(Metric::BytesIn, hedge.body.size());
+    TranslationResult status = PostResult(ok, control, code);
+    if (status == TranslationResult::SUCCESS) {
+        hedge.primary.Cancel();
+    }
+    
+    lock_guard<mutex> lock(hedgeMutex);
+    hedge.control = nullptr;
+    hedge.statusCode = code;
+    hedge.status = status;
+}
+
+TranslationResult HttpBackend::HttpsRequest(const string& path, const string& postData, size_t chars,
+                                                  uint32_t timeoutMs, uint32_t hedgeAfterMs, TranslationResponseParser& parser,
+                                                  string& responseHead, uint32_t& statusCode) {
+    if (!pool) {
+        return TranslationResult::NETWORK_ERROR;
+    }
+    TraceSpan span("HttpsRequest");
+    
+    // The body is parsed as it is read; only its start is kept for error messages
+    auto sink = [&](const char* data, size_t size) {
+        CountMetric(Metric::BytesIn, size);
+        parser.Feed(data, size);
+        if (responseHead.size() < MAX_LOGGED_RESPONSE) {
+            string_view chunk(data, size);
+            responseHead += UTF8Helper::Repair(chunk, MAX_LOGGED_RESPONSE - responseHead.size());
+        }
+    };
+    
+    PostControl primary(timeoutMs);
+    quota.Charge(chars, chrono::steady_clock::now());
+    CountMetric(Metric::ApiRequests);
+    CountMetric(Metric::BytesOut, postData.size());
+    if (hedgeAfterMs == 0 || hedgeAfterMs >= timeoutMs) {
+        bool ok = pool->Post(path, postData, sink, statusCode, &primary);
+        return PostResult(ok, primary, statusCode);
+    }
+    
+    // The helper thread only sends the hedge if the primary is still out
+    // after hedgeAfterMs, and cancels the primary if the hedge wins
+    auto now = chrono::steady_clock::now();
+    HedgeAttempt hedge(path, postData, chars, primary);
+    hedge.sendAt = now + chrono::milliseconds(hedgeAfterMs);
+    hedge.deadline = now + chrono::milliseconds(timeoutMs);
+    if (!QueueHedge(hedge)) {
+        bool ok = pool->Post(path, postData, sink, statusCode, &primary);
+        return PostResult(ok, primary, statusCode);
+    }
+    
+    bool ok = pool->Post(path, postData, sink, statusCode, &primary);
+    TranslationResult status = PostResult(ok, primary, statusCode);
+    FinishHedge(hedge, status == TranslationResult::SUCCESS);
+    
+    if (hedge.started) {
+        lock_guard<mutex> lock(resilienceMutex);
+        resilienceStats.hedges++;
+        resilienceStats.attempts++;
+    }
+    
+    if (status == TranslationResult::SUCCESS || hedge.status != TranslationResult::SUCCESS) {
+        return status;
+    }
+    
+    // The hedge answered first: parse its response in place of the primary's
+    LOG_DEBUG("Hedged request answered first after ", hedgeAfterMs, " ms");
+    {
+        lock_guard<mutex> lock(resilienceMutex);
+        resilienceStats.hedgeWins++;
+    }
+    parser.Reset();
+    responseHead.clear();
+    parser.Feed(hedge.body.data(), hedge.body.size());
+    responseHead = UTF8Helper::Repair(hedge.body, MAX_LOGGED_RESPONSE);
+    statusCode = hedge.statusCode;
+    return TranslationResult::SUCCESS;
+}
+
+uint32_t HttpBackend::HedgeDelay() {
+    if (!hedgeRequests || poolSize < 2) {
+        return 0;
+    }
+    
+    lock_guard<mutex> lock(resilienceMutex);
+    if (breaker.State() != BreakerState::Closed || latencies.Count() < MIN_HEDGE_SAMPLES) {
+        return 0;
+    }
+    return max<uint32_t>(latencies.Percentile(95), MIN_HEDGE_DELAY_MS);
+}
+
+void HttpBackend::RecordAttempt(TranslationResult status, uint32_t statusCode, uint32_t elapsedMs) {
+    auto now = chrono::steady_clock::now();
+    lock_guard<mutex> lock(resilienceMutex);
+    
+    resilienceStats.attempts++;
+    if (status == TranslationResult::TIMEOUT_ERROR) {
+        resilienceStats.timeouts++;
+    }
+    
+    // Any answer other than a transport failure, timeout, 429 or 5xx shows
+    // the endpoint is up, even a 400 for a bad request
+    bool endpointFailed = status == TranslationResult::NETWORK_ERROR ||
+                          status == TranslationResult::TIMEOUT_ERROR ||
+                          (status == TranslationResult::API_ERROR && IsRetryableStatus(statusCode));
+    if (endpointFailed) {
+        BreakerState before = breaker.State();
+        breaker.RecordFailure(now);
+        if (breaker.State() == BreakerState::Open && before != BreakerState::Open) {
+            LOG_WARNING("Translation endpoint failing, pausing requests");
+        }
+    } else {
+        breaker.RecordSuccess();
+    }
+    
+    if (status == TranslationResult::SUCCESS) {
+        latencies.Record(elapsedMs);
+        RecordLatency(LatencyMetric::Network, elapsedMs);
+    }
+}
+
+TranslationResult HttpBackend::Translate(const vector<string>& texts, const vector<size_t>& queryIndex,
+                                         const string& fromLang, const string& toLang,
+                                         vector<string>& translations, vector<bool>& answered) {
+    vector<TranslationResult> statuses;
+    vector<bool> permanent;
+    return Translate(texts, queryIndex, fromLang, toLang, translations, answered, statuses, permanent);
+}
+
+TranslationResult HttpBackend::Translate(const vector<string>& texts, const vector<size_t>& queryIndex,
+                                         const string& fromLang, const string& toLang,
+                                         vector<string>& translations, vector<bool>& answered,
+                                         vector<TranslationResult>& statuses, vector<bool>& permanent) {
+    answered.assign(queryIndex.size(), false);
+    statuses.assign(queryIndex.size(), TranslationResult::UNAVAILABLE);
+    permanent.assign(queryIndex.size(), false);
+    if (!pool) {
+        // No API key: only local backends can translate
+        return TranslationResult::UNAVAILABLE;
+    }
+    
+    // The API accepts a limited number of "q" values and a limited body
+    // per request
+    size_t first = 0;
+    while (first < queryIndex.size()) {
+        size_t count = 0;
+        size_t bytes = 0;
+        while (first + count < queryIndex.size() && count < MAX_QUERIES_PER_REQUEST) {
+            size_t textBytes = texts[queryIndex[first + count]].size();
+            if (count > 0 && bytes + textBytes > MAX_BYTES_PER_REQUEST) {
+                break;
+            }
+            bytes += textBytes;
+            count++;
+        }
+        
+        TranslationResult failure = RequestChunk(texts, queryIndex, first, count, fromLang, toLang, translations,
+                                                 answered, statuses, permanent);
+        if (failure != TranslationResult::SUCCESS) {
+            // The rest would fail the same way; they are not sent
+            fill(statuses.begin() + first + count, statuses.end(), failure);
+            break;
+        }
+        first += count;
+    }
+    
+    for (TranslationResult status : statuses) {
+        if (status != TranslationResult::SUCCESS) {
+            return status;
+        }
+    }
+    return TranslationResult::SUCCESS;
+}
+
+TranslationResult HttpBackend::RequestChunk(const vector<string>& texts, const vector<size_t>& queryIndex,
+                                            size_t first, size_t count, const string& fromLang,
+                                            const string& toLang, vector<string>& translations,
+                                            vector<bool>& answered, vector<TranslationResult>& statuses,
+                                            vector<bool>& permanent) {
+    bool rejected = false;
+    uint32_t statusCode = 0;
+    TranslationResult status = RequestTranslations(texts, queryIndex, first, count, fromLang, toLang, translations,
+                                                   rejected, statusCode);
+    if (status == TranslationResult::SUCCESS) {
+        fill(answered.begin() + first, answered.begin() + first + count, true);
+        fill(statuses.begin() + first, statuses.begin() + first + count, status);
+        return TranslationResult::SUCCESS;
+    }
+    
+    // One text the API refuses fails the whole request; halving finds it
+    // in a few requests, and its neighbours are still translated
+    if (rejected && count > 1 && IsRejectedContentStatus(statusCode)) {
+        LOG_DEBUG("Translation request for ", count, " texts rejected, splitting it");
+        size_t half = count / 2;
+        TranslationResult failure = RequestChunk(texts, queryIndex, first, half, fromLang, toLang, translations,
+                                                 answered, statuses, permanent);
+        if (failure != TranslationResult::SUCCESS) {
+            fill(statuses.begin() + first + half, statuses.begin() + first + count, failure);
+            return failure;
+        }
+        return RequestChunk(texts, queryIndex, first + half, count - half, fromLang, toLang, translations, answered,
+                            statuses, permanent);
+    }
+    
+    fill(statuses.begin() + first, statuses.begin() + first + count, status);
+    if (rejected && count == 1) {
+        permanent[first] = true;
+        return TranslationResult::SUCCESS;
+    }
+    return status;
+}
+
+TranslationResult HttpBackend::RequestTranslations(const vector<string>& texts, const vector<size_t>& queryIndex,
+                                                        size_t first, size_t count, const string& fromLang,
+                                                        const string& toLang, vector<string>& translations,
+                                                        bool& permanent, uint32_t& statusCode) {
+    TraceSpan span("RequestTranslations");
+    permanent = false;
+    statusCode = 0;
+    // Build request; the builder's buffer is reused between requests
+    static thread_local TranslationRequestBuilder builder;
+    const string& requestBody = builder.Build(texts, queryIndex, first, count, fromLang, toLang);
+    size_t chars = 0;
+    for (size_t i = first; i < first + count; ++i) {
+        chars += UTF8Helper::CodePointCount(texts[queryIndex[i]]);
+    }
+    
+    LOG_DEBUG("Making translation request for ", count, " text(s), first: ", texts[queryIndex[first]]);
+    
+    // Make HTTP request; the parser is reused so steady-state parsing doesn't allocate
+    static thread_local TranslationResponseParser parser;
+    string responseHead;
+    
+    // Transport failures, timeouts, 429 and 5xx are retried after a jittered
+    // backoff while the request's deadline allows
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(requestTimeoutMs);
+    for (unsigned int attempt = 0;; ++attempt) {
+        auto started = chrono::steady_clock::now();
+        uint32_t remaining = static_cast<uint32_t>(max<long long>(
+            chrono::duration_cast<chrono::milliseconds>(deadline - started).count(), 1));
+        
+        {
+            lock_guard<mutex> lock(resilienceMutex);
+            if (!breaker.Allow(started)) {
+                resilienceStats.failedFast++;
+                LOG_DEBUG("Translation endpoint unavailable, request not sent");
+                return TranslationResult::UNAVAILABLE;
+            }
+        }
+        
+        parser.Reset();
+        responseHead.clear();
+        statusCode = 0;
+        TranslationResult status = HttpsRequest(requestPath, requestBody, chars, remaining, HedgeDelay(),
+                                                parser, responseHead, statusCode);
+        uint32_t elapsed = static_cast<uint32_t>(
+            chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count());
+        RecordAttempt(status, statusCode, elapsed);
+        
+        if (status == TranslationResult::SUCCESS) {
+            break;
+        }
+        
+        bool retryable = status != TranslationResult::API_ERROR || IsRetryableStatus(statusCode);
+        if (status == TranslationResult::TIMEOUT_ERROR) {
+            LOG_ERROR("Translation request timed out after ", elapsed, " ms");
+        } else if (status == TranslationResult::NETWORK_ERROR) {
+            LOG_ERROR("HTTP request to translation endpoint failed");
+        } else {
+            LOG_ERROR("Translation API returned HTTP ", statusCode, ": ",
+                      parser.Finish() && !parser.Message().empty() ? parser.Message() : responseHead);
+        }
+        
+        unsigned int delay = retryPolicy.BackoffMs(attempt);
+        if (!retryable || attempt + 1 >= retryPolicy.maxAttempts ||
+            chrono::steady_clock::now() + chrono::milliseconds(delay) >= deadline) {
+            permanent = !retryable;
+            return status;
+        }
+        
+        LOG_DEBUG("Retrying translation request in ", delay, " ms");
+        {
+            lock_guard<mutex> lock(resilienceMutex);
+            resilienceStats.retries++;
+        }
+        TraceSpan backoffSpan("backoff");
+        this_thread::sleep_for(chrono::milliseconds(delay));
+    }
+    
+    // Translations come back in request order. The body was parsed while it
+    // streamed in during HttpsRequest; this is the check and copy-out.
+    TraceSpan parseSpan("ParseTranslationResponse");
+    if (!parser.Finish() || parser.Count() != count) {
+        LOG_ERROR("Failed to parse translation from response: ",
+                  parser.Message().empty() ? responseHead : parser.Message());
+        return TranslationResult::API_ERROR;
+    }
+    
+    for (size_t i = 0; i < count; ++i) {
+        if (parser.Text(i).empty()) {
+            LOG_ERROR("Failed to parse translation from response: ", responseHead);
+            return TranslationResult::API_ERROR;
+        }
+        
+        // Fix UTF-8 encoding issues
+        TraceSpan fixSpan("FixUTF8String");
+        translations[first + i] = UTF8Helper::FixUTF8String(parser.Text(i));
+    }
+    
+    return TranslationResult::SUCCESS;
+}
+
+ResilienceStats HttpBackend::GetStats() const {
+    lock_guard<mutex> lock(resilienceMutex);
+    ResilienceStats result = resilienceStats;
+    result.p50Ms = latencies.Percentile(50);
+    result.p95Ms = latencies.Percentile(95);
+    result.p99Ms = latencies.Percentile(99);
+    result.breaker = breaker.State();
+    result.breakerOpens = breaker.Opens();
+    return result;
+}
@@ -0,0 +1,290 @@
+// json_parser.cpp - Streaming translate API response parser for CET
+
+#include <string>
+#include <vector>
+#include <cstring>
+
+#include "../include/json_parser.h"
+
+using namespace std;
+
+TranslationResponseParser::TranslationResponseParser() {
+    Reset();
+}
+
+void TranslationResponseParser::Reset() {
+    state = State::Scan;
+    target = Target::Skip;
+    textCount = 0;
+    key.clear();
+    message.clear();
+    messageSeen = false;
+    depth = 0;
+    expectKey = false;
+    nextValue = Target::Skip;
+    sawValue = false;
+    failed = false;
+    codeUnit = 0;
+    hexDigits = 0;
+    pendingHigh = 0;
+}
+
+bool TranslationResponseParser::Finish() const {
+    return !failed && sawValue && depth == 0 && state == State::Scan;
+}
+
+string* TranslationResponseParser::Output() {
+    switch (target) {
+        case Target::Key: return &key;
+        case Target::Translation: return &texts[textCount - 1];
+        case Target::Message: return &message;
+        default: return nullptr;
+    }
+}
+
+void TranslationResponseParser::Append(const char* data, size_t size) {
+    string* output = Output();
+    if (!output) {
+        return;
+    }
+
+    // Keys are only compared against short names; don't buffer long ones
+    if (target == Target::Key && key.size() + size > MAX_KEY_LENGTH) {
+        size = key.size() < MAX_KEY_LENGTH ? MAX_KEY_LENGTH - key.size() : 0;
+    }
+    output->append(data, size);
+}
+
+void TranslationResponseParser::AppendCodepoint(uint32_t codepoint) {
+    char buffer[4];
+    size_t length;
+
+    if (codepoint <= 0x7F) {
+        buffer[0] = static_cast<char>(codepoint);
+        length = 1;
+    } else if (codepoint <= 0x7FF) {
+        buffer[0] = static_cast<char>(0xC0 | (codepoint >> 6));
+        buffer[1] = static_cast<char>(0x80 | (codepoint & 0x3F));
+        length = 2;
+    } else if (codepoint <= 0xFFFF) {
+        buffer[0] = static_cast<char>(0xE0 | (codepoint >> 12));
+        buffer[1] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        buffer[2] = static_cast<char>(0x80 | (codepoint & 0x3F));
+        length = 3;
+    } else {
+        buffer[0] = static_cast<char>(0xF0 | (codepoint >> 18));
+        buffer[1] = static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+        buffer[2] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        buffer[3] = static_cast<char>(0x80 | (codepoint & 0x3F));
+        length = 4;
+    }
+
+    Append(buffer, length);
+}
+
+void TranslationResponseParser::FlushSurrogate() {
+    // A high surrogate that is not followed by a low one
+    if (pendingHigh != 0) {
+        AppendCodepoint(0xFFFD);
+        pendingHigh = 0;
+    }
+}
+
+void TranslationResponseParser::CodeUnitDone() {
+    if (codeUnit >= 0xD800 && codeUnit <= 0xDBFF) {
+        FlushSurrogate();
+        pendingHigh = codeUnit;
+    } else if (codeUnit >= 0xDC00 && codeUnit <= 0xDFFF) {
+        if (pendingHigh != 0) {
+            AppendCodepoint(0x10000 + ((pendingHigh - 0xD800) << 10) + (codeUnit - 0xDC00));
+            pendingHigh = 0;
+        } else {
+            AppendCodepoint(0xFFFD);
+        }
+    } else {
+        FlushSurrogate();
+        AppendCodepoint(codeUnit);
+    }
+}
+
+void TranslationResponseParser::StartString() {
+    if (expectKey) {
+        target = Target::Key;
+        key.clear();
+    } else {
+        target = nextValue;
+        nextValue = Target::Skip;
+
+        if (target == Target::Translation) {
+            if (textCount < texts.size()) {
+                texts[textCount].clear();
+            } else {
+                texts.emplace_back();
+            }
+            ++textCount;
+        } else if (target == Target::Message) {
+            messageSeen = true;
+        }
+    }
+    state = State::String;
+}
+
+void TranslationResponseParser::EndString() {
+    FlushSurrogate();
+
+    if (target == Target::Key) {
+        if (key == "translatedText") {
+            nextValue = Target::Translation;
+        } else if (key == "message" && !messageSeen) {
+            nextValue = Target::Message;
+        } else {
+            nextValue = Target::Skip;
+        }
+    }
+
+    sawValue = true;
+    target = Target::Skip;
+    state = State::Scan;
+}
+
+void TranslationResponseParser::StartValue() {
+    // A translatedText that is not a string still takes its slot, empty,
+    // so results stay aligned with the request
+    if (nextValue == Target::Translation) {
+        if (textCount < texts.size()) {
+            texts[textCount].clear();
+        } else {
+            texts.emplace_back();
+        }
+        ++textCount;
+    }
+    nextValue = Target::Skip;
+    sawValue = true;
+}
+
+bool TranslationResponseParser::ScanByte(char c) {
+    switch (c) {
+        case ' ': case '\t': case '\r': case '\n':
+            return true;
+        case '"':
+            StartString();
+            return true;
+        case '{':
+        case '[':
+            if (depth == sizeof(containers)) {
+                return false;
+            }
+            StartValue();
+            containers[depth++] = c;
+            expectKey = c == '{';
+            return true;
+        case '}':
+        case ']':
+            if (depth == 0 || containers[depth - 1] != (c == '}' ? '{' : '[')) {
+                return false;
+            }
+            --depth;
+            expectKey = false;
+            return true;
+        case ',':
+            expectKey = depth > 0 && containers[depth - 1] == '{';
+            nextValue = Target::Skip;
+            return true;
+        case ':':
+            expectKey = false;
+            return true;
+        default:
+            // Numbers, true/false/null
+            if (nextValue != Target::Skip) {
+                StartValue();
+            }
+            sawValue = true;
+            return true;
+    }
+}
+
+bool TranslationResponseParser::Feed(const char* data, size_t size) {
+    const char* end = data + size;
+
+    while (data < end && !failed) {
+        switch (state) {
+            case State::Scan:
+                failed = !ScanByte(*data++);
+                break;
+
+            case State::String: {
+                // Copy the run up to the next quote or backslash in one go
+                const char* run = data;
+                while (data < end && *data != '"' && *data != '\\') {
+                    ++data;
+                }
+                if (data > run) {
+                    FlushSurrogate();
+                    Append(run, data - run);
+                }
+                if (data < end) {
+                    if (*data == '"') {
+                        EndString();
+                    } else {
+                        state = State::Escape;
+                    }
+                    ++data;
+                }
+                break;
+            }
+
+            case State::Escape: {
+                char c = *data++;
+                char decoded;
+                state = State::String;
+
+                switch (c) {
+                    case '"': decoded = '"'; break;
+                    case '\\': decoded = '\\'; break;
+                    case '/': decoded = '/'; break;
+                    case 'b': decoded = '\b'; break;
+                    case 'f': decoded = '\f'; break;
+                    case 'n': decoded = '\n'; break;
+                    case 'r': decoded = '\r'; break;
+                    case 't': decoded = '\t'; break;
+                    case 'u':
+                        state = State::Unicode;
+                        codeUnit = 0;
+                        hexDigits = 0;
+                        continue;
+                    default:
+                        failed = true;
+                        continue;
+                }
+
+                FlushSurrogate();
+                Append(&decoded, 1);
+                break;
+            }
+
+            case State::Unicode: {
+                char c = *data++;
+                uint32_t digit;
+                if (c >= '0' && c <= '9') {
+                    digit = c - '0';
+                } else if (c >= 'a' && c <= 'f') {
+                    digit = c - 'a' + 10;
+                } else if (c >= 'A' && c <= 'F') {
+                    digit = c - 'A' + 10;
+                } else {
+                    failed = true;
+                    break;
+                }
+
+                codeUnit = (codeUnit << 4) | digit;
+                if (++hexDigits == 4) {
+                    CodeUnitDone();
+                    state = State::String;
+                }
+                break;
+            }
+        }
+    }
+
+    return !failed;
+}
@@ -1,113 +1,416 @@
 // logging.cpp - Logging system for CET
+// Callers copy a record into a lock-free ring; a writer thread formats the
+// records and appends them to CET.log in batches
 
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
 #include <string>
-#include <fstream>
-#include <iostream>
+#include <string_view>
+#include <cstring>
 #include <ctime>
-#include <iomanip>
-#include <sstream>
+#include <atomic>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
 
 #include "../include/logging.h"
 #include "../include/utils.h"
+#include "../include/utf8_helper.h"
 
 using namespace std;
 
+static const size_t LOG_RING_CAPACITY = 1024;             // power of two
+static const size_t LOG_RECORD_TEXT = 480;
+static const unsigned int LOG_FLUSH_INTERVAL_MS = 100;
+static const size_t LOG_BATCH_BYTES = 64 * 1024;
+static const unsigned long long LOG_MAX_FILE_BYTES = 4 * 1024 * 1024;
+
+// One slot of the ring. The sequence number tells producers and the writer
+// whose turn the slot is (bounded MPMC queue, used here with one consumer).
+struct LogRecord {
+    atomic<size_t> sequence;
+    LogLevel level;
+    time_t time;
+    uint32_t length;
+    bool truncated;
+    char text[LOG_RECORD_TEXT];
+};
+
 // Global logging state
-static bool g_loggingInitialized = false;
+static atomic<bool> g_loggingInitialized{ false };         // read by every LogToFile
 static string g_logFilePath;
-static mutex g_logMutex;
+static mutex g_logMutex;                                   // guards the file and timestamp cache
+#ifdef _WIN32
+typedef HANDLE LogFileHandle;
+static const LogFileHandle NO_LOG_FILE = INVALID_HANDLE_VALUE;
+#else
+typedef int LogFileHandle;
+static const LogFileHandle NO_LOG_FILE = -1;
+#endif
+static LogFileHandle g_logFile = NO_LOG_FILE;
+static unsigned long long g_logFileBytes = 0;
+static time_t g_stampSecond = -1;
+static char g_stamp[32];
+
+static LogRecord g_ring[LOG_RING_CAPACITY];
+static atomic<size_t> g_enqueuePos{ 0 };
+static atomic<size_t> g_dequeuePos{ 0 };
+static atomic<size_t> g_dropped{ 0 };
+static atomic<bool> g_writerRunning{ false };
+static bool g_writerStop = false;
+// Allocated rather than a static std::thread: if the process exits with the
+// writer still running, destroying a joinable thread would call terminate
+static thread* g_writerThread = nullptr;
+static mutex g_wakeMutex;
+static condition_variable g_wakeup;
+
+atomic<int> g_logLevel{ static_cast<int>(LogLevel::Info) };
+
+static const char* LevelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Info: return "INFO";
+        case LogLevel::Warning: return "WARN";
+        case LogLevel::Error: return "ERROR";
+        case LogLevel::Debug: return "DEBUG";
+    }
+    return "INFO";
+}
+
+// Caller holds g_logMutex
+static bool OpenLogFile() {
+#ifdef _WIN32
+    g_logFile = CreateFileA(g_logFilePath.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (g_logFile == NO_LOG_FILE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    g_logFileBytes = GetFileSizeEx(g_logFile, &size) ? static_cast<unsigned long long>(size.QuadPart) : 0;
+#else
+    g_logFile = open(g_logFilePath.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (g_logFile == NO_LOG_FILE) {
+        return false;
+    }
+
+    struct stat info;
+    g_logFileBytes = fstat(g_logFile, &info) == 0 ? static_cast<unsigned long long>(info.st_size) : 0;
+#endif
+    return true;
+}
+
+// Caller holds g_logMutex
+static void CloseLogFile() {
+    if (g_logFile != NO_LOG_FILE) {
+#ifdef _WIN32
+        CloseHandle(g_logFile);
+#else
+        close(g_logFile);
+#endif
+        g_logFile = NO_LOG_FILE;
+    }
+}
+
+// Caller holds g_logMutex. Keeps one previous log as CET.log.1.
+static void RotateLogFile() {
+    CloseLogFile();
+    string previous = g_logFilePath + ".1";
+#ifdef _WIN32
+    MoveFileExA(g_logFilePath.c_str(), previous.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+    rename(g_logFilePath.c_str(), previous.c_str());
+#endif
+    OpenLogFile();
+}
+
+// Caller holds g_logMutex
+static void WriteLogData(const string& data) {
+    if (data.empty() || g_logFile == NO_LOG_FILE) {
+        return;
+    }
+
+    if (g_logFileBytes + data.size() > LOG_MAX_FILE_BYTES) {
+        RotateLogFile();
+        if (g_logFile == NO_LOG_FILE) {
+            return;
+        }
+    }
+
+#ifdef _WIN32
+    DWORD written = 0;
+    WriteFile(g_logFile, data.data(), static_cast<DWORD>(data.size()), &written, nullptr);
+    g_logFileBytes += written;
+#else
+    ssize_t written = write(g_logFile, data.data(), data.size());
+    g_logFileBytes += written > 0 ? static_cast<unsigned long long>(written) : 0;
+#endif
+}
+
+// Caller holds g_logMutex. Timestamps are formatted once per second.
+static void AppendLogLine(string& out, time_t when, LogLevel level, const char* text, size_t length, bool truncated) {
+    if (when != g_stampSecond) {
+        tm timeinfo;
+        localtime_s(&timeinfo, &when);
+        strftime(g_stamp, sizeof(g_stamp), "%Y-%m-%d %H:%M:%S", &timeinfo);
+        g_stampSecond = when;
+    }
+
+    out += '[';
+    out += g_stamp;
+    out += "] [";
+    out += LevelName(level);
+    out += "] ";
+    out.append(text, length);
+    if (truncated) {
+        out += "...";
+    }
+    out += '\n';
+}
+
+// Copy a record into the ring. Returns false if the ring is full.
+static bool PushRecord(LogLevel level, string_view message) {
+    size_t pos = g_enqueuePos.load(memory_order_relaxed);
+    LogRecord* record;
+
+    for (;;) {
+        record = &g_ring[pos & (LOG_RING_CAPACITY - 1)];
+        size_t sequence = record->sequence.load(memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+        if (diff == 0) {
+            if (g_enqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = g_enqueuePos.load(memory_order_relaxed);
+        }
+    }
+
+    size_t length = UTF8Helper::SafeTruncateLength(message, LOG_RECORD_TEXT);
+    record->level = level;
+    record->time = time(nullptr);
+    record->length = static_cast<uint32_t>(length);
+    record->truncated = length < message.size();
+    memcpy(record->text, message.data(), length);
+    record->sequence.store(pos + 1, memory_order_release);
+    return true;
+}
+
+// Format every record currently in the ring into batch. Only the writer
+// thread (or cleanup, after it has stopped) calls this.
+static void DrainRing(string& batch) {
+    size_t pos = g_dequeuePos.load(memory_order_relaxed);
+
+    for (;;) {
+        LogRecord* record = &g_ring[pos & (LOG_RING_CAPACITY - 1)];
+        if (record->sequence.load(memory_order_acquire) != pos + 1) {
+            break;
+        }
+
+        AppendLogLine(batch, record->time, record->level, record->text, record->length, record->truncated);
+        record->sequence.store(pos + LOG_RING_CAPACITY, memory_order_release);
+        ++pos;
+        g_dequeuePos.store(pos, memory_order_relaxed);
+
+        if (batch.size() >= LOG_BATCH_BYTES) {
+            WriteLogData(batch);
+            batch.clear();
+        }
+    }
+
+    size_t dropped = g_dropped.exchange(0, memory_order_relaxed);
+    if (dropped > 0) {
+        string notice = to_string(dropped) + " log messages dropped, log buffer full";
+        AppendLogLine(batch, time(nullptr), LogLevel::Warning, notice.data(), notice.size(), false);
+    }
+}
+
+static void LogWriterLoop() {
+    string batch;
+    batch.reserve(LOG_BATCH_BYTES);
+
+    for (;;) {
+        bool stopping;
+        {
+            unique_lock<mutex> lock(g_wakeMutex);
+            g_wakeup.wait_for(lock, chrono::milliseconds(LOG_FLUSH_INTERVAL_MS));
+            stopping = g_writerStop;
+        }
+
+        {
+            lock_guard<mutex> lock(g_logMutex);
+            DrainRing(batch);
+            WriteLogData(batch);
+        }
+        batch.clear();
+
+        if (stopping) {
+            return;
+        }
+    }
+}
 
 bool InitializeLogging() {
     lock_guard<mutex> lock(g_logMutex);
-    
-    if (g_loggingInitialized) {
+
+    if (g_loggingInitialized.load(memory_order_relaxed)) {
         return true;
     }
-    
+
     try {
         // Get the DLL directory
-        string dllPath = GetDllPath();
-        if (dllPath.empty()) {
+        string dllDir = GetDllDirectoryPath();
+        if (dllDir.empty()) {
             return false;
         }
-        
-        // Extract directory from DLL path
-        size_t lastSlash = dllPath.find_last_of("\\/");
-        string dllDir = dllPath.substr(0, lastSlash);
-        
+
         // Create log file path
-        g_logFilePath = dllDir + "\\CET.log";
-        
-        // Test if we can write to the log file
-        ofstream testFile(g_logFilePath, ios::app);
-        if (!testFile.is_open()) {
+        g_logFilePath = JoinPath(dllDir, "CET.log");
+
+        if (!OpenLogFile()) {
             return false;
         }
-        
+
+        for (size_t i = 0; i < LOG_RING_CAPACITY; ++i) {
+            g_ring[i].sequence.store(i, memory_order_relaxed);
+        }
+        g_enqueuePos.store(0, memory_order_relaxed);
+        g_dequeuePos.store(0, memory_order_relaxed);
+        g_dropped.store(0, memory_order_relaxed);
+
         // Write initialization message
-        testFile << "\n" << string(60, '=') << "\n";
-        testFile << "CET Library initialized at " << GetCurrentTimestamp() << "\n";
-        testFile << string(60, '=') << "\n";
-        testFile.close();
-        
-        g_loggingInitialized = true;
+        string banner = "\n" + string(60, '=') + "\n";
+        banner += "CET Library initialized at " + GetCurrentTimestamp() + "\n";
+        banner += string(60, '=') + "\n";
+        WriteLogData(banner);
+
+        g_loggingInitialized.store(true, memory_order_release);
         return true;
-        
+
     } catch (...) {
         return false;
     }
 }
 
-void CleanupLogging() {
+void StartLogWriter() {
+    if (!g_loggingInitialized.load(memory_order_acquire) || g_writerRunning.load(memory_order_acquire)) {
+        return;
+    }
+
     lock_guard<mutex> lock(g_logMutex);
-    
-    if (!g_loggingInitialized) {
+    if (g_writerRunning.load(memory_order_relaxed)) {
         return;
     }
-    
+
+    // Started from the first Lua call rather than from DllMain, so the
+    // thread is never created while the loader lock is held
     try {
-        // Write cleanup message
-        ofstream logFile(g_logFilePath, ios::app);
-        if (logFile.is_open()) {
-            logFile << "[" << GetCurrentTimestamp() << "] [INFO] CET Library cleanup complete\n";
-            logFile << string(60, '=') << "\n\n";
-            logFile.close();
-        }
+        g_writerStop = false;
+        g_writerThread = new thread(LogWriterLoop);
+        g_writerRunning.store(true, memory_order_release);
     } catch (...) {
-        // Ignore errors during cleanup
+        // Keep writing synchronously
     }
-    
-    g_loggingInitialized = false;
 }
 
-void LogToFile(LogLevel level, const string& message) {
-    if (!g_loggingInitialized) {
+void SetLogLevel(LogLevel level) {
+    g_logLevel.store(static_cast<int>(level), memory_order_relaxed);
+}
+
+bool ParseLogLevel(const string& name, LogLevel& level) {
+    if (name == "debug") level = LogLevel::Debug;
+    else if (name == "info") level = LogLevel::Info;
+    else if (name == "warning") level = LogLevel::Warning;
+    else if (name == "error") level = LogLevel::Error;
+    else return false;
+    return true;
+}
+
+void StopLogWriter() {
+    if (!g_writerRunning.load(memory_order_acquire) || !g_writerThread) {
         return;
     }
-    
+
+    {
+        lock_guard<mutex> lock(g_wakeMutex);
+        g_writerStop = true;
+    }
+    g_wakeup.notify_all();
+    g_writerThread->join();
+    delete g_writerThread;
+    g_writerThread = nullptr;
+    g_writerRunning.store(false, memory_order_release);
+
+    // Records pushed while the writer made its last pass
+    lock_guard<mutex> lock(g_logMutex);
+    string tail;
+    DrainRing(tail);
+    WriteLogData(tail);
+}
+
+void CleanupLogging() {
+    if (!g_loggingInitialized.load(memory_order_acquire)) {
+        return;
+    }
+
+    // Called from DllMain, so the writer cannot be joined here; while it
+    // runs it keeps the file, and the process closes it
+    if (g_writerRunning.load(memory_order_acquire)) {
+        return;
+    }
+
     lock_guard<mutex> lock(g_logMutex);
-    
+
     try {
-        ofstream logFile(g_logFilePath, ios::app);
-        if (!logFile.is_open()) {
+        // Anything logged after the writer's last pass, then the cleanup message
+        string tail;
+        DrainRing(tail);
+        AppendLogLine(tail, time(nullptr), LogLevel::Info, "CET Library cleanup complete", 28, false);
+        tail += string(60, '=') + "\n\n";
+        WriteLogData(tail);
+    } catch (...) {
+        // Ignore errors during cleanup
+    }
+
+    CloseLogFile();
+    g_loggingInitialized.store(false, memory_order_release);
+}
+
+void LogToFile(LogLevel level, string_view message) {
+    if (!g_loggingInitialized.load(memory_order_acquire)) {
+        return;
+    }
+
+    try {
+        if (!g_writerRunning.load(memory_order_acquire)) {
+            // Before the writer thread is up (DllMain) lines go straight to the file
+            lock_guard<mutex> lock(g_logMutex);
+            string line;
+            size_t length = UTF8Helper::SafeTruncateLength(message, LOG_RECORD_TEXT);
+            AppendLogLine(line, time(nullptr), level, message.data(), length, length < message.size());
+            WriteLogData(line);
+            return;
+        }
+
+        if (!PushRecord(level, message)) {
+            g_dropped.fetch_add(1, memory_order_relaxed);
+            g_wakeup.notify_one();
             return;
         }
-        
-        // Get level string
-        string levelStr;
-        switch (level) {
-            case LogLevel::Info: levelStr = "INFO"; break;
-            case LogLevel::Warning: levelStr = "WARN"; break;
-            case LogLevel::Error: levelStr = "ERROR"; break;
-            case LogLevel::Debug: levelStr = "DEBUG"; break;
+
+        // Errors, and a ring that is filling up, are written without waiting
+        // for the next flush interval
+        size_t queued = g_enqueuePos.load(memory_order_relaxed) - g_dequeuePos.load(memory_order_relaxed);
+        if (level == LogLevel::Error || queued > LOG_RING_CAPACITY / 2) {
+            g_wakeup.notify_one();
         }
-        
-        // Write log entry
-        logFile << "[" << GetCurrentTimestamp() << "] [" << levelStr << "] " << message << "\n";
-        logFile.close();
-        
     } catch (...) {
         // Ignore logging errors to prevent cascading failures
     }
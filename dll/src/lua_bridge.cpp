@@ -0,0 +1,149 @@
+// lua_bridge.cpp - Lua C API access and the UnitXP hook entry point for CET
+
+#include <string>
+#include <string_view>
+#include <exception>
+
+#include "../include/lua_interface.h"
+#include "../include/logging.h"
+#include "../include/metrics.h"
+#include "../include/trace.h"
+
+using namespace std;
+
+// Memory addresses for Turtle WoW Lua functions (from working UnitXP_SP3)
+static auto p_GetContext = reinterpret_cast<GETCONTEXT>(0x7040D0);
+static auto p_lua_pushstring = reinterpret_cast<LUA_PUSHSTRING>(0x006F3890);
+static auto p_lua_pushboolean = reinterpret_cast<LUA_PUSHBOOLEAN>(0x006F39F0);
+static auto p_lua_pushnumber = reinterpret_cast<LUA_PUSHNUMBER>(0x006F3810);
+static auto p_lua_pushnil = reinterpret_cast<LUA_PUSHNIL>(0x006F37F0);
+static auto p_lua_tostring = reinterpret_cast<LUA_TOSTRING>(0x006F3690);
+static auto p_lua_tonumber = reinterpret_cast<LUA_TONUMBER>(0x006F3620);
+static auto p_lua_toboolean = reinterpret_cast<LUA_TOBOOLEAN>(0x6F3660);
+static auto p_lua_gettop = reinterpret_cast<LUA_GETTOP>(0x006F3070);
+static auto p_lua_isnumber = reinterpret_cast<LUA_ISNUMBER>(0x006F34D0);
+static auto p_lua_isstring = reinterpret_cast<LUA_ISSTRING>(0x6F3510);
+
+LUA_CFUNCTION g_originalUnitXP = nullptr;
+
+void SetLuaApi(const LuaApi& api) {
+    p_GetContext = api.getContext;
+    p_lua_pushstring = api.pushstring;
+    p_lua_pushboolean = api.pushboolean;
+    p_lua_pushnumber = api.pushnumber;
+    p_lua_pushnil = api.pushnil;
+    p_lua_tostring = api.tostring;
+    p_lua_tonumber = api.tonumber;
+    p_lua_toboolean = api.toboolean;
+    p_lua_gettop = api.gettop;
+    p_lua_isnumber = api.isnumber;
+    p_lua_isstring = api.isstring;
+}
+
+// Helper functions
+void* GetLuaContext() {
+    void* result = p_GetContext();
+    if (!result) {
+        LOG_ERROR("Lua context is NULL");
+    }
+    return result;
+}
+
+void lua_pushstring(void* L, const char* str) {
+    if (p_lua_pushstring && L) {
+        p_lua_pushstring(L, str);
+    }
+}
+
+void lua_pushstring(void* L, const string& str) {
+    lua_pushstring(L, str.c_str());
+}
+
+void lua_pushboolean(void* L, bool value) {
+    if (p_lua_pushboolean && L) {
+        p_lua_pushboolean(L, value ? 1 : 0);
+    }
+}
+
+void lua_pushnumber(void* L, double value) {
+    if (p_lua_pushnumber && L) {
+        p_lua_pushnumber(L, value);
+    }
+}
+
+void lua_pushnil(void* L) {
+    if (p_lua_pushnil && L) {
+        p_lua_pushnil(L);
+    }
+}
+
+string_view lua_tostring(void* L, int index) {
+    if (!p_lua_tostring || !L) return string_view();
+    const char* ptr = p_lua_tostring(L, index);
+    return ptr ? string_view(ptr) : string_view();
+}
+
+double lua_tonumber(void* L, int index) {
+    if (!p_lua_tonumber || !L) return 0.0;
+    return p_lua_tonumber(L, index);
+}
+
+bool lua_toboolean(void* L, int index) {
+    if (!p_lua_toboolean || !L) return false;
+    return p_lua_toboolean(L, index) != 0;
+}
+
+int lua_gettop(void* L) {
+    if (!p_lua_gettop || !L) return 0;
+    return p_lua_gettop(L);
+}
+
+bool lua_isnumber(void* L, int index) {
+    if (!p_lua_isnumber || !L) return false;
+    return p_lua_isnumber(L, index) != 0;
+}
+
+bool lua_isstring(void* L, int index) {
+    if (!p_lua_isstring || !L) return false;
+    return p_lua_isstring(L, index) != 0;
+}
+
+// Run a CET subcommand; exceptions become an error string for Lua
+static int GuardedCetCommand(void* L) {
+    try {
+        return HandleCetCommand(L);
+
+    } catch (const exception& e) {
+        string error = "CET Exception: " + string(e.what());
+        LOG_ERROR(error);
+        lua_pushstring(L, error);
+        return 1;
+    } catch (...) {
+        string error = "CET Unknown Exception";
+        LOG_ERROR(error);
+        lua_pushstring(L, error);
+        return 1;
+    }
+}
+
+// Main CET command handler - following exact UnitXP_SP3 pattern like working DLua
+int __fastcall detoured_UnitXP(void* L) {
+    // Other addons call UnitXP all the time. Anything whose first argument
+    // is not exactly "CET" goes straight to the original, without copying
+    // the argument or entering the exception handlers.
+    CountMetric(Metric::HookCalls);
+    const char* cmd = lua_gettop(L) >= 1 ? p_lua_tostring(L, 1) : nullptr;
+    if (!cmd || cmd[0] != 'C' || cmd[1] != 'E' || cmd[2] != 'T' || cmd[3] != '\0') {
+        // Not our command - call original UnitXP if available
+        return g_originalUnitXP ? g_originalUnitXP(L) : 0;
+    }
+
+    CountMetric(Metric::CetCommands);
+    if (TraceEnabled()) {
+        // Everything this call starts, queued work included, shares one ID
+        TraceIdScope trace(NewTraceId());
+        TraceSpan span("detoured_UnitXP");
+        return GuardedCetCommand(L);
+    }
+    return GuardedCetCommand(L);
+}
@@ -1,234 +1,525 @@
 // lua_interface.cpp - Consolidated Lua interface for CET
-// Handles both DLL communication and translation functionality
+// Subcommand handlers and the UnitXP hook; Lua API access lives in lua_bridge.cpp
 
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <vector>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
 
 #ifdef MINHOOK_AVAILABLE
 #include "MinHook.h"
 #endif
 
 #include "../include/lua_interface.h"
+#include "../include/command_table.h"
 #include "../include/translator_core.h"
+#include "../include/translation_worker.h"
+#include "../include/script_detect.h"
 #include "../include/logging.h"
+#include "../include/metrics.h"
+#include "../include/trace.h"
 #include "../include/utils.h"
 
 using namespace std;
 
-// Lua function pointer types (following UnitXP_SP3 exactly)
-typedef void* (__fastcall* GETCONTEXT)(void);
-typedef void (__fastcall* LUA_PUSHSTRING)(void* L, const char* s);
-typedef void (__fastcall* LUA_PUSHBOOLEAN)(void* L, int boolean_value);
-typedef void (__fastcall* LUA_PUSHNUMBER)(void* L, double n);
-typedef void (__fastcall* LUA_PUSHNIL)(void* L);
-typedef const char* (__fastcall* LUA_TOSTRING)(void* L, int index);
-typedef double (__fastcall* LUA_TONUMBER)(void* L, int index);
-typedef int (__fastcall* LUA_TOBOOLEAN)(void* L, int index);
-typedef int (__fastcall* LUA_GETTOP)(void* L);
-typedef int (__fastcall* LUA_ISNUMBER)(void* L, int index);
-typedef int (__fastcall* LUA_ISSTRING)(void* L, int index);
-
-// Memory addresses for Turtle WoW Lua functions (from working UnitXP_SP3)
-static auto p_GetContext = reinterpret_cast<GETCONTEXT>(0x7040D0);
-static auto p_lua_pushstring = reinterpret_cast<LUA_PUSHSTRING>(0x006F3890);
-static auto p_lua_pushboolean = reinterpret_cast<LUA_PUSHBOOLEAN>(0x006F39F0);
-static auto p_lua_pushnumber = reinterpret_cast<LUA_PUSHNUMBER>(0x006F3810);
-static auto p_lua_pushnil = reinterpret_cast<LUA_PUSHNIL>(0x006F37F0);
-static auto p_lua_tostring = reinterpret_cast<LUA_TOSTRING>(0x006F3690);
-static auto p_lua_tonumber = reinterpret_cast<LUA_TONUMBER>(0x006F3620);
-static auto p_lua_toboolean = reinterpret_cast<LUA_TOBOOLEAN>(0x6F3660);
-static auto p_lua_gettop = reinterpret_cast<LUA_GETTOP>(0x006F3070);
-static auto p_lua_isnumber = reinterpret_cast<LUA_ISNUMBER>(0x006F34D0);
-static auto p_lua_isstring = reinterpret_cast<LUA_ISSTRING>(0x6F3510);
-
+#ifdef MINHOOK_AVAILABLE
 // Hook target - we hook the UnitXP function and replace it with CET
 static auto p_UnitXP = reinterpret_cast<LUA_CFUNCTION>(0x517350);  // Same as UnitXP_SP3
-static LUA_CFUNCTION p_original_UnitXP = nullptr;
+#endif
 
 // State tracking
 static bool g_initialized = false;
+static bool g_shutdown = true;         // see IsCETShutdown
+static unsigned long g_statsDumpMs = 0; // stats_dump_ms, started with the translator
 
-// Helper functions
-void* GetLuaContext() {
-    void* result = p_GetContext();
-    if (!result) {
-        LOG_ERROR("Lua context is NULL");
+// Comma-separated list from the addon, blanks dropped
+static vector<string> ParseList(const string& value) {
+    vector<string> items;
+    for (const string& item : SplitString(value, ',')) {
+        string trimmed = TrimString(item);
+        if (!trimmed.empty()) {
+            items.push_back(trimmed);
+        }
     }
-    return result;
+    return items;
 }
 
-void lua_pushstring(void* L, const string& str) {
-    if (p_lua_pushstring && L) {
-        p_lua_pushstring(L, str.c_str());
+static string BuildStatsLine();
+
+// The dump reads the translator's stats, so it only runs between
+// init_translator and ShutdownCET
+static void ApplyStatsDump() {
+    if (!g_shutdown) {
+        SetMetricsDump(JoinPath(GetDllDirectoryPath(), "CET_stats.log"), g_statsDumpMs, BuildStatsLine);
     }
 }
 
-void lua_pushboolean(void* L, bool value) {
-    if (p_lua_pushboolean && L) {
-        p_lua_pushboolean(L, value ? 1 : 0);
+// Apply a runtime tunable sent by the addon; returns false for unknown keys
+static bool ApplyConfigValue(const string& key, const string& value) {
+    unsigned long number = strtoul(value.c_str(), nullptr, 10);
+    
+    if (key == "api_endpoint") {
+        if (g_translator) g_translator->SetEndpoint(value);
+        return true;
+    }
+    if (key == "connection_pool_size") {
+        if (g_translator) g_translator->SetConnectionPoolSize(number);
+        return true;
+    }
+    if (key == "keepalive_ms") {
+        if (g_translator) g_translator->SetKeepAliveInterval(number);
+        return true;
+    }
+    if (key == "cache_expiration") {
+        if (g_translator) g_translator->SetCacheExpiry(number);
+        return true;
+    }
+    if (key == "cache_max_bytes") {
+        if (g_translator) g_translator->SetCacheBudget(number);
+        return true;
+    }
+    if (key == "disk_cache_max_bytes") {
+        if (g_translator) g_translator->SetDiskCacheBudget(number);
+        return true;
+    }
+    if (key == "batch_window_ms") {
+        if (g_translationWorker) g_translationWorker->SetBatchWindow(number);
+        return true;
+    }
+    if (key == "batch_max_items") {
+        if (g_translationWorker) g_translationWorker->SetBatchMaxItems(number);
+        return true;
+    }
+    if (key == "batch_max_bytes") {
+        if (g_translationWorker) g_translationWorker->SetBatchMaxBytes(number);
+        return true;
+    }
+    if (key == "quota_requests_per_sec") {
+        if (g_translationWorker) g_translationWorker->SetRequestQuota(number);
+        return true;
+    }
+    if (key == "quota_chars_per_sec") {
+        if (g_translationWorker) g_translationWorker->SetCharQuota(number);
+        return true;
+    }
+    if (key == "shed_group_ms") {
+        if (g_translationWorker) g_translationWorker->SetShedDeadline(TranslationPriority::Group, number);
+        return true;
+    }
+    if (key == "shed_public_ms") {
+        if (g_translationWorker) g_translationWorker->SetShedDeadline(TranslationPriority::Public, number);
+        return true;
     }
+    if (key == "request_timeout_ms") {
+        if (g_translator) g_translator->SetRequestTimeout(number);
+        return true;
+    }
+    if (key == "retry_attempts") {
+        if (g_translator) g_translator->SetRetryAttempts(number);
+        return true;
+    }
+    if (key == "hedge_requests") {
+        if (g_translator) g_translator->SetHedging(value == "true" || value == "1");
+        return true;
+    }
+    if (key == "breaker_failures") {
+        if (g_translator) g_translator->SetBreakerThreshold(number);
+        return true;
+    }
+    if (key == "breaker_open_ms") {
+        if (g_translator) g_translator->SetBreakerOpenTime(number);
+        return true;
+    }
+    if (key == "phrase_tables") {
+        if (g_translator) g_translator->SetPhraseTables(value == "true" || value == "1");
+        return true;
+    }
+    if (key == "mask_placeholders") {
+        if (g_translator) g_translator->SetMasking(value == "true" || value == "1");
+        return true;
+    }
+    if (key == "glossary") {
+        if (g_translator) g_translator->SetGlossaryTerms(ParseList(value));
+        return true;
+    }
+    if (key == "glossary_names") {
+        if (g_translator) g_translator->SetGlossaryNames(ParseList(value));
+        return true;
+    }
+    if (key == "stats_dump_ms") {
+        g_statsDumpMs = number;
+        ApplyStatsDump();
+        return true;
+    }
+    if (key == "log_level") {
+        LogLevel level;
+        if (!ParseLogLevel(value, level)) {
+            return false;
+        }
+        SetLogLevel(level);
+        return true;
+    }
+    
+    return false;
+}
+
+// CET subcommand handlers. Each one is called with the Lua state after
+// "CET" and the subcommand name have been matched, and returns the number
+// of values it pushed.
+static int CmdPing(void* L) {
+    lua_pushstring(L, "CET pong - DLL communication active");
+    LOG_DEBUG("CET Ping -> Pong");
+    return 1;
 }
 
-void lua_pushnumber(void* L, double value) {
-    if (p_lua_pushnumber && L) {
-        p_lua_pushnumber(L, value);
+static int CmdVersion(void* L) {
+    lua_pushstring(L, "CET v1.0.0 - Chat Event Trigger with Translation");
+    return 1;
+}
+
+static int CmdStatus(void* L) {
+    string status = "CET Status: DLL Active, Translator ";
+    status += (g_translator && g_translator->IsInitialized()) ? "Ready" : "Not Ready";
+    if (g_translator) {
+        TranslationMemoryStats memory = g_translator->GetMemoryStats();
+        status += ", cache hits: " + to_string(memory.messageHits) + "/" + to_string(memory.messages) +
+                  " messages, " + to_string(memory.segmentHits) + "/" + to_string(memory.segments) + " segments";
+        status += ", saved queries: " + to_string(memory.SavedQueries()) + " (" + to_string(memory.coalesced) +
+                  " coalesced, " + to_string(memory.negativeHits) + " negative, " + to_string(memory.localHits) +
+                  " phrase)";
+        ResilienceStats requests = g_translator->GetResilienceStats();
+        status += ", latency p50/p95/p99: " + to_string(requests.p50Ms) + "/" + to_string(requests.p95Ms) + "/" +
+                  to_string(requests.p99Ms) + " ms, retries " + to_string(requests.retries) + ", timeouts " +
+                  to_string(requests.timeouts) + ", hedges " + to_string(requests.hedgeWins) + "/" +
+                  to_string(requests.hedges) + ", breaker " + BreakerStateToString(requests.breaker);
+    }
+    if (g_translationWorker) {
+        SchedulerStats queue = g_translationWorker->GetSchedulerStats();
+        status += ", queued";
+        uint64_t shed = 0;
+        for (size_t i = 0; i < PRIORITY_COUNT; ++i) {
+            status += " " + string(PriorityToString(static_cast<TranslationPriority>(i))) + ":" +
+                      to_string(queue.classes[i].depth);
+            shed += queue.classes[i].shed + queue.classes[i].rejected;
+        }
+        status += ", dropped " + to_string(shed) + ", throttled " + to_string(queue.throttled);
     }
+    lua_pushstring(L, status);
+    return 1;
 }
 
-void lua_pushnil(void* L) {
-    if (p_lua_pushnil && L) {
-        p_lua_pushnil(L);
+// One line of space separated key=value integers, for the addon, scripts
+// and the periodic stats file
+static string BuildStatsLine() {
+    string line = "cet_stats";
+    AppendMetrics(line, GetMetrics());
+
+    if (g_translator) {
+        size_t entries = 0;
+        size_t bytes = 0;
+        TranslationCacheStats cache = g_translator->GetCacheStats(entries, bytes);
+        AppendStat(line, "cache_hits", cache.hits);
+        AppendStat(line, "cache_misses", cache.misses);
+        AppendStat(line, "cache_insertions", cache.insertions);
+        AppendStat(line, "cache_evictions", cache.evictions);
+        AppendStat(line, "cache_expirations", cache.expirations);
+        AppendStat(line, "cache_rejections", cache.rejections);
+        AppendStat(line, "cache_entries", entries);
+        AppendStat(line, "cache_bytes", bytes);
+
+        TranslationMemoryStats memory = g_translator->GetMemoryStats();
+        AppendStat(line, "messages", memory.messages);
+        AppendStat(line, "message_hits", memory.messageHits);
+        AppendStat(line, "segments", memory.segments);
+        AppendStat(line, "segment_hits", memory.segmentHits);
+        AppendStat(line, "coalesced", memory.coalesced);
+        AppendStat(line, "negative_hits", memory.negativeHits);
+        AppendStat(line, "local_hits", memory.localHits);
+
+        ResilienceStats requests = g_translator->GetResilienceStats();
+        AppendStat(line, "retries", requests.retries);
+        AppendStat(line, "timeouts", requests.timeouts);
+        AppendStat(line, "hedges", requests.hedges);
+        AppendStat(line, "hedge_wins", requests.hedgeWins);
+        AppendStat(line, "failed_fast", requests.failedFast);
+        AppendStat(line, "breaker_opens", requests.breakerOpens);
+        AppendStat(line, "breaker_state", static_cast<uint64_t>(requests.breaker));
     }
+    if (g_translationWorker) {
+        SchedulerStats queue = g_translationWorker->GetSchedulerStats();
+        AppendStat(line, "batches", queue.requests);
+        AppendStat(line, "throttled", queue.throttled);
+        for (size_t i = 0; i < PRIORITY_COUNT; ++i) {
+            string prefix = PriorityToString(static_cast<TranslationPriority>(i));
+            const SchedulerClassStats& queueClass = queue.classes[i];
+            AppendStat(line, (prefix + "_queued").c_str(), queueClass.depth);
+            AppendStat(line, (prefix + "_submitted").c_str(), queueClass.submitted);
+            AppendStat(line, (prefix + "_shed").c_str(), queueClass.shed);
+            AppendStat(line, (prefix + "_rejected").c_str(), queueClass.rejected);
+            AppendStat(line, (prefix + "_max_wait_ms").c_str(), queueClass.maxWaitMs);
+        }
+    }
+    return line;
 }
 
-string lua_tostring(void* L, int index) {
-    if (!p_lua_tostring || !L) return "";
-    const char* ptr = p_lua_tostring(L, index);
-    return ptr ? string(ptr) : "";
+static int CmdStats(void* L) {
+    lua_pushstring(L, BuildStatsLine());
+    return 1;
 }
 
-double lua_tonumber(void* L, int index) {
-    if (!p_lua_tonumber || !L) return 0.0;
-    return p_lua_tonumber(L, index);
+// UnitXP("CET", "trace", "on" | "off" | "dump")
+static int CmdTrace(void* L) {
+    string_view action = lua_gettop(L) >= 3 ? lua_tostring(L, 3) : "";
+    if (action == "on" || action == "off") {
+        SetTracing(action == "on");
+        lua_pushstring(L, action == "on" ? "CET trace: recording" : "CET trace: stopped");
+        return 1;
+    }
+    if (action == "dump") {
+        string path = JoinPath(GetDllDirectoryPath(), "CET_trace.json");
+        size_t events = 0;
+        if (ExportTrace(path, events)) {
+            lua_pushstring(L, "CET trace: wrote " + to_string(events) + " spans to " + path);
+        } else {
+            lua_pushstring(L, "CET trace error: cannot write " + path);
+        }
+        return 1;
+    }
+    lua_pushstring(L, "CET trace error: expected on, off or dump");
+    return 1;
 }
 
-bool lua_toboolean(void* L, int index) {
-    if (!p_lua_toboolean || !L) return false;
-    return p_lua_toboolean(L, index) != 0;
+// Stop the background threads before the DLL can be unloaded
+static int CmdShutdown(void* L) {
+    ShutdownCET();
+    lua_pushstring(L, "CET shutdown complete");
+    return 1;
 }
 
-int lua_gettop(void* L) {
-    if (!p_lua_gettop || !L) return 0;
-    return p_lua_gettop(L);
+static int CmdInitTranslator(void* L) {
+    if (lua_gettop(L) >= 3) {
+        string apiKey{ lua_tostring(L, 3) };
+
+        // Only initialization starts the translator's and the worker's
+        // threads; any other command after ShutdownCET leaves them stopped
+        g_shutdown = false;
+        ApplyStatsDump();
+        if (g_translator && g_translator->Initialize(apiKey)) {
+            lua_pushstring(L, "CET translator initialized successfully");
+            LOG_INFO(apiKey.empty() ? "Translator initialized offline" : "Translator initialized with API key");
+        } else {
+            lua_pushstring(L, "CET init_translator error: initialization failed");
+            LOG_ERROR("Translator initialization failed");
+        }
+        return 1;
+    }
+    lua_pushstring(L, "CET init_translator error: API key required");
+    return 1;
 }
 
-bool lua_isnumber(void* L, int index) {
-    if (!p_lua_isnumber || !L) return false;
-    return p_lua_isnumber(L, index) != 0;
+static int CmdTranslate(void* L) {
+    if (lua_gettop(L) >= 5) {
+        string_view text = lua_tostring(L, 3);
+        string_view fromLang = lua_tostring(L, 4);
+        string_view toLang = lua_tostring(L, 5);
+
+        if (!g_translator || !g_translator->IsInitialized()) {
+            lua_pushstring(L, "CET translate error: translator not initialized");
+            return 1;
+        }
+
+        if (text.empty()) {
+            lua_pushstring(L, "CET translate error: empty text provided");
+            return 1;
+        }
+
+        static thread_local string result;
+        auto started = chrono::steady_clock::now();
+        TranslationResult translateResult = g_translator->TranslateText(text, fromLang, toLang, result);
+        RecordResult(translateResult);
+        RecordLatency(LatencyMetric::EndToEnd, static_cast<uint32_t>(chrono::duration_cast<chrono::milliseconds>(
+                                                   chrono::steady_clock::now() - started).count()));
+
+        if (translateResult == TranslationResult::SUCCESS) {
+            lua_pushstring(L, result);
+            LOG_DEBUG("Translation successful: ", text, " -> ", result);
+        } else {
+            const char* error = TranslationErrorReply(translateResult);
+            lua_pushstring(L, error);
+            LOG_ERROR("Translation failed: ", error);
+        }
+        return 1;
+    }
+    lua_pushstring(L, "CET translate error: insufficient arguments (text, fromLang, toLang required)");
+    return 1;
+}
+
+// Returns a ticket for the worker to fill in; a cache hit is returned
+// immediately as ticket 0 plus the translation. An optional sixth argument
+// gives the priority class ("direct", "group" or "public", the default).
+static int CmdTranslateAsync(void* L) {
+    if (lua_gettop(L) >= 5) {
+        string_view text = lua_tostring(L, 3);
+        string_view fromLang = lua_tostring(L, 4);
+        string_view toLang = lua_tostring(L, 5);
+
+        if (!g_translator || !g_translator->IsInitialized() || !g_translationWorker) {
+            lua_pushstring(L, "CET translate error: translator not initialized");
+            return 1;
+        }
+
+        if (text.empty()) {
+            lua_pushstring(L, "CET translate error: empty text provided");
+            return 1;
+        }
+
+        static thread_local string cached;
+        if (g_translator->LookupCached(text, fromLang, toLang, cached)) {
+            lua_pushnumber(L, 0);
+            lua_pushstring(L, cached);
+            return 2;
+        }
+
+        TranslationPriority priority = TranslationPriority::Public;
+        if (lua_gettop(L) >= 6) {
+            ParsePriority(lua_tostring(L, 6), priority);
+        }
+
+        uint32_t ticket = g_translationWorker->Submit(text, fromLang, toLang, priority);
+        if (ticket == 0) {
+            lua_pushstring(L, "CET translate error: queue full");
+            return 1;
+        }
+
+        lua_pushnumber(L, static_cast<double>(ticket));
+        return 1;
+    }
+    lua_pushstring(L, "CET translate error: insufficient arguments (text, fromLang, toLang required)");
+    return 1;
 }
 
-bool lua_isstring(void* L, int index) {
-    if (!p_lua_isstring || !L) return false;
-    return p_lua_isstring(L, index) != 0;
+// Language code (nil if no letters), script name, confidence
+static int CmdDetect(void* L) {
+    if (lua_gettop(L) >= 3) {
+        ScriptDetection detection = DetectScript(lua_tostring(L, 3));
+
+        const char* language = ScriptLanguageCode(detection.script);
+        if (language) {
+            lua_pushstring(L, language);
+        } else {
+            lua_pushnil(L);
+        }
+        lua_pushstring(L, ScriptToString(detection.script));
+        lua_pushnumber(L, detection.confidence);
+        return 3;
+    }
+    lua_pushstring(L, "CET detect error: text required");
+    return 1;
 }
 
-// Main CET command handler - following exact UnitXP_SP3 pattern like working DLua
-int __fastcall detoured_UnitXP(void* L) {
-    try {
-        if (lua_gettop(L) >= 1) {
-            string cmd{ lua_tostring(L, 1) };
-            
-            // Check if this is a CET command - use "CET" as the first parameter
-            if (cmd == "CET") {
-                LOG_DEBUG("CET command intercepted");
-                
-                if (lua_gettop(L) >= 2) {
-                    string subcmd{ lua_tostring(L, 2) };
-                    
-                    if (subcmd == "ping") {
-                        lua_pushstring(L, "CET pong - DLL communication active");
-                        LOG_DEBUG("CET Ping -> Pong");
-                        return 1;
-                    }
-                    else if (subcmd == "version") {
-                        lua_pushstring(L, "CET v1.0.0 - Chat Event Trigger with Translation");
-                        return 1;
-                    }
-                    else if (subcmd == "status") {
-                        string status = "CET Status: DLL Active, Translator ";
-                        status += (g_translator && g_translator->IsInitialized()) ? "Ready" : "Not Ready";
-                        lua_pushstring(L, status);
-                        return 1;
-                    }
-                    else if (subcmd == "init_translator") {
-                        if (lua_gettop(L) >= 3) {
-                            string apiKey{ lua_tostring(L, 3) };
-                            
-                            if (g_translator && g_translator->Initialize(apiKey)) {
-                                lua_pushstring(L, "CET translator initialized successfully");
-                                LOG_INFO("Translator initialized with API key");
-                            } else {
-                                lua_pushstring(L, "CET init_translator error: initialization failed");
-                                LOG_ERROR("Translator initialization failed");
-                            }
-                            return 1;
-                        }
-                        lua_pushstring(L, "CET init_translator error: API key required");
-                        return 1;
-                    }
-                    else if (subcmd == "translate") {
-                        if (lua_gettop(L) >= 5) {
-                            string text{ lua_tostring(L, 3) };
-                            string fromLang{ lua_tostring(L, 4) };
-                            string toLang{ lua_tostring(L, 5) };
-                            
-                            if (!g_translator || !g_translator->IsInitialized()) {
-                                lua_pushstring(L, "CET translate error: translator not initialized");
-                                return 1;
-                            }
-                            
-                            if (text.empty()) {
-                                lua_pushstring(L, "CET translate error: empty text provided");
-                                return 1;
-                            }
-                            
-                            string result;
-                            TranslationResult translateResult = g_translator->TranslateText(text, fromLang, toLang, result);
-                            
-                            if (translateResult == TranslationResult::SUCCESS) {
-                                lua_pushstring(L, result);
-                                LOG_DEBUG("Translation successful: " + text + " -> " + result);
-                            } else {
-                                string error = "CET translate error: ";
-                                switch (translateResult) {
-                                    case TranslationResult::NETWORK_ERROR: error += "network error"; break;
-                                    case TranslationResult::API_ERROR: error += "API error"; break;
-                                    case TranslationResult::ENCODING_ERROR: error += "encoding error"; break;
-                                    case TranslationResult::TIMEOUT_ERROR: error += "timeout"; break;
-                                    case TranslationResult::INVALID_PARAMS: error += "invalid parameters"; break;
-                                    default: error += "unknown error"; break;
-                                }
-                                lua_pushstring(L, error);
-                                LOG_ERROR("Translation failed: " + error);
-                            }
-                            return 1;
-                        }
-                        lua_pushstring(L, "CET translate error: insufficient arguments (text, fromLang, toLang required)");
-                        return 1;
-                    }
-                    else {
-                        string error = "CET: Unknown command '" + subcmd + "'";
-                        lua_pushstring(L, error);
-                        return 1;
-                    }
-                } else {
-                    lua_pushstring(L, "CET: No subcommand specified");
-                    return 1;
-                }
-            }
+// Runtime tunables pushed from CETDefaults: key, value
+static int CmdConfig(void* L) {
+    if (lua_gettop(L) >= 4) {
+        string key{ lua_tostring(L, 3) };
+        string value{ lua_tostring(L, 4) };
+
+        if (ApplyConfigValue(key, value)) {
+            lua_pushstring(L, "CET config: " + key + " = " + value);
+            LOG_DEBUG("Config ", key, " = ", value);
+        } else {
+            lua_pushstring(L, "CET config error: unknown key '" + key + "'");
         }
-        
-        // Not our command - call original UnitXP if available
-        if (p_original_UnitXP) {
-            return p_original_UnitXP(L);
+        return 1;
+    }
+    lua_pushstring(L, "CET config error: key and value required");
+    return 1;
+}
+
+// Next finished ticket: ticket, success, translation or error text
+static int CmdPoll(void* L) {
+    CompletedJob job;
+    if (g_translationWorker && g_translationWorker->PollNext(job)) {
+        lua_pushnumber(L, static_cast<double>(job.ticket));
+        lua_pushboolean(L, job.status == TranslationResult::SUCCESS);
+        lua_pushstring(L, job.text);
+        return 3;
+    }
+    lua_pushnil(L);
+    return 1;
+}
+
+// State of a specific ticket: "pending", "done", "failed" or "unknown"
+static int CmdResult(void* L) {
+    if (lua_gettop(L) >= 3 && lua_isnumber(L, 3) && g_translationWorker) {
+        uint32_t ticket = static_cast<uint32_t>(lua_tonumber(L, 3));
+        CompletedJob job;
+        switch (g_translationWorker->TakeResult(ticket, job)) {
+            case TicketState::PENDING:
+                lua_pushstring(L, "pending");
+                return 1;
+            case TicketState::DONE:
+                lua_pushstring(L, "done");
+                lua_pushstring(L, job.text);
+                return 2;
+            case TicketState::FAILED:
+                lua_pushstring(L, "failed");
+                lua_pushstring(L, job.text);
+                return 2;
+            default:
+                break;
         }
-        
-        // Fallback - return 0 if no original function
-        return 0;
-        
-    } catch (const exception& e) {
-        string error = "CET Exception: " + string(e.what());
-        LOG_ERROR(error);
-        lua_pushstring(L, error);
+    }
+    lua_pushstring(L, "unknown");
+    return 1;
+}
+
+// Subcommand table; see CommandTable
+static constexpr CetCommand CET_COMMANDS[] = {
+    { "ping", CmdPing },
+    { "version", CmdVersion },
+    { "status", CmdStatus },
+    { "stats", CmdStats },
+    { "trace", CmdTrace },
+    { "init_translator", CmdInitTranslator },
+    { "translate", CmdTranslate },
+    { "translate_async", CmdTranslateAsync },
+    { "detect", CmdDetect },
+    { "config", CmdConfig },
+    { "poll", CmdPoll },
+    { "result", CmdResult },
+    { "shutdown", CmdShutdown },
+};
+
+static constexpr CommandTable<sizeof(CET_COMMANDS) / sizeof(CET_COMMANDS[0])> COMMAND_TABLE(CET_COMMANDS);
+static_assert(COMMAND_TABLE.IsValid(), "no collision-free seed for the CET command table");
+
+int HandleCetCommand(void* L) {
+    StartLogWriter();
+    LOG_DEBUG("CET command intercepted");
+
+    if (lua_gettop(L) < 2) {
+        lua_pushstring(L, "CET: No subcommand specified");
         return 1;
-    } catch (...) {
-        string error = "CET Unknown Exception";
-        LOG_ERROR(error);
+    }
+
+    string_view name = lua_tostring(L, 2);
+    const CetCommand* command = COMMAND_TABLE.Find(name);
+    if (!command) {
+        string error = "CET: Unknown command '";
+        error.append(name.data(), name.size());
+        error += "'";
         lua_pushstring(L, error);
         return 1;
     }
+
+    TraceSpan span(command->name.data());
+    return command->handler(L);
 }
 
 // Initialize the Lua interface by hooking UnitXP
@@ -250,7 +541,7 @@ bool InitializeLuaInterface() {
     // Hook the UnitXP function with our CET handler
     if (MH_CreateHook(reinterpret_cast<LPVOID>(p_UnitXP), 
                       reinterpret_cast<LPVOID>(detoured_UnitXP), 
-                      reinterpret_cast<LPVOID*>(&p_original_UnitXP)) != MH_OK) {
+                      reinterpret_cast<LPVOID*>(&g_originalUnitXP)) != MH_OK) {
         LOG_ERROR("Failed to create hook for UnitXP function");
         return false;
     }
@@ -272,6 +563,24 @@ bool InitializeLuaInterface() {
 }
 
 // Cleanup the Lua interface
+void ShutdownCET() {
+    LOG_INFO("Stopping CET background threads...");
+    if (g_translationWorker) {
+        g_translationWorker->Stop();
+    }
+    if (g_translator) {
+        g_translator->Shutdown();
+    }
+    StopMetricsDump();
+    LOG_INFO("CET background threads stopped");
+    StopLogWriter();
+    g_shutdown = true;
+}
+
+bool IsCETShutdown() {
+    return g_shutdown;
+}
+
 void CleanupLuaInterface() {
     if (!g_initialized) {
         return;
@@ -0,0 +1,120 @@
+// mapped_file.cpp - Read-only file mapping helper for CET
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include <string>
+
+#include "../include/mapped_file.h"
+
+using namespace std;
+
+#ifdef _WIN32
+MappedFile::MappedFile() : hFile(INVALID_HANDLE_VALUE), hMapping(nullptr), view(nullptr), length(0) {
+}
+#else
+MappedFile::MappedFile() : fd(-1), view(nullptr), length(0) {
+}
+#endif
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const string& path) {
+    Close();
+
+    // Writers may keep appending to the file while it is mapped
+    hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0 ||
+        static_cast<unsigned long long>(fileSize.QuadPart) > static_cast<size_t>(-1)) {
+        Close();
+        return false;
+    }
+
+    hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!hMapping) {
+        Close();
+        return false;
+    }
+
+    view = static_cast<const char*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+    if (!view) {
+        Close();
+        return false;
+    }
+
+    length = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::Close() {
+    if (view) {
+        UnmapViewOfFile(view);
+        view = nullptr;
+    }
+
+    if (hMapping) {
+        CloseHandle(hMapping);
+        hMapping = nullptr;
+    }
+
+    if (hFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(hFile);
+        hFile = INVALID_HANDLE_VALUE;
+    }
+
+    length = 0;
+}
+#else
+bool MappedFile::Open(const string& path) {
+    Close();
+
+    fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        Close();
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        Close();
+        return false;
+    }
+
+    view = static_cast<const char*>(mapping);
+    length = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void MappedFile::Close() {
+    if (view) {
+        munmap(const_cast<char*>(view), length);
+        view = nullptr;
+    }
+
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+
+    length = 0;
+}
+#endif
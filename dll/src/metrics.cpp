@@ -0,0 +1,259 @@
+// metrics.cpp - Per-thread counters and latency histograms for CET
+// Threads update their own shard; readers merge all shards on demand
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <ctime>
+
+#include "../include/metrics.h"
+#include "../include/logging.h"
+
+using namespace std;
+
+MetricsShard::MetricsShard() {
+    for (auto& counter : counters) counter.store(0, memory_order_relaxed);
+    for (auto& result : results) result.store(0, memory_order_relaxed);
+    for (auto& histogram : latency) {
+        for (auto& bucket : histogram) bucket.store(0, memory_order_relaxed);
+    }
+    for (auto& worst : latencyMax) worst.store(0, memory_order_relaxed);
+}
+
+MetricsSnapshot::MetricsSnapshot() : counters(), results(), latency(), latencyMax(), uptimeMs(0) {
+}
+
+// Shards of live threads, and the sums of threads that have exited
+struct MetricsRegistry {
+    mutex lock;
+    vector<MetricsShard*> shards;
+    MetricsSnapshot retired;
+    chrono::steady_clock::time_point started = chrono::steady_clock::now();
+};
+
+static MetricsRegistry& Registry() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+static void AddShard(MetricsSnapshot& total, const MetricsShard& shard) {
+    for (size_t i = 0; i < METRIC_COUNT; ++i) {
+        total.counters[i] += shard.counters[i].load(memory_order_relaxed);
+    }
+    for (size_t i = 0; i < RESULT_CODE_COUNT; ++i) {
+        total.results[i] += shard.results[i].load(memory_order_relaxed);
+    }
+    for (size_t m = 0; m < LATENCY_METRIC_COUNT; ++m) {
+        for (size_t b = 0; b < LATENCY_BUCKET_COUNT; ++b) {
+            total.latency[m][b] += shard.latency[m][b].load(memory_order_relaxed);
+        }
+        total.latencyMax[m] = max<uint64_t>(total.latencyMax[m], shard.latencyMax[m].load(memory_order_relaxed));
+    }
+}
+
+thread_local MetricsShard* t_metricsShard = nullptr;
+
+// Folds the thread's shard into the retired sums when the thread exits
+struct ShardOwner {
+    MetricsShard* shard = nullptr;
+
+    ~ShardOwner() {
+        if (!shard) {
+            return;
+        }
+        MetricsRegistry& registry = Registry();
+        lock_guard<mutex> lock(registry.lock);
+        AddShard(registry.retired, *shard);
+        registry.shards.erase(remove(registry.shards.begin(), registry.shards.end(), shard), registry.shards.end());
+        t_metricsShard = nullptr;
+        delete shard;
+    }
+};
+
+static thread_local ShardOwner t_shardOwner;
+
+MetricsShard& RegisterMetricsShard() {
+    MetricsShard* shard = new MetricsShard();
+    {
+        MetricsRegistry& registry = Registry();
+        lock_guard<mutex> lock(registry.lock);
+        registry.shards.push_back(shard);
+    }
+    t_shardOwner.shard = shard;
+    t_metricsShard = shard;
+    return *shard;
+}
+
+static size_t LatencyBucket(uint32_t milliseconds) {
+    if (milliseconds < 16) {
+        return milliseconds;
+    }
+    unsigned int octave = 4;
+    while (octave < 31 && (milliseconds >> (octave + 1)) != 0) {
+        ++octave;
+    }
+    if (octave >= 20) {
+        return LATENCY_BUCKET_COUNT - 1;
+    }
+    size_t sub = (milliseconds >> (octave - 3)) - 8;
+    return 16 + (octave - 4) * 8 + sub;
+}
+
+// Largest value that falls in bucket
+static uint32_t BucketUpperBound(size_t bucket) {
+    if (bucket < 16) {
+        return static_cast<uint32_t>(bucket);
+    }
+    size_t octave = 4 + (bucket - 16) / 8;
+    size_t sub = (bucket - 16) % 8;
+    return static_cast<uint32_t>(((9 + sub) << (octave - 3)) - 1);
+}
+
+void RecordResult(TranslationResult result) {
+    size_t index = static_cast<size_t>(result);
+    if (index >= RESULT_CODE_COUNT) {
+        return;
+    }
+    atomic<uint64_t>& counter = LocalMetrics().results[index];
+    counter.store(counter.load(memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+void RecordLatency(LatencyMetric metric, uint32_t milliseconds) {
+    MetricsShard& shard = LocalMetrics();
+    size_t index = static_cast<size_t>(metric);
+    atomic<uint64_t>& bucket = shard.latency[index][LatencyBucket(milliseconds)];
+    bucket.store(bucket.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    if (milliseconds > shard.latencyMax[index].load(memory_order_relaxed)) {
+        shard.latencyMax[index].store(milliseconds, memory_order_relaxed);
+    }
+}
+
+uint64_t MetricsSnapshot::LatencyCount(LatencyMetric metric) const {
+    uint64_t count = 0;
+    for (uint64_t bucket : latency[static_cast<size_t>(metric)]) {
+        count += bucket;
+    }
+    return count;
+}
+
+uint32_t MetricsSnapshot::LatencyPercentile(LatencyMetric metric, double percentile) const {
+    size_t index = static_cast<size_t>(metric);
+    uint64_t count = LatencyCount(metric);
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * (count - 1) + 0.5) + 1;
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT - 1; ++bucket) {
+        seen += latency[index][bucket];
+        if (seen >= rank) {
+            return static_cast<uint32_t>(min<uint64_t>(BucketUpperBound(bucket), latencyMax[index]));
+        }
+    }
+    return static_cast<uint32_t>(latencyMax[index]);
+}
+
+MetricsSnapshot GetMetrics() {
+    MetricsRegistry& registry = Registry();
+    lock_guard<mutex> lock(registry.lock);
+
+    MetricsSnapshot total = registry.retired;
+    for (const MetricsShard* shard : registry.shards) {
+        AddShard(total, *shard);
+    }
+    total.uptimeMs = static_cast<uint64_t>(
+        chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - registry.started).count());
+    return total;
+}
+
+static const char* const METRIC_NAMES[METRIC_COUNT] = {
+    "hook_calls", "cet_commands", "api_requests", "bytes_out", "bytes_in"
+};
+
+static const char* const RESULT_NAMES[RESULT_CODE_COUNT] = {
+    "result_success", "result_network_error", "result_api_error", "result_encoding_error",
+    "result_timeout", "result_invalid_params", "result_overloaded", "result_unavailable"
+};
+
+static const char* const LATENCY_NAMES[LATENCY_METRIC_COUNT] = { "e2e", "net" };
+
+void AppendStat(string& out, const char* key, uint64_t value) {
+    out += ' ';
+    out += key;
+    out += '=';
+    out += to_string(value);
+}
+
+void AppendMetrics(string& out, const MetricsSnapshot& metrics) {
+    AppendStat(out, "unix_time", static_cast<uint64_t>(time(nullptr)));
+    AppendStat(out, "uptime_ms", metrics.uptimeMs);
+    for (size_t i = 0; i < METRIC_COUNT; ++i) {
+        AppendStat(out, METRIC_NAMES[i], metrics.counters[i]);
+    }
+    for (size_t i = 0; i < RESULT_CODE_COUNT; ++i) {
+        AppendStat(out, RESULT_NAMES[i], metrics.results[i]);
+    }
+
+    static const double PERCENTILES[] = { 50, 90, 99 };
+    for (size_t m = 0; m < LATENCY_METRIC_COUNT; ++m) {
+        LatencyMetric metric = static_cast<LatencyMetric>(m);
+        string prefix = LATENCY_NAMES[m];
+        AppendStat(out, (prefix + "_count").c_str(), metrics.LatencyCount(metric));
+        for (double percentile : PERCENTILES) {
+            string key = prefix + "_p" + to_string(static_cast<int>(percentile));
+            AppendStat(out, key.c_str(), metrics.LatencyPercentile(metric, percentile));
+        }
+        AppendStat(out, (prefix + "_max").c_str(), metrics.latencyMax[m]);
+    }
+}
+
+// Periodic dump
+static mutex g_dumpMutex;
+static condition_variable g_dumpWakeup;
+// Allocated rather than a static std::thread: if the process exits with the
+// dump running, destroying a joinable thread would call terminate
+static thread* g_dumpThread = nullptr;
+static bool g_dumpStop = false;
+
+static void DumpLoop(string path, unsigned int intervalMs, function<string()> line) {
+    unique_lock<mutex> lock(g_dumpMutex);
+    while (!g_dumpWakeup.wait_for(lock, chrono::milliseconds(intervalMs), [] { return g_dumpStop; })) {
+        lock.unlock();
+        string text = line();
+        ofstream file(path, ios::app | ios::binary);
+        if (file) {
+            file << text << '\n';
+        }
+        lock.lock();
+    }
+}
+
+void SetMetricsDump(const string& path, unsigned int intervalMs, function<string()> line) {
+    StopMetricsDump();
+    if (intervalMs == 0) {
+        return;
+    }
+
+    g_dumpStop = false;
+    g_dumpThread = new thread(DumpLoop, path, intervalMs, move(line));
+    LOG_INFO("Writing stats to ", path, " every ", intervalMs, " ms");
+}
+
+void StopMetricsDump() {
+    {
+        lock_guard<mutex> lock(g_dumpMutex);
+        g_dumpStop = true;
+    }
+    g_dumpWakeup.notify_all();
+    if (g_dumpThread) {
+        g_dumpThread->join();
+        delete g_dumpThread;
+        g_dumpThread = nullptr;
+    }
+}
@@ -0,0 +1,192 @@
+// phrase_table.cpp - Offline phrase-table translations for CET
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
+#include <cctype>
+
+#include "../include/phrase_table.h"
+#include "../include/script_detect.h"
+#include "../include/logging.h"
+#include "../include/utils.h"
+
+using namespace std;
+
+static string_view Trim(string_view text) {
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == string_view::npos) {
+        return string_view();
+    }
+    size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+PhraseTable::PhraseTable() : matcher(true) {
+}
+
+bool PhraseTable::Load(const string& path) {
+    if (!file.Open(path)) {
+        return false;
+    }
+
+    string_view contents(file.Data(), file.Size());
+    if (contents.substr(0, 3) == "\xEF\xBB\xBF") {
+        contents.remove_prefix(3);
+    }
+
+    size_t skipped = 0;
+    while (!contents.empty()) {
+        size_t end = contents.find('\n');
+        string_view line = contents.substr(0, end);
+        contents.remove_prefix(end == string_view::npos ? contents.size() : end + 1);
+
+        line = Trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        size_t tab = line.find('\t');
+        string_view source = tab == string_view::npos ? string_view() : Trim(line.substr(0, tab));
+        string_view target = tab == string_view::npos ? string_view() : Trim(line.substr(tab + 1));
+        if (source.empty() || target.empty()) {
+            skipped++;
+            continue;
+        }
+
+        // The first entry for a source wins
+        if (matcher.Add(source) == targets.size()) {
+            targets.push_back(target);
+        }
+    }
+
+    if (skipped > 0) {
+        LOG_WARNING("Phrase table ", path, ": skipped ", skipped, " malformed line(s)");
+    }
+    if (targets.empty()) {
+        file.Close();
+        return false;
+    }
+
+    matcher.Build();
+    LOG_INFO("Loaded phrase table ", path, " with ", targets.size(), " phrase(s)");
+    return true;
+}
+
+bool PhraseTable::Translate(string_view text, string& result) const {
+    static thread_local vector<PatternMatch> matches;
+    matcher.FindLongest(text, matches, OnWordBoundary);
+    if (matches.empty()) {
+        return false;
+    }
+
+    result.clear();
+    size_t position = 0;
+    for (const PatternMatch& match : matches) {
+        string_view gap = text.substr(position, match.start - position);
+        if (DetectScript(gap).letters != 0) {
+            return false;
+        }
+        result.append(gap.data(), gap.size());
+        result.append(targets[match.pattern].data(), targets[match.pattern].size());
+        position = match.start + match.length;
+    }
+
+    string_view tail = text.substr(position);
+    if (DetectScript(tail).letters != 0) {
+        return false;
+    }
+    result.append(tail.data(), tail.size());
+    return true;
+}
+
+PhraseTableBackend::PhraseTableBackend(const string& tableDirectory)
+    : directory(tableDirectory), lookups(0), hits(0) {
+}
+
+string PhraseTableBackend::PairKey(string_view fromLang, string_view toLang) {
+    string key;
+    key.reserve(fromLang.size() + toLang.size() + 1);
+    key.append(fromLang.data(), fromLang.size());
+    key += '_';
+    key.append(toLang.data(), toLang.size());
+    return key;
+}
+
+const PhraseTable* PhraseTableBackend::Table(string_view fromLang, string_view toLang) {
+    string key = PairKey(fromLang, toLang);
+    {
+        shared_lock<shared_mutex> lock(tablesMutex);
+        auto it = tables.find(key);
+        if (it != tables.end()) {
+            return it->second.get();
+        }
+    }
+
+    unique_lock<shared_mutex> lock(tablesMutex);
+    auto it = tables.find(key);
+    if (it != tables.end()) {
+        return it->second.get();
+    }
+
+    // Language codes become part of a file name
+    bool valid = !fromLang.empty() && !toLang.empty();
+    for (char c : key) {
+        valid = valid && (isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_');
+    }
+
+    unique_ptr<PhraseTable> table;
+    if (valid) {
+        table = make_unique<PhraseTable>();
+        if (!table->Load(JoinPath(directory, "CET_phrases_" + key + ".tsv"))) {
+            table.reset();
+        }
+    }
+
+    // Entries are never removed, so the pointer stays valid for the backend's lifetime
+    const PhraseTable* result = table.get();
+    tables.emplace(move(key), move(table));
+    return result;
+}
+
+TranslationResult PhraseTableBackend::Translate(const vector<string>& texts, const vector<size_t>& queryIndex,
+                                                const string& fromLang, const string& toLang,
+                                                vector<string>& translations, vector<bool>& answered) {
+    const PhraseTable* table = Table(fromLang, toLang);
+    if (!table) {
+        return TranslationResult::SUCCESS;
+    }
+
+    for (size_t slot = 0; slot < queryIndex.size(); ++slot) {
+        lookups++;
+        if (table->Translate(texts[queryIndex[slot]], translations[slot])) {
+            answered[slot] = true;
+            hits++;
+        }
+    }
+    return TranslationResult::SUCCESS;
+}
+
+bool PhraseTableBackend::TryTranslate(string_view text, string_view fromLang, string_view toLang,
+                                      string& result) {
+    const PhraseTable* table = nullptr;
+    {
+        shared_lock<shared_mutex> lock(tablesMutex, try_to_lock);
+        if (!lock.owns_lock()) {
+            return false;
+        }
+        auto it = tables.find(PairKey(fromLang, toLang));
+        if (it == tables.end() || !it->second) {
+            return false;
+        }
+        table = it->second.get();
+    }
+
+    lookups++;
+    if (!table->Translate(text, result)) {
+        return false;
+    }
+    hits++;
+    return true;
+}
@@ -0,0 +1,132 @@
+// request_builder.cpp - Translate API request construction for CET
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cctype>
+
+#include "../include/request_builder.h"
+#include "../include/utf8_helper.h"
+#include "../include/simd.h"
+
+using namespace std;
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+static inline bool NeedsJsonEscape(unsigned char c) {
+    return c == '"' || c == '\\' || c < 0x20;
+}
+
+void AppendJsonEscaped(string& out, string_view text) {
+    const char* data = text.data();
+    size_t size = text.size();
+    size_t pos = 0;
+    size_t runStart = 0;
+
+    while (pos < size) {
+#ifdef CET_HAVE_SSE2
+        // Skip 16 bytes at a time while there is nothing to escape
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i control = _mm_set1_epi8(0x1F);
+        while (pos + 16 <= size) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            __m128i special = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control));
+            if (_mm_movemask_epi8(special) != 0) {
+                break;
+            }
+            pos += 16;
+        }
+#endif
+
+        size_t blockEnd = pos + 16 < size ? pos + 16 : size;
+        for (; pos < blockEnd; ++pos) {
+            unsigned char c = static_cast<unsigned char>(data[pos]);
+            if (!NeedsJsonEscape(c)) {
+                continue;
+            }
+
+            out.append(data + runStart, pos - runStart);
+            runStart = pos + 1;
+
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                case '\b': out += "\\b"; break;
+                case '\f': out += "\\f"; break;
+                default: {
+                    char escape[6] = { '\\', 'u', '0', '0', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 15] };
+                    out.append(escape, sizeof(escape));
+                    break;
+                }
+            }
+        }
+    }
+
+    out.append(data + runStart, size - runStart);
+}
+
+void AppendUrlEncoded(string& out, string_view text) {
+    for (char c : text) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if (isalnum(byte) || c == '-' || c == '_' || c == '.' || c == '~') {
+            out += c;
+        } else {
+            out += '%';
+            out += HEX_DIGITS[byte >> 4];
+            out += HEX_DIGITS[byte & 15];
+        }
+    }
+}
+
+TranslationRequestBuilder::TranslationRequestBuilder() {
+    body.reserve(INITIAL_CAPACITY);
+}
+
+const string& TranslationRequestBuilder::Build(const vector<string>& texts, const vector<size_t>& queryIndex,
+                                               size_t first, size_t count, string_view fromLang, string_view toLang) {
+    body.clear();
+    body += "{\"q\":";
+    if (count > 1) {
+        body += '[';
+    }
+
+    for (size_t slot = first; slot < first + count; ++slot) {
+        if (slot > first) {
+            body += ',';
+        }
+        body += '"';
+
+        // Chat text can carry stray bytes; the API rejects invalid UTF-8
+        const string& text = texts[queryIndex[slot]];
+        if (UTF8Helper::IsValid(text)) {
+            AppendJsonEscaped(body, text);
+        } else {
+            AppendJsonEscaped(body, UTF8Helper::Repair(text));
+        }
+        body += '"';
+    }
+
+    if (count > 1) {
+        body += ']';
+    }
+
+    body += ",\"source\":\"";
+    AppendJsonEscaped(body, fromLang);
+    body += "\",\"target\":\"";
+    AppendJsonEscaped(body, toLang);
+    body += "\",\"format\":\"text\"}";
+    return body;
+}
+
+string TranslationRequestBuilder::BuildPath(const string& endpointPath, const string& apiKey) {
+    string path = endpointPath;
+    path += "?key=";
+    AppendUrlEncoded(path, apiKey);
+    return path;
+}
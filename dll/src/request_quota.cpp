@@ -0,0 +1,90 @@
+// request_quota.cpp - Request and character quota for CET API calls
+
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+
+#include "../include/request_quota.h"
+
+using namespace std;
+
+TokenBucket::TokenBucket() : rate(0), burst(0), tokens(0), updated(chrono::steady_clock::now()) {
+}
+
+void TokenBucket::Configure(double ratePerSecond, double burstSize) {
+    rate = ratePerSecond;
+    burst = max<double>(burstSize, 1);
+    tokens = burst;
+    updated = chrono::steady_clock::now();
+}
+
+void TokenBucket::Refill(chrono::steady_clock::time_point now) {
+    if (now <= updated) {
+        return;
+    }
+    double elapsed = chrono::duration<double>(now - updated).count();
+    tokens = min<double>(burst, tokens + elapsed * rate);
+    updated = now;
+}
+
+double TokenBucket::Available(chrono::steady_clock::time_point now) {
+    if (!IsLimited()) {
+        return 1e18;
+    }
+    Refill(now);
+    return tokens;
+}
+
+chrono::steady_clock::time_point TokenBucket::ReadyAt(double amount, chrono::steady_clock::time_point now) {
+    if (!IsLimited()) {
+        return now;
+    }
+
+    Refill(now);
+    double needed = min<double>(amount, burst) - tokens;
+    if (needed <= 0) {
+        return now;
+    }
+    return now + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(needed / rate));
+}
+
+void TokenBucket::Consume(double amount, chrono::steady_clock::time_point now) {
+    if (!IsLimited()) {
+        return;
+    }
+    Refill(now);
+    tokens -= amount;
+}
+
+RequestQuota::RequestQuota() {
+    SetRequestQuota(DEFAULT_REQUESTS_PER_SECOND);
+    SetCharQuota(DEFAULT_CHARS_PER_SECOND);
+}
+
+// Short bursts are allowed: two seconds' worth of requests, five of characters
+void RequestQuota::SetRequestQuota(unsigned int requestsPerSecond) {
+    lock_guard<mutex> lock(quotaMutex);
+    requestBucket.Configure(requestsPerSecond, requestsPerSecond * 2.0);
+}
+
+void RequestQuota::SetCharQuota(unsigned int charsPerSecond) {
+    lock_guard<mutex> lock(quotaMutex);
+    charBucket.Configure(charsPerSecond, charsPerSecond * 5.0);
+}
+
+chrono::steady_clock::time_point RequestQuota::ReadyAt(size_t chars, chrono::steady_clock::time_point now) {
+    lock_guard<mutex> lock(quotaMutex);
+    return max<chrono::steady_clock::time_point>(requestBucket.ReadyAt(1, now),
+               charBucket.ReadyAt(static_cast<double>(chars), now));
+}
+
+double RequestQuota::CharsAvailable(chrono::steady_clock::time_point now) {
+    lock_guard<mutex> lock(quotaMutex);
+    return charBucket.Available(now);
+}
+
+void RequestQuota::Charge(size_t chars, chrono::steady_clock::time_point now) {
+    lock_guard<mutex> lock(quotaMutex);
+    requestBucket.Consume(1, now);
+    charBucket.Consume(static_cast<double>(chars), now);
+}
@@ -0,0 +1,120 @@
+// resilience.cpp - Retry, latency tracking and circuit breaking for CET requests
+
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+#include "../include/resilience.h"
+
+using namespace std;
+
+LatencyTracker::LatencyTracker(size_t capacity)
+    : samples(max<size_t>(1, capacity), 0), next(0), count(0) {
+}
+
+void LatencyTracker::Record(uint32_t milliseconds) {
+    samples[next] = milliseconds;
+    next = (next + 1) % samples.size();
+    count = min<size_t>(count + 1, samples.size());
+}
+
+uint32_t LatencyTracker::Percentile(double percentile) const {
+    if (count == 0) {
+        return 0;
+    }
+
+    // A copy of at most a few hundred samples, read a few times per request
+    vector<uint32_t> sorted(samples.begin(), samples.begin() + count);
+    size_t rank = static_cast<size_t>(percentile / 100.0 * (count - 1) + 0.5);
+    rank = min<size_t>(rank, count - 1);
+    nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+unsigned int RetryPolicy::BackoffMs(unsigned int retry) const {
+    static thread_local minstd_rand random(random_device{}());
+
+    unsigned int ceiling = maxDelayMs;
+    if (retry < 16 && (static_cast<unsigned long long>(baseDelayMs) << retry) < maxDelayMs) {
+        ceiling = baseDelayMs << retry;
+    }
+    return uniform_int_distribution<unsigned int>(0, ceiling)(random);
+}
+
+bool IsRetryableStatus(unsigned long httpStatus) {
+    return httpStatus == 429 || (httpStatus >= 500 && httpStatus < 600);
+}
+
+bool IsRejectedContentStatus(unsigned long httpStatus) {
+    return httpStatus == 400 || httpStatus == 413;
+}
+
+const char* BreakerStateToString(BreakerState state) {
+    switch (state) {
+        case BreakerState::Closed: return "closed";
+        case BreakerState::Open: return "open";
+        case BreakerState::HalfOpen: return "half-open";
+        default: return "unknown";
+    }
+}
+
+CircuitBreaker::CircuitBreaker()
+    : state(BreakerState::Closed), failures(0), failureThreshold(DEFAULT_FAILURE_THRESHOLD),
+      openMs(DEFAULT_OPEN_MS), probeInFlight(false), opens(0) {
+}
+
+void CircuitBreaker::SetFailureThreshold(unsigned int threshold) {
+    failureThreshold = threshold;
+    if (failureThreshold == 0) {
+        state = BreakerState::Closed;
+        failures = 0;
+        probeInFlight = false;
+    }
+}
+
+void CircuitBreaker::Trip(chrono::steady_clock::time_point now) {
+    state = BreakerState::Open;
+    openedAt = now;
+    probeInFlight = false;
+    opens++;
+}
+
+bool CircuitBreaker::Allow(chrono::steady_clock::time_point now) {
+    if (state == BreakerState::Open) {
+        if (now - openedAt < chrono::milliseconds(openMs)) {
+            return false;
+        }
+        state = BreakerState::HalfOpen;
+    }
+
+    if (state == BreakerState::HalfOpen) {
+        if (probeInFlight) {
+            return false;
+        }
+        probeInFlight = true;
+    }
+    return true;
+}
+
+void CircuitBreaker::RecordSuccess() {
+    state = BreakerState::Closed;
+    failures = 0;
+    probeInFlight = false;
+}
+
+void CircuitBreaker::RecordFailure(chrono::steady_clock::time_point now) {
+    if (failureThreshold == 0) {
+        return;
+    }
+
+    if (state == BreakerState::HalfOpen) {
+        Trip(now);
+        return;
+    }
+
+    failures++;
+    if (state == BreakerState::Closed && failures >= failureThreshold) {
+        Trip(now);
+    }
+}
@@ -0,0 +1,197 @@
+// scheduler.cpp - Priority scheduling and quota control for CET translations
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "../include/scheduler.h"
+#include "../include/utf8_helper.h"
+
+using namespace std;
+
+bool ParsePriority(string_view name, TranslationPriority& priority) {
+    if (name == "direct") priority = TranslationPriority::Direct;
+    else if (name == "group") priority = TranslationPriority::Group;
+    else if (name == "public") priority = TranslationPriority::Public;
+    else return false;
+    return true;
+}
+
+const char* PriorityToString(TranslationPriority priority) {
+    switch (priority) {
+        case TranslationPriority::Direct: return "direct";
+        case TranslationPriority::Group: return "group";
+        case TranslationPriority::Public: return "public";
+        default: return "unknown";
+    }
+}
+
+TranslationScheduler::TranslationScheduler(size_t maxQueuedJobs, RequestQuota& requestQuota)
+    : queued(0), maxQueued(max<size_t>(1, maxQueuedJobs)), quota(requestQuota) {
+    shedAfterMs[static_cast<size_t>(TranslationPriority::Direct)] = 0;
+    shedAfterMs[static_cast<size_t>(TranslationPriority::Group)] = DEFAULT_SHED_GROUP_MS;
+    shedAfterMs[static_cast<size_t>(TranslationPriority::Public)] = DEFAULT_SHED_PUBLIC_MS;
+}
+
+bool TranslationScheduler::Push(TranslationJob&& job, vector<TranslationJob>& shed) {
+    size_t level = static_cast<size_t>(job.priority);
+
+    if (queued >= maxQueued) {
+        // Make room by dropping the oldest job of the lowest class below this one
+        size_t victim = PRIORITY_COUNT;
+        for (size_t i = PRIORITY_COUNT; i-- > level + 1;) {
+            if (!queues[i].empty()) {
+                victim = i;
+                break;
+            }
+        }
+
+        if (victim == PRIORITY_COUNT) {
+            stats.classes[level].rejected++;
+            return false;
+        }
+
+        shed.push_back(move(queues[victim].front()));
+        queues[victim].pop_front();
+        stats.classes[victim].shed++;
+        queued--;
+    }
+
+    stats.classes[level].submitted++;
+    queues[level].push_back(move(job));
+    queued++;
+    return true;
+}
+
+void TranslationScheduler::Clear() {
+    for (deque<TranslationJob>& queue : queues) {
+        queue.clear();
+    }
+    queued = 0;
+}
+
+const TranslationJob& TranslationScheduler::Next() const {
+    for (const deque<TranslationJob>& queue : queues) {
+        if (!queue.empty()) {
+            return queue.front();
+        }
+    }
+    return queues[0].front();   // callers check Empty() first
+}
+
+void TranslationScheduler::ShedExpired(chrono::steady_clock::time_point now, vector<TranslationJob>& shed) {
+    for (size_t level = 0; level < PRIORITY_COUNT; ++level) {
+        if (shedAfterMs[level] == 0) {
+            continue;
+        }
+
+        // Queues are in arrival order, so expired jobs are at the front
+        auto deadline = chrono::milliseconds(shedAfterMs[level]);
+        deque<TranslationJob>& queue = queues[level];
+        while (!queue.empty() && now - queue.front().queuedAt > deadline) {
+            shed.push_back(move(queue.front()));
+            queue.pop_front();
+            stats.classes[level].shed++;
+            queued--;
+        }
+    }
+}
+
+chrono::steady_clock::time_point TranslationScheduler::QuotaReadyAt(chrono::steady_clock::time_point now) {
+    if (Empty()) {
+        return now;
+    }
+    return quota.ReadyAt(UTF8Helper::CodePointCount(Next().text), now);
+}
+
+bool TranslationScheduler::BatchReady(size_t maxItems, size_t maxBytes) const {
+    // The player's own messages and whispers never wait for company
+    const TranslationJob& first = Next();
+    if (first.priority == TranslationPriority::Direct) {
+        return true;
+    }
+
+    size_t items = 0;
+    size_t bytes = 0;
+    for (const deque<TranslationJob>& queue : queues) {
+        for (const TranslationJob& job : queue) {
+            if (job.fromLang != first.fromLang || job.toLang != first.toLang) {
+                continue;
+            }
+            items++;
+            bytes += job.text.size();
+            if (items >= maxItems || bytes >= maxBytes) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void TranslationScheduler::CollectBatch(vector<TranslationJob>& batch, size_t maxItems, size_t maxBytes,
+                                        chrono::steady_clock::time_point now) {
+    if (Empty()) {
+        return;
+    }
+
+    const string fromLang = Next().fromLang;
+    const string toLang = Next().toLang;
+
+    // Only fill the batch up to the characters the quota has left; the
+    // first job is always taken (QuotaReadyAt waited for it)
+    double available = quota.CharsAvailable(now);
+
+    size_t bytes = 0;
+    double chars = 0;
+    for (size_t level = 0; level < PRIORITY_COUNT; ++level) {
+        deque<TranslationJob>& queue = queues[level];
+        deque<TranslationJob> remaining;
+
+        for (TranslationJob& job : queue) {
+            bool samePair = job.fromLang == fromLang && job.toLang == toLang;
+            double jobChars = samePair ? static_cast<double>(UTF8Helper::CodePointCount(job.text)) : 0;
+            bool fits = batch.empty() ||
+                        (batch.size() < maxItems && bytes + job.text.size() <= maxBytes &&
+                         chars + jobChars <= available);
+
+            if (samePair && fits) {
+                uint64_t waitedMs = static_cast<uint64_t>(
+                    chrono::duration_cast<chrono::milliseconds>(now - job.queuedAt).count());
+                SchedulerClassStats& classStats = stats.classes[level];
+                classStats.dispatched++;
+                classStats.totalWaitMs += waitedMs;
+                classStats.maxWaitMs = max<uint64_t>(classStats.maxWaitMs, waitedMs);
+
+                bytes += job.text.size();
+                chars += jobChars;
+                batch.push_back(move(job));
+                queued--;
+            } else {
+                remaining.push_back(move(job));
+            }
+        }
+
+        queue.swap(remaining);
+    }
+
+    stats.requests++;
+}
+
+void TranslationScheduler::SetShedDeadline(TranslationPriority priority, unsigned int milliseconds) {
+    // Direct messages are always sent
+    if (priority != TranslationPriority::Direct) {
+        shedAfterMs[static_cast<size_t>(priority)] = milliseconds;
+    }
+}
+
+SchedulerStats TranslationScheduler::GetStats() const {
+    SchedulerStats result = stats;
+    for (size_t level = 0; level < PRIORITY_COUNT; ++level) {
+        result.classes[level].depth = queues[level].size();
+    }
+    return result;
+}
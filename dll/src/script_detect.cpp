@@ -0,0 +1,206 @@
+// script_detect.cpp - Unicode script detection for CET
+
+#include <string_view>
+#include <bitset>
+#include <cstdint>
+
+#include "../include/script_detect.h"
+#include "../include/simd.h"
+
+using namespace std;
+
+static Script ClassifyCodepoint(uint32_t cp) {
+    if ((cp >= 'A' && cp <= 'Z') || (cp >= 'a' && cp <= 'z')) return Script::Latin;
+    if (cp < 0xC0) return Script::Unknown;
+    if (cp <= 0x24F) return (cp == 0xD7 || cp == 0xF7) ? Script::Unknown : Script::Latin;
+    if (cp >= 0x370 && cp <= 0x3FF) return Script::Greek;
+    if (cp >= 0x400 && cp <= 0x52F) return Script::Cyrillic;
+    if (cp >= 0x590 && cp <= 0x5FF) return Script::Hebrew;
+    if ((cp >= 0x600 && cp <= 0x6FF) || (cp >= 0x750 && cp <= 0x77F)) return Script::Arabic;
+    if (cp >= 0xE00 && cp <= 0xE7F) return Script::Thai;
+    if (cp >= 0x1100 && cp <= 0x11FF) return Script::Hangul;
+    if (cp >= 0x1E00 && cp <= 0x1EFF) return Script::Latin;
+    if ((cp >= 0x3040 && cp <= 0x30FF) || (cp >= 0x31F0 && cp <= 0x31FF)) return Script::Kana;
+    if (cp >= 0x3130 && cp <= 0x318F) return Script::Hangul;
+    if ((cp >= 0x3400 && cp <= 0x4DBF) || (cp >= 0x4E00 && cp <= 0x9FFF)) return Script::Han;
+    if (cp >= 0xAC00 && cp <= 0xD7AF) return Script::Hangul;
+    if (cp >= 0xF900 && cp <= 0xFAFF) return Script::Han;
+    if ((cp >= 0xFF21 && cp <= 0xFF3A) || (cp >= 0xFF41 && cp <= 0xFF5A)) return Script::Latin;
+    if (cp >= 0xFF66 && cp <= 0xFF9F) return Script::Kana;
+    if (cp >= 0x20000 && cp <= 0x2FA1F) return Script::Han;
+    return Script::Unknown;
+}
+
+// Decode the code point at text[pos]; returns its length (1 for invalid bytes)
+static size_t DecodeUTF8(string_view text, size_t pos, uint32_t& cp) {
+    unsigned char lead = static_cast<unsigned char>(text[pos]);
+    size_t length;
+
+    if (lead < 0x80) {
+        cp = lead;
+        return 1;
+    } else if ((lead & 0xE0) == 0xC0) {
+        cp = lead & 0x1F;
+        length = 2;
+    } else if ((lead & 0xF0) == 0xE0) {
+        cp = lead & 0x0F;
+        length = 3;
+    } else if ((lead & 0xF8) == 0xF0) {
+        cp = lead & 0x07;
+        length = 4;
+    } else {
+        cp = 0xFFFD;
+        return 1;
+    }
+
+    if (pos + length > text.size()) {
+        cp = 0xFFFD;
+        return 1;
+    }
+
+    for (size_t i = 1; i < length; ++i) {
+        unsigned char next = static_cast<unsigned char>(text[pos + i]);
+        if ((next & 0xC0) != 0x80) {
+            cp = 0xFFFD;
+            return 1;
+        }
+        cp = (cp << 6) | (next & 0x3F);
+    }
+    return length;
+}
+
+// Skip a WoW escape sequence at text[pos] (which is '|'); returns the number
+// of bytes to skip, 0 if it is not an escape we ignore
+static size_t SkipEscape(string_view text, size_t pos) {
+    if (pos + 1 >= text.size()) {
+        return 0;
+    }
+
+    // The client takes color codes in either case, as PlaceholderMasker
+    // does; |H and |h differ by case (link start and end)
+    char next = text[pos + 1];
+    if ((next == 'c' || next == 'C') && pos + 10 <= text.size()) {
+        return 10;                              // |cAARRGGBB
+    }
+    if (next == 'r' || next == 'R') {
+        return 2;                               // |r
+    }
+    if (next == 'H') {
+        size_t end = text.find("|h", pos + 2);  // |Hitem:...|h, the link name stays
+        return end == string_view::npos ? text.size() - pos : end + 2 - pos;
+    }
+    if (next == 'h') {
+        return 2;
+    }
+    return 0;
+}
+
+// Count letters in text[pos, end) one code point at a time; returns the
+// position reached, which may run past end to finish a sequence
+static size_t CountScalar(string_view text, size_t pos, size_t end, size_t* weights) {
+    while (pos < end) {
+        if (text[pos] == '|') {
+            size_t skip = SkipEscape(text, pos);
+            if (skip > 0) {
+                pos += skip;
+                continue;
+            }
+        }
+
+        uint32_t cp;
+        size_t length = DecodeUTF8(text, pos, cp);
+        weights[static_cast<size_t>(ClassifyCodepoint(cp))] += length;
+        pos += length;
+    }
+    return pos;
+}
+
+ScriptDetection DetectScript(string_view text) {
+    size_t weights[static_cast<size_t>(Script::Count)] = {};
+    size_t pos = 0;
+
+#ifdef CET_HAVE_SSE2
+    const __m128i pipe = _mm_set1_epi8('|');
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    const __m128i beforeA = _mm_set1_epi8('a' - 1);
+    const __m128i afterZ = _mm_set1_epi8('z' + 1);
+
+    while (pos + 16 <= text.size()) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + pos));
+        int special = _mm_movemask_epi8(chunk) | _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pipe));
+
+        if (special != 0) {
+            // Multi-byte characters or escapes somewhere in this block
+            pos = CountScalar(text, pos, pos + 16, weights);
+            continue;
+        }
+
+        // All ASCII: a letter is anything in a-z once the case bit is set
+        __m128i folded = _mm_or_si128(chunk, caseBit);
+        __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(folded, beforeA), _mm_cmplt_epi8(folded, afterZ));
+        weights[static_cast<size_t>(Script::Latin)] += bitset<16>(static_cast<unsigned>(_mm_movemask_epi8(letters))).count();
+        pos += 16;
+    }
+#endif
+
+    CountScalar(text, pos, text.size(), weights);
+
+    ScriptDetection detection;
+    detection.script = Script::Unknown;
+    detection.confidence = 0.0;
+    detection.letters = 0;
+
+    size_t best = 0;
+    for (size_t script = static_cast<size_t>(Script::Latin); script < static_cast<size_t>(Script::Count); ++script) {
+        detection.letters += weights[script];
+        if (weights[script] > best) {
+            best = weights[script];
+            detection.script = static_cast<Script>(script);
+        }
+    }
+
+    if (detection.letters == 0) {
+        return detection;
+    }
+
+    // Japanese mixes kanji with kana; any real amount of kana decides it
+    size_t han = weights[static_cast<size_t>(Script::Han)];
+    size_t kana = weights[static_cast<size_t>(Script::Kana)];
+    if ((detection.script == Script::Han || detection.script == Script::Kana) && kana * 10 >= han + kana) {
+        detection.script = Script::Kana;
+        best = han + kana;
+    }
+
+    detection.confidence = static_cast<double>(best) / static_cast<double>(detection.letters);
+    return detection;
+}
+
+const char* ScriptLanguageCode(Script script) {
+    switch (script) {
+        case Script::Latin: return "en";
+        case Script::Cyrillic: return "ru";
+        case Script::Greek: return "el";
+        case Script::Han: return "zh";
+        case Script::Kana: return "ja";
+        case Script::Hangul: return "ko";
+        case Script::Thai: return "th";
+        case Script::Arabic: return "ar";
+        case Script::Hebrew: return "he";
+        default: return nullptr;
+    }
+}
+
+const char* ScriptToString(Script script) {
+    switch (script) {
+        case Script::Latin: return "latin";
+        case Script::Cyrillic: return "cyrillic";
+        case Script::Greek: return "greek";
+        case Script::Han: return "han";
+        case Script::Kana: return "kana";
+        case Script::Hangul: return "hangul";
+        case Script::Thai: return "thai";
+        case Script::Arabic: return "arabic";
+        case Script::Hebrew: return "hebrew";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,132 @@
+// segmenter.cpp - Sentence/clause splitting of chat messages for CET
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../include/segmenter.h"
+
+using namespace std;
+
+static inline bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline bool IsBoundary(char c) {
+    return c == '.' || c == '!' || c == '?' || c == ';' || c == ',';
+}
+
+// Length of a full-width CJK boundary at pos (。！？；，、), or 0
+static size_t CjkBoundaryLength(string_view text, size_t pos) {
+    static const char* const MARKS[] = {
+        "\xE3\x80\x82", "\xEF\xBC\x81", "\xEF\xBC\x9F", "\xEF\xBC\x9B", "\xEF\xBC\x8C", "\xE3\x80\x81"
+    };
+
+    if (pos + 3 > text.size()) {
+        return 0;
+    }
+
+    string_view candidate = text.substr(pos, 3);
+    for (const char* mark : MARKS) {
+        if (candidate == mark) {
+            return 3;
+        }
+    }
+    return 0;
+}
+
+static void AddSegment(string_view message, size_t start, size_t end, vector<TextSegment>& segments) {
+    while (start < end && IsSpace(message[start])) {
+        ++start;
+    }
+    while (end > start && IsSpace(message[end - 1])) {
+        --end;
+    }
+
+    if (end > start) {
+        segments.push_back({ start, end - start });
+    }
+}
+
+void SplitSegments(string_view message, vector<TextSegment>& segments) {
+    segments.clear();
+
+    size_t segmentStart = 0;
+    int bracketDepth = 0;
+    bool inLink = false;
+    size_t i = 0;
+
+    while (i < message.size()) {
+        char c = message[i];
+
+        // |H...|h[Name]|h is a link; never split inside it
+        if (c == '|' && i + 1 < message.size()) {
+            char next = message[i + 1];
+            if (next == 'H') {
+                inLink = true;
+            } else if (next == 'h' && inLink && i + 2 < message.size() && message[i + 2] != '[') {
+                inLink = false;
+            }
+            i += 2;
+            continue;
+        }
+
+        if (c == '[') {
+            ++bracketDepth;
+        } else if (c == ']' && bracketDepth > 0) {
+            --bracketDepth;
+        }
+
+        if (inLink || bracketDepth > 0) {
+            ++i;
+            continue;
+        }
+
+        if (c == '\n') {
+            AddSegment(message, segmentStart, i, segments);
+            segmentStart = ++i;
+            continue;
+        }
+
+        size_t cjkLength = CjkBoundaryLength(message, i);
+        if (cjkLength > 0) {
+            i += cjkLength;
+            AddSegment(message, segmentStart, i, segments);
+            segmentStart = i;
+            continue;
+        }
+
+        if (IsBoundary(c)) {
+            // Runs like "?!" or "..." belong to the same boundary
+            size_t end = i + 1;
+            while (end < message.size() && IsBoundary(message[end])) {
+                ++end;
+            }
+
+            if (end == message.size() || IsSpace(message[end])) {
+                AddSegment(message, segmentStart, end, segments);
+                segmentStart = end;
+            }
+            i = end;
+            continue;
+        }
+
+        ++i;
+    }
+
+    AddSegment(message, segmentStart, message.size(), segments);
+}
+
+void JoinSegments(string_view message, const vector<TextSegment>& segments,
+                  const vector<string>& translations, size_t firstTranslation, string& result) {
+    result.clear();
+    size_t position = 0;
+
+    for (size_t i = 0; i < segments.size() && firstTranslation + i < translations.size(); ++i) {
+        result.append(message.substr(position, segments[i].start - position));
+        result += translations[firstTranslation + i];
+        position = segments[i].start + segments[i].length;
+    }
+
+    result.append(message.substr(position));
+}
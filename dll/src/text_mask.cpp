@@ -0,0 +1,293 @@
+// text_mask.cpp - Placeholder masking of links, numbers and glossary terms for CET
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+
+#include "../include/text_mask.h"
+
+using namespace std;
+
+static const size_t MAX_PLACEHOLDER_DIGITS = 4;
+
+static inline bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline bool IsHexDigit(char c) {
+    return IsDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// Length of the escape sequence starting with '|' at pos that has to reach
+// the chat frame intact (color code or reset, link, texture), or 0
+static size_t MarkupLength(string_view text, size_t pos) {
+    char next = text[pos + 1];
+
+    if ((next == 'c' || next == 'C') && pos + 10 <= text.size()) {
+        for (size_t i = pos + 2; i < pos + 10; ++i) {
+            if (!IsHexDigit(text[i])) {
+                return 0;
+            }
+        }
+        return 10;
+    }
+    if (next == 'r' || next == 'R') {
+        return 2;
+    }
+
+    // |Hpayload|h[Name]|h, or |Hpayload|hName|h
+    if (next == 'H') {
+        size_t payloadEnd = text.find("|h", pos + 2);
+        if (payloadEnd == string_view::npos) {
+            return 0;
+        }
+        size_t nameEnd = payloadEnd + 2 < text.size() && text[payloadEnd + 2] == '['
+                             ? text.find("]|h", payloadEnd + 3)
+                             : text.find("|h", payloadEnd + 2);
+        if (nameEnd == string_view::npos) {
+            return 0;
+        }
+        return nameEnd + (text[nameEnd] == ']' ? 3 : 2) - pos;
+    }
+
+    // |Tpath:size|t
+    if (next == 'T') {
+        size_t end = text.find("|t", pos + 2);
+        return end == string_view::npos ? 0 : end + 2 - pos;
+    }
+    return 0;
+}
+
+// Length of a "{N}" placeholder at pos, spaces inside the braces allowed
+// since translation sometimes adds them, or 0
+static size_t PlaceholderLength(string_view text, size_t pos, size_t& index) {
+    size_t i = pos + 1;
+    while (i < text.size() && text[i] == ' ') {
+        ++i;
+    }
+
+    size_t digitsStart = i;
+    index = 0;
+    while (i < text.size() && IsDigit(text[i]) && i - digitsStart < MAX_PLACEHOLDER_DIGITS) {
+        index = index * 10 + (text[i] - '0');
+        ++i;
+    }
+    if (i == digitsStart) {
+        return 0;
+    }
+
+    while (i < text.size() && text[i] == ' ') {
+        ++i;
+    }
+    return i < text.size() && text[i] == '}' ? i + 1 - pos : 0;
+}
+
+// End of the number starting at pos: digits with single '.' or ',' between
+// them ("3.5", "12,000"), not reaching past limit
+static size_t NumberEnd(string_view text, size_t pos, size_t limit) {
+    size_t end = pos;
+    while (end < limit) {
+        if (IsDigit(text[end])) {
+            ++end;
+        } else if ((text[end] == '.' || text[end] == ',') && end + 1 < limit && IsDigit(text[end + 1])) {
+            end += 2;
+        } else {
+            break;
+        }
+    }
+    return end;
+}
+
+static void AppendPlaceholder(string& out, size_t index) {
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + index % 10);
+        index /= 10;
+    } while (index > 0);
+
+    out += '{';
+    while (count > 0) {
+        out += digits[--count];
+    }
+    out += '}';
+}
+
+PlaceholderMasker::PlaceholderMasker() : glossary(true), enabled(true) {
+}
+
+void PlaceholderMasker::RebuildLocked() {
+    glossary.Clear();
+    for (const string& term : terms) {
+        glossary.Add(term);
+    }
+    for (const string& name : names) {
+        glossary.Add(name);
+    }
+    glossary.Build();
+}
+
+void PlaceholderMasker::SetEnabled(bool enable) {
+    unique_lock<shared_mutex> lock(glossaryMutex);
+    enabled = enable;
+}
+
+void PlaceholderMasker::SetGlossaryTerms(const vector<string>& glossaryTerms) {
+    unique_lock<shared_mutex> lock(glossaryMutex);
+    terms = glossaryTerms;
+    RebuildLocked();
+}
+
+void PlaceholderMasker::SetNames(const vector<string>& playerNames) {
+    unique_lock<shared_mutex> lock(glossaryMutex);
+    names = playerNames;
+    RebuildLocked();
+}
+
+size_t PlaceholderMasker::GlossarySize() const {
+    shared_lock<shared_mutex> lock(glossaryMutex);
+    return glossary.PatternCount();
+}
+
+void PlaceholderMasker::Mask(string_view text, string& templ, vector<MaskSpan>& spans) const {
+    spans.clear();
+
+    shared_lock<shared_mutex> lock(glossaryMutex);
+    if (!enabled) {
+        templ.assign(text.data(), text.size());
+        return;
+    }
+
+    // Markup, and text that would be read back as a placeholder
+    for (size_t i = 0; i < text.size();) {
+        size_t length = 0;
+        size_t index;
+        if (text[i] == '|' && i + 1 < text.size()) {
+            if (text[i + 1] == '|') {
+                i += 2;     // escaped pipe
+                continue;
+            }
+            length = MarkupLength(text, i);
+        } else if (text[i] == '{') {
+            length = PlaceholderLength(text, i, index);
+        }
+
+        if (length > 0) {
+            spans.push_back(MaskSpan{ i, length });
+            i += length;
+        } else {
+            ++i;
+        }
+    }
+
+    // Glossary terms and names outside the markup
+    static thread_local vector<PatternMatch> matches;
+    glossary.FindLongest(text, matches, OnWordBoundary);
+    lock.unlock();
+
+    size_t markupCount = spans.size();
+    size_t markup = 0;
+    for (const PatternMatch& match : matches) {
+        while (markup < markupCount && spans[markup].start + spans[markup].length <= match.start) {
+            ++markup;
+        }
+        if (markup < markupCount && spans[markup].start < match.start + match.length) {
+            continue;
+        }
+        spans.push_back(MaskSpan{ match.start, match.length });
+    }
+
+    auto byStart = [](const MaskSpan& a, const MaskSpan& b) { return a.start < b.start; };
+    sort(spans.begin(), spans.end(), byStart);
+
+    // Numbers in what is left
+    size_t maskedCount = spans.size();
+    size_t position = 0;
+    for (size_t span = 0; span <= maskedCount; ++span) {
+        size_t gapEnd = span < maskedCount ? spans[span].start : text.size();
+        for (size_t i = position; i < gapEnd;) {
+            if (!IsDigit(text[i])) {
+                ++i;
+                continue;
+            }
+            size_t end = NumberEnd(text, i, gapEnd);
+            spans.push_back(MaskSpan{ i, end - i });
+            i = end;
+        }
+        if (span < maskedCount) {
+            position = spans[span].start + spans[span].length;
+        }
+    }
+
+    if (spans.empty()) {
+        templ.assign(text.data(), text.size());
+        return;
+    }
+
+    // A colored link is color code, link and reset in a row: one placeholder
+    sort(spans.begin(), spans.end(), byStart);
+    size_t merged = 0;
+    for (size_t span = 0; span < spans.size(); ++span) {
+        if (merged > 0 && spans[merged - 1].start + spans[merged - 1].length == spans[span].start) {
+            spans[merged - 1].length += spans[span].length;
+            continue;
+        }
+        spans[merged++] = spans[span];
+    }
+    spans.resize(merged);
+
+    templ.clear();
+    position = 0;
+    for (size_t span = 0; span < spans.size(); ++span) {
+        templ.append(text.data() + position, spans[span].start - position);
+        AppendPlaceholder(templ, span);
+        position = spans[span].start + spans[span].length;
+    }
+    templ.append(text.data() + position, text.size() - position);
+}
+
+void Unmask(string_view translated, string_view original, const vector<MaskSpan>& spans, string& result) {
+    if (spans.empty()) {
+        result.assign(translated.data(), translated.size());
+        return;
+    }
+
+    static thread_local vector<bool> restored;
+    restored.assign(spans.size(), false);
+    result.clear();
+
+    size_t position = 0;
+    while (position < translated.size()) {
+        size_t open = translated.find('{', position);
+        if (open == string_view::npos) {
+            break;
+        }
+
+        size_t index;
+        size_t length = PlaceholderLength(translated, open, index);
+        if (length == 0 || index >= spans.size()) {
+            result.append(translated.data() + position, open + 1 - position);
+            position = open + 1;
+            continue;
+        }
+
+        result.append(translated.data() + position, open - position);
+        result.append(original.data() + spans[index].start, spans[index].length);
+        restored[index] = true;
+        position = open + length;
+    }
+    result.append(translated.data() + position, translated.size() - position);
+
+    for (size_t index = 0; index < spans.size(); ++index) {
+        if (restored[index]) {
+            continue;
+        }
+        if (!result.empty() && result.back() != ' ') {
+            result += ' ';
+        }
+        result.append(original.data() + spans[index].start, spans[index].length);
+    }
+}
@@ -0,0 +1,164 @@
+// trace.cpp - Span ring buffer and Chrome trace-event export for CET
+// Writers claim slots with one atomic increment; the exporter skips slots
+// that are being rewritten
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <fstream>
+
+#include "../include/trace.h"
+#include "../include/logging.h"
+
+using namespace std;
+
+atomic<bool> g_traceEnabled{ false };
+thread_local uint64_t t_traceId = 0;
+
+static const size_t TRACE_CAPACITY = 1 << 16;  // spans kept; older ones are overwritten
+
+// A span slot. sequence is the slot's claim number plus one once the
+// fields are written and 0 while they are being written, so a reader that
+// sees the same nonzero sequence before and after copying has a whole span.
+struct TraceSlot {
+    atomic<uint64_t> sequence;
+    atomic<const char*> name;
+    atomic<uint64_t> traceId;
+    atomic<uint64_t> batchId;
+    atomic<uint64_t> start;
+    atomic<uint32_t> duration;
+    atomic<uint32_t> thread;
+};
+
+struct TraceRecord {
+    const char* name;
+    uint64_t traceId;
+    uint64_t batchId;
+    uint64_t start;
+    uint32_t duration;
+    uint32_t thread;
+};
+
+static mutex g_traceMutex;                      // guards allocation and clearing
+static unique_ptr<TraceSlot[]> g_traceSlots;
+static atomic<TraceSlot*> g_traceBuffer{ nullptr };
+static atomic<uint64_t> g_traceNext{ 0 };
+static atomic<uint64_t> g_nextTraceId{ 1 };
+static atomic<uint32_t> g_nextTraceThread{ 1 };
+static thread_local uint32_t t_traceThread = 0;
+static const chrono::steady_clock::time_point g_traceEpoch = chrono::steady_clock::now();
+
+static void ClearSlots() {
+    // Caller holds g_traceMutex
+    TraceSlot* slots = g_traceBuffer.load(memory_order_relaxed);
+    for (size_t i = 0; slots && i < TRACE_CAPACITY; ++i) {
+        slots[i].sequence.store(0, memory_order_relaxed);
+    }
+    g_traceNext.store(0, memory_order_relaxed);
+}
+
+void SetTracing(bool enabled) {
+    lock_guard<mutex> lock(g_traceMutex);
+    if (enabled && !g_traceSlots) {
+        g_traceSlots.reset(new TraceSlot[TRACE_CAPACITY]);
+        g_traceBuffer.store(g_traceSlots.get(), memory_order_release);
+    }
+    if (enabled && !g_traceEnabled.load(memory_order_relaxed)) {
+        // Each recording starts empty
+        ClearSlots();
+    }
+    g_traceEnabled.store(enabled, memory_order_relaxed);
+    LOG_INFO("Tracing ", enabled ? "enabled" : "disabled");
+}
+
+void ClearTrace() {
+    lock_guard<mutex> lock(g_traceMutex);
+    ClearSlots();
+}
+
+uint64_t TraceMicros(chrono::steady_clock::time_point when) {
+    long long micros = chrono::duration_cast<chrono::microseconds>(when - g_traceEpoch).count();
+    return static_cast<uint64_t>(max<long long>(micros, 0)) + 1;
+}
+
+uint64_t NewTraceId() {
+    return g_nextTraceId.fetch_add(1, memory_order_relaxed);
+}
+
+void RecordTraceSpan(const char* name, uint64_t traceId, uint64_t startMicros, uint64_t endMicros,
+                     uint64_t batchId) {
+    TraceSlot* slots = g_traceBuffer.load(memory_order_acquire);
+    if (!slots) {
+        return;
+    }
+    if (t_traceThread == 0) {
+        t_traceThread = g_nextTraceThread.fetch_add(1, memory_order_relaxed);
+    }
+
+    uint64_t claim = g_traceNext.fetch_add(1, memory_order_relaxed);
+    TraceSlot& slot = slots[claim % TRACE_CAPACITY];
+    slot.sequence.store(0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot.name.store(name, memory_order_relaxed);
+    slot.traceId.store(traceId, memory_order_relaxed);
+    slot.batchId.store(batchId, memory_order_relaxed);
+    slot.start.store(startMicros, memory_order_relaxed);
+    slot.duration.store(static_cast<uint32_t>(min<uint64_t>(endMicros > startMicros ? endMicros - startMicros : 0,
+                                                            UINT32_MAX)),
+                        memory_order_relaxed);
+    slot.thread.store(t_traceThread, memory_order_relaxed);
+    slot.sequence.store(claim + 1, memory_order_release);
+}
+
+bool ExportTrace(const string& path, size_t& events) {
+    events = 0;
+    vector<TraceRecord> records;
+    {
+        lock_guard<mutex> lock(g_traceMutex);
+        TraceSlot* slots = g_traceBuffer.load(memory_order_acquire);
+        for (size_t i = 0; slots && i < TRACE_CAPACITY; ++i) {
+            TraceSlot& slot = slots[i];
+            uint64_t before = slot.sequence.load(memory_order_acquire);
+            if (before == 0) {
+                continue;
+            }
+            TraceRecord record = { slot.name.load(memory_order_relaxed), slot.traceId.load(memory_order_relaxed),
+                                   slot.batchId.load(memory_order_relaxed), slot.start.load(memory_order_relaxed),
+                                   slot.duration.load(memory_order_relaxed), slot.thread.load(memory_order_relaxed) };
+            atomic_thread_fence(memory_order_acquire);
+            if (slot.sequence.load(memory_order_relaxed) == before) {
+                records.push_back(record);
+            }
+        }
+    }
+    sort(records.begin(), records.end(),
+         [](const TraceRecord& a, const TraceRecord& b) { return a.start < b.start; });
+
+    // Complete ("X") events; span names are identifiers and need no escaping
+    string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (size_t i = 0; i < records.size(); ++i) {
+        const TraceRecord& record = records[i];
+        json += i ? ",\n" : "\n";
+        json += "{\"name\":\"";
+        json += record.name;
+        json += "\",\"cat\":\"cet\",\"ph\":\"X\",\"pid\":1,\"tid\":" + to_string(record.thread) +
+                ",\"ts\":" + to_string(record.start) + ",\"dur\":" + to_string(record.duration) +
+                ",\"args\":{\"trace\":" + to_string(record.traceId);
+        if (record.batchId != 0) {
+            json += ",\"batch\":" + to_string(record.batchId);
+        }
+        json += "}}";
+    }
+    json += "\n]}\n";
+
+    ofstream file(path, ios::binary | ios::trunc);
+    if (!file || !file.write(json.data(), static_cast<streamsize>(json.size()))) {
+        LOG_ERROR("Cannot write trace to ", path);
+        return false;
+    }
+    events = records.size();
+    LOG_INFO("Wrote ", events, " trace spans to ", path);
+    return true;
+}
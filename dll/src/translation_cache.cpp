@@ -0,0 +1,435 @@
+// translation_cache.cpp - Byte-budgeted W-TinyLFU translation cache for CET
+
+#include <string>
+#include <list>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <algorithm>
+#include <iterator>
+
+#include "../include/translation_cache.h"
+
+using namespace std;
+
+// FrequencySketch
+
+FrequencySketch::FrequencySketch() : tableMask(0), sampleSize(0), additions(0) {
+    Resize(64);
+}
+
+void FrequencySketch::Resize(size_t expectedEntries) {
+    size_t entries = max<size_t>(expectedEntries, 64);
+    size_t words = 1;
+    while (words < entries) {
+        words <<= 1;
+    }
+
+    table.assign(words, 0);
+    tableMask = words - 1;
+    sampleSize = entries * 10;
+    additions = 0;
+}
+
+size_t FrequencySketch::CounterIndex(uint64_t hash, int row, unsigned& shift) const {
+    static const uint64_t SEEDS[4] = {
+        0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL
+    };
+
+    uint64_t h = (hash + SEEDS[row]) * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 32;
+    shift = static_cast<unsigned>((h >> 48) & 15) * 4;
+    return static_cast<size_t>(h & tableMask);
+}
+
+void FrequencySketch::Increment(uint64_t hash) {
+    bool added = false;
+
+    for (int row = 0; row < 4; ++row) {
+        unsigned shift;
+        size_t word = CounterIndex(hash, row, shift);
+        if (((table[word] >> shift) & 15) < 15) {
+            table[word] += 1ULL << shift;
+            added = true;
+        }
+    }
+
+    if (added && ++additions >= sampleSize) {
+        Age();
+    }
+}
+
+unsigned FrequencySketch::Frequency(uint64_t hash) const {
+    unsigned frequency = 15;
+
+    for (int row = 0; row < 4; ++row) {
+        unsigned shift;
+        size_t word = CounterIndex(hash, row, shift);
+        frequency = min<unsigned>(frequency, static_cast<unsigned>((table[word] >> shift) & 15));
+    }
+
+    return frequency;
+}
+
+void FrequencySketch::Age() {
+    // Halve every counter so the sketch tracks recent popularity
+    for (uint64_t& word : table) {
+        word = (word >> 1) & 0x7777777777777777ULL;
+    }
+    additions /= 2;
+}
+
+// TranslationCache
+
+TranslationCache::TranslationCache(size_t budgetBytes, uint32_t expirySeconds)
+    : maxBytes(0), windowBytes(0), probationBytes(0), protectedBytes(0),
+      wheel(WHEEL_SLOTS), origin(chrono::steady_clock::now()),
+      tickMs(1000), ttlTicks(0), lastTick(0), ttlSeconds(0) {
+    SetMaxBytes(budgetBytes);
+    SetExpiry(expirySeconds);
+}
+
+size_t TranslationCache::WindowBudget() const {
+    // 1% of the budget, with a floor so short bursts of new phrases survive
+    return max<size_t>(maxBytes / 100, min<size_t>(maxBytes / 4, 4096));
+}
+
+size_t TranslationCache::MainBudget() const {
+    return maxBytes - WindowBudget();
+}
+
+size_t TranslationCache::ProtectedBudget() const {
+    return MainBudget() / 5 * 4;
+}
+
+TranslationCache::NodeList& TranslationCache::ListFor(Segment segment) {
+    switch (segment) {
+        case Segment::Window: return window;
+        case Segment::Probation: return probation;
+        default: return protectedSegment;
+    }
+}
+
+size_t& TranslationCache::BytesFor(Segment segment) {
+    switch (segment) {
+        case Segment::Window: return windowBytes;
+        case Segment::Probation: return probationBytes;
+        default: return protectedBytes;
+    }
+}
+
+uint64_t TranslationCache::NowTick() const {
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - origin);
+    return static_cast<uint64_t>(elapsed.count()) / tickMs;
+}
+
+void TranslationCache::Schedule(Node& node) {
+    if (node.scheduled) {
+        wheel[node.expireTick % WHEEL_SLOTS].erase(node.wheelPos);
+        node.scheduled = false;
+    }
+
+    if (ttlTicks == 0) {
+        return;
+    }
+
+    node.expireTick = NowTick() + ttlTicks;
+    list<Node*>& slot = wheel[node.expireTick % WHEEL_SLOTS];
+    node.wheelPos = slot.insert(slot.end(), &node);
+    node.scheduled = true;
+}
+
+void TranslationCache::Advance() {
+    if (ttlTicks == 0) {
+        return;
+    }
+
+    uint64_t now = NowTick();
+    if (now <= lastTick) {
+        return;
+    }
+
+    // Visit each slot whose tick has passed; after a long idle period one
+    // full revolution covers every slot
+    uint64_t steps = min<uint64_t>(now - lastTick, static_cast<uint64_t>(WHEEL_SLOTS));
+    for (uint64_t tick = now - steps + 1; tick <= now; ++tick) {
+        list<Node*>& slot = wheel[tick % WHEEL_SLOTS];
+        for (auto it = slot.begin(); it != slot.end();) {
+            Node* node = *it;
+            ++it;
+            if (node->expireTick <= now) {
+                Erase(index.find(node->key)->second);
+                stats.expirations++;
+            }
+        }
+    }
+
+    lastTick = now;
+}
+
+void TranslationCache::Erase(NodeList::iterator it) {
+    if (it->scheduled) {
+        wheel[it->expireTick % WHEEL_SLOTS].erase(it->wheelPos);
+    }
+
+    BytesFor(it->segment) -= it->charge;
+    index.erase(it->key);
+    ListFor(it->segment).erase(it);
+}
+
+void TranslationCache::MoveTo(NodeList::iterator it, Segment segment) {
+    BytesFor(it->segment) -= it->charge;
+    ListFor(segment).splice(ListFor(segment).begin(), ListFor(it->segment), it);
+    it->segment = segment;
+    BytesFor(segment) += it->charge;
+}
+
+void TranslationCache::Touch(NodeList::iterator it) {
+    switch (it->segment) {
+        case Segment::Window:
+            window.splice(window.begin(), window, it);
+            break;
+        case Segment::Probation:
+            // A second hit promotes the entry out of probation
+            MoveTo(it, Segment::Protected);
+            TrimProtected();
+            break;
+        case Segment::Protected:
+            protectedSegment.splice(protectedSegment.begin(), protectedSegment, it);
+            break;
+    }
+}
+
+void TranslationCache::TrimProtected() {
+    // Demote the least recently used protected entries back to probation
+    while (protectedBytes > ProtectedBudget() && !protectedSegment.empty()) {
+        MoveTo(prev(protectedSegment.end()), Segment::Probation);
+    }
+}
+
+void TranslationCache::TrimMain() {
+    while (probationBytes + protectedBytes > MainBudget()) {
+        NodeList& victims = !probation.empty() ? probation : protectedSegment;
+        if (victims.empty()) {
+            break;
+        }
+        Erase(prev(victims.end()));
+        stats.evictions++;
+    }
+}
+
+void TranslationCache::EvictFromWindow() {
+    while (windowBytes > WindowBudget() && !window.empty()) {
+        NodeList::iterator candidate = prev(window.end());
+
+        if (probationBytes + protectedBytes + candidate->charge <= MainBudget()) {
+            MoveTo(candidate, Segment::Probation);
+            continue;
+        }
+
+        // Main cache is full: the candidate only gets in if it has been seen
+        // more often than the entry it would displace
+        NodeList& victims = !probation.empty() ? probation : protectedSegment;
+        bool admit = !victims.empty() &&
+                     sketch.Frequency(candidate->key.hashLow) > sketch.Frequency(prev(victims.end())->key.hashLow);
+
+        if (!admit) {
+            Erase(candidate);
+            stats.evictions++;
+            stats.rejections++;
+            continue;
+        }
+
+        MoveTo(candidate, Segment::Probation);
+        TrimMain();
+    }
+}
+
+const TranslationCache::Node* TranslationCache::Access(const CacheKey& key) {
+    Advance();
+    sketch.Increment(key.hashLow);
+
+    auto found = index.find(key);
+    if (found == index.end()) {
+        stats.misses++;
+        return nullptr;
+    }
+
+    NodeList::iterator it = found->second;
+    if (it->scheduled && it->expireTick <= NowTick()) {
+        Erase(it);
+        stats.expirations++;
+        stats.misses++;
+        return nullptr;
+    }
+
+    stats.hits++;
+    Touch(it);
+    return &*it;
+}
+
+bool TranslationCache::Get(const CacheKey& key, string& value) {
+    const Node* node = Access(key);
+    if (!node) {
+        return false;
+    }
+    value = node->value;
+    return true;
+}
+
+bool TranslationCache::Peek(const CacheKey& key, string& value) const {
+    // Expired entries are left for Advance or the next Get to remove
+    auto found = index.find(key);
+    if (found == index.end()) {
+        return false;
+    }
+    NodeList::iterator it = found->second;
+    if (it->scheduled && it->expireTick <= NowTick()) {
+        return false;
+    }
+    value = it->value;
+    return true;
+}
+
+void TranslationCache::Record(const CacheKey& key) {
+    Access(key);
+}
+
+bool TranslationCache::Contains(const CacheKey& key) {
+    Advance();
+    return index.find(key) != index.end();
+}
+
+void TranslationCache::Put(const CacheKey& key, const string& value) {
+    // Frequency is only recorded on Get: callers always look a key up before
+    // inserting it, so counting the insert too would double-count one-offs
+    Advance();
+
+    size_t charge = value.size() + ENTRY_OVERHEAD;
+
+    auto found = index.find(key);
+    if (found != index.end()) {
+        NodeList::iterator it = found->second;
+        BytesFor(it->segment) += charge;
+        BytesFor(it->segment) -= it->charge;
+        it->value = value;
+        it->charge = charge;
+        Schedule(*it);
+        Touch(it);
+        TrimMain();
+        EvictFromWindow();
+        return;
+    }
+
+    if (charge > MainBudget()) {
+        stats.rejections++;
+        return;
+    }
+
+    window.push_front(Node());
+    Node& node = window.front();
+    node.key = key;
+    node.value = value;
+    node.charge = charge;
+    node.expireTick = 0;
+    node.segment = Segment::Window;
+    node.scheduled = false;
+
+    index.emplace(node.key, window.begin());
+    windowBytes += charge;
+    Schedule(node);
+    stats.insertions++;
+
+    EvictFromWindow();
+}
+
+void TranslationCache::Clear() {
+    window.clear();
+    probation.clear();
+    protectedSegment.clear();
+    index.clear();
+    for (list<Node*>& slot : wheel) {
+        slot.clear();
+    }
+    windowBytes = 0;
+    probationBytes = 0;
+    protectedBytes = 0;
+}
+
+void TranslationCache::SetMaxBytes(size_t budgetBytes) {
+    maxBytes = max<size_t>(budgetBytes, 16 * 1024);
+
+    // Size the sketch for the number of entries the budget can hold
+    sketch.Resize(maxBytes / 128);
+
+    TrimProtected();
+    TrimMain();
+    EvictFromWindow();
+}
+
+void TranslationCache::SetExpiry(uint32_t expirySeconds) {
+    ttlSeconds = expirySeconds;
+
+    uint64_t ttlMs = static_cast<uint64_t>(expirySeconds) * 1000;
+    tickMs = max<uint64_t>(1000, (ttlMs + WHEEL_SLOTS - 1) / WHEEL_SLOTS);
+    ttlTicks = ttlMs == 0 ? 0 : (ttlMs + tickMs - 1) / tickMs;
+
+    RebuildWheel();
+}
+
+void TranslationCache::RebuildWheel() {
+    // Entries get a fresh TTL under the new tick length
+    for (list<Node*>& slot : wheel) {
+        slot.clear();
+    }
+    origin = chrono::steady_clock::now();
+    lastTick = 0;
+
+    for (NodeList* segment : { &window, &probation, &protectedSegment }) {
+        for (Node& node : *segment) {
+            node.scheduled = false;
+            Schedule(node);
+        }
+    }
+}
+
+// NegativeCache
+
+NegativeCache::NegativeCache(size_t maxEntries) : capacity(max<size_t>(1, maxEntries)) {
+}
+
+void NegativeCache::Add(const CacheKey& key, chrono::steady_clock::duration ttl, TranslationResult status) {
+    auto expires = chrono::steady_clock::now() + ttl;
+    entries[key] = Entry{ expires, status };
+    order.emplace_back(key, expires);
+
+    // Queue entries whose key was re-added later are stale; only the
+    // newest one removes the key
+    while (order.size() > capacity) {
+        auto it = entries.find(order.front().first);
+        if (it != entries.end() && it->second.expires == order.front().second) {
+            entries.erase(it);
+        }
+        order.pop_front();
+    }
+}
+
+bool NegativeCache::Lookup(const CacheKey& key, TranslationResult& status) {
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        return false;
+    }
+
+    if (chrono::steady_clock::now() >= it->second.expires) {
+        entries.erase(it);
+        return false;
+    }
+    status = it->second.status;
+    return true;
+}
+
+void NegativeCache::Clear() {
+    entries.clear();
+    order.clear();
+}
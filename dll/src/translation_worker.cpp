@@ -0,0 +1,335 @@
+// translation_worker.cpp - Background translation worker for CET
+// Keeps WinHTTP round trips off the game's main thread
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "../include/translation_worker.h"
+#include "../include/logging.h"
+#include "../include/metrics.h"
+#include "../include/trace.h"
+
+using namespace std;
+
+// Global worker instance
+unique_ptr<TranslationWorker> g_translationWorker = nullptr;
+
+static uint32_t ElapsedMs(chrono::steady_clock::time_point since, chrono::steady_clock::time_point now) {
+    return static_cast<uint32_t>(max<long long>(0, chrono::duration_cast<chrono::milliseconds>(now - since).count()));
+}
+
+TranslationWorker::TranslationWorker(TranslationClient& translationClient)
+    : client(translationClient), scheduler(MAX_PENDING, translationClient.Quota()), nextTicket(1), running(false), stopRequested(false),
+      batchWindowMs(50), batchMaxItems(16), batchMaxBytes(4096) {
+}
+
+TranslationWorker::~TranslationWorker() {
+    Stop();
+}
+
+bool TranslationWorker::Start() {
+    lock_guard<mutex> lock(queueMutex);
+
+    if (running) {
+        return true;
+    }
+
+    // The thread is started lazily from a Lua call rather than from DllMain,
+    // so it never has to be created while the loader lock is held.
+    try {
+        stopRequested = false;
+        workerThread = std::thread(&TranslationWorker::Run, this);
+        running = true;
+        LOG_INFO("Translation worker started");
+    } catch (const exception& e) {
+        LOG_ERROR("Failed to start translation worker: ", e.what());
+        return false;
+    }
+
+    return true;
+}
+
+void TranslationWorker::Stop() {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        if (!running) {
+            return;
+        }
+        stopRequested = true;
+    }
+
+    wakeup.notify_all();
+    if (workerThread.joinable()) {
+        workerThread.join();
+    }
+
+    lock_guard<mutex> lock(queueMutex);
+    scheduler.Clear();
+    outstanding.clear();
+    completed.clear();
+    completedOrder.clear();
+    running = false;
+    LOG_INFO("Translation worker stopped");
+}
+
+uint32_t TranslationWorker::Submit(string_view text, string_view fromLang, string_view toLang,
+                                   TranslationPriority priority) {
+    if (!Start()) {
+        return 0;
+    }
+
+    uint32_t ticket;
+    {
+        lock_guard<mutex> lock(queueMutex);
+
+        ticket = nextTicket++;
+        if (nextTicket == 0) {
+            nextTicket = 1; // 0 is reserved for "no ticket"
+        }
+
+        TranslationJob job;
+        job.ticket = ticket;
+        job.text = text;
+        job.fromLang = fromLang;
+        job.toLang = toLang;
+        job.priority = priority;
+        job.queuedAt = chrono::steady_clock::now();
+        job.traceId = t_traceId;
+
+        vector<TranslationJob> shed;
+        if (!scheduler.Push(move(job), shed)) {
+            LOG_WARNING("Translation queue full, rejecting ", PriorityToString(priority), " request");
+            return 0;
+        }
+        outstanding.insert(ticket);
+        StoreShed(shed);
+    }
+
+    wakeup.notify_one();
+    return ticket;
+}
+
+bool TranslationWorker::PollNext(CompletedJob& job) {
+    lock_guard<mutex> lock(queueMutex);
+
+    while (!completedOrder.empty()) {
+        uint32_t ticket = completedOrder.front();
+        completedOrder.pop_front();
+
+        // Tickets already collected through TakeResult are skipped
+        auto it = completed.find(ticket);
+        if (it != completed.end()) {
+            job = move(it->second);
+            completed.erase(it);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+TicketState TranslationWorker::TakeResult(uint32_t ticket, CompletedJob& job) {
+    lock_guard<mutex> lock(queueMutex);
+
+    auto it = completed.find(ticket);
+    if (it != completed.end()) {
+        job = move(it->second);
+        completed.erase(it);
+        return job.status == TranslationResult::SUCCESS ? TicketState::DONE : TicketState::FAILED;
+    }
+
+    if (outstanding.count(ticket)) {
+        return TicketState::PENDING;
+    }
+
+    return TicketState::UNKNOWN;
+}
+
+size_t TranslationWorker::PendingCount() {
+    lock_guard<mutex> lock(queueMutex);
+    return outstanding.size();
+}
+
+void TranslationWorker::SetBatchWindow(unsigned int windowMs) {
+    lock_guard<mutex> lock(queueMutex);
+    batchWindowMs = windowMs;
+}
+
+void TranslationWorker::SetBatchMaxItems(size_t maxItems) {
+    lock_guard<mutex> lock(queueMutex);
+    batchMaxItems = maxItems == 0 ? 1 : (maxItems > MAX_BATCH_ITEMS ? MAX_BATCH_ITEMS : maxItems);
+}
+
+void TranslationWorker::SetBatchMaxBytes(size_t maxBytes) {
+    lock_guard<mutex> lock(queueMutex);
+    batchMaxBytes = max<size_t>(1, maxBytes);
+}
+
+void TranslationWorker::SetRequestQuota(unsigned int requestsPerSecond) {
+    client.Quota().SetRequestQuota(requestsPerSecond);
+}
+
+void TranslationWorker::SetCharQuota(unsigned int charsPerSecond) {
+    client.Quota().SetCharQuota(charsPerSecond);
+}
+
+void TranslationWorker::SetShedDeadline(TranslationPriority priority, unsigned int milliseconds) {
+    lock_guard<mutex> lock(queueMutex);
+    scheduler.SetShedDeadline(priority, milliseconds);
+}
+
+SchedulerStats TranslationWorker::GetSchedulerStats() {
+    lock_guard<mutex> lock(queueMutex);
+    return scheduler.GetStats();
+}
+
+void TranslationWorker::ProcessBatch(vector<TranslationJob>& batch) {
+    // The batch's request is traced under its first job's ID; every job's
+    // wait in the queue and its whole life are traced under its own
+    uint64_t dispatched = TraceEnabled() ? TraceNowMicros() : 0;
+    TraceIdScope trace(batch[0].traceId);
+    if (dispatched) {
+        for (const TranslationJob& job : batch) {
+            RecordTraceSpan("queue", job.traceId, TraceMicros(job.queuedAt), dispatched, batch[0].traceId);
+        }
+    }
+
+    vector<string> texts;
+    texts.reserve(batch.size());
+    for (const TranslationJob& job : batch) {
+        texts.push_back(job.text);
+    }
+
+    // Each job gets its own message's outcome; one bad text in the batch
+    // does not fail the others
+    vector<string> results;
+    vector<TranslationResult> statuses;
+    TranslationResult status;
+    try {
+        status = client.TranslateBatch(texts, batch[0].fromLang, batch[0].toLang, results, statuses);
+    } catch (const exception& e) {
+        LOG_ERROR("Translation worker exception: ", e.what());
+        status = TranslationResult::API_ERROR;
+        statuses.assign(batch.size(), status);
+    } catch (...) {
+        LOG_ERROR("Translation worker unknown exception");
+        status = TranslationResult::API_ERROR;
+        statuses.assign(batch.size(), status);
+    }
+
+    if (batch.size() > 1) {
+        LOG_DEBUG("Translated batch of ", batch.size(), " messages: ", TranslationResultToString(status));
+    }
+
+    auto now = chrono::steady_clock::now();
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const TranslationJob& job = batch[i];
+        RecordResult(statuses[i]);
+        RecordLatency(LatencyMetric::EndToEnd, ElapsedMs(job.queuedAt, now));
+        if (dispatched) {
+            RecordTraceSpan("translate_job", job.traceId, TraceMicros(job.queuedAt), TraceMicros(now),
+                            batch[0].traceId);
+        }
+    }
+
+    lock_guard<mutex> lock(queueMutex);
+    for (size_t i = 0; i < batch.size(); ++i) {
+        CompletedJob done;
+        done.ticket = batch[i].ticket;
+        done.status = statuses[i];
+        if (done.status == TranslationResult::SUCCESS) {
+            done.text = move(results[i]);
+        } else {
+            done.text = TranslationErrorReply(done.status);
+        }
+        StoreCompleted(move(done));
+    }
+}
+
+void TranslationWorker::StoreCompleted(CompletedJob&& job) {
+    // Caller holds the mutex
+    outstanding.erase(job.ticket);
+
+    // Bound memory if the addon stops collecting results
+    while (completed.size() >= MAX_COMPLETED && !completedOrder.empty()) {
+        completed.erase(completedOrder.front());
+        completedOrder.pop_front();
+    }
+
+    completedOrder.push_back(job.ticket);
+    completed[job.ticket] = move(job);
+}
+
+void TranslationWorker::StoreShed(vector<TranslationJob>& shed) {
+    // Caller holds the mutex
+    auto now = chrono::steady_clock::now();
+    for (TranslationJob& job : shed) {
+        RecordResult(TranslationResult::OVERLOADED);
+        RecordLatency(LatencyMetric::EndToEnd, ElapsedMs(job.queuedAt, now));
+
+        CompletedJob done;
+        done.ticket = job.ticket;
+        done.status = TranslationResult::OVERLOADED;
+        done.text = TranslationErrorReply(done.status);
+        StoreCompleted(move(done));
+    }
+
+    if (!shed.empty()) {
+        LOG_DEBUG("Shed ", shed.size(), " queued translation(s)");
+    }
+    shed.clear();
+}
+
+void TranslationWorker::Run() {
+    LOG_DEBUG("Translation worker thread running");
+
+    vector<TranslationJob> shed;
+
+    while (true) {
+        vector<TranslationJob> batch;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            wakeup.wait(lock, [this] { return stopRequested || !scheduler.Empty(); });
+
+            // Hold the next job for up to the batch window so that other
+            // misses for the same language pair can share its request
+            auto deadline = scheduler.Empty() ? chrono::steady_clock::now()
+                : scheduler.Next().queuedAt + chrono::milliseconds(batchWindowMs);
+            wakeup.wait_until(lock, deadline, [this] {
+                return stopRequested || scheduler.Empty() || scheduler.BatchReady(batchMaxItems, batchMaxBytes);
+            });
+
+            if (stopRequested) {
+                break;
+            }
+
+            auto now = chrono::steady_clock::now();
+            scheduler.ShedExpired(now, shed);
+            StoreShed(shed);
+            if (scheduler.Empty()) {
+                continue;
+            }
+
+            // Out of quota: wait, then start over, since a more urgent job
+            // may have arrived or queued jobs may have gone stale meanwhile
+            auto readyAt = scheduler.QuotaReadyAt(now);
+            if (readyAt > now) {
+                scheduler.CountThrottled();
+                wakeup.wait_until(lock, readyAt, [this] { return stopRequested; });
+                continue;
+            }
+
+            scheduler.CollectBatch(batch, batchMaxItems, batchMaxBytes, now);
+        }
+
+        ProcessBatch(batch);
+    }
+
+    LOG_DEBUG("Translation worker thread exiting");
+}
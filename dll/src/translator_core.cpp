@@ -1,166 +1,31 @@
 // translator_core.cpp - Translation functionality for CET
-// Integrated Google Translate API client
+// Caches and backends in front of the Google Translate API
 
-#include <windows.h>
-#include <winhttp.h>
 #include <string>
 #include <algorithm>
-#include <sstream>
-#include <iomanip>
 #include <codecvt>
 #include <locale>
 #include <vector>
 #include <cstdio>
 
 #include "../include/translator_core.h"
+#include "../include/cache_store.h"
+#include "../include/phrase_table.h"
+#include "../include/text_mask.h"
+#include "../include/segmenter.h"
+#include "../include/script_detect.h"
 #include "../include/logging.h"
+#include "../include/trace.h"
 #include "../include/utils.h"
 
 using namespace std;
 
-// Simple JSON parser for Google Translate API responses
-class SimpleJsonParser {
-public:
-    static string extractTranslatedText(const string& json) {
-        // Look for "translatedText" key
-        string searchKey = "\"translatedText\"";
-        size_t keyPos = json.find(searchKey);
-        if (keyPos == string::npos) {
-            return "";
-        }
-        
-        // Find the colon after the key
-        size_t colonPos = json.find(":", keyPos + searchKey.length());
-        if (colonPos == string::npos) {
-            return "";
-        }
-        
-        // Skip whitespace after colon and find the opening quote
-        size_t start = colonPos + 1;
-        while (start < json.length() && (json[start] == ' ' || json[start] == '\t' || json[start] == '\n' || json[start] == '\r')) {
-            start++;
-        }
-        
-        if (start >= json.length() || json[start] != '"') {
-            return "";
-        }
-        
-        start++; // Skip the opening quote
-        size_t end = json.find("\"", start);
-        if (end == string::npos) {
-            return "";
-        }
-        
-        string result = json.substr(start, end - start);
-        
-        // Unescape basic JSON characters and Unicode sequences
-        size_t pos = 0;
-        while ((pos = result.find("\\\"", pos)) != string::npos) {
-            result.replace(pos, 2, "\"");
-            pos += 1;
-        }
-        pos = 0;
-        while ((pos = result.find("\\\\", pos)) != string::npos) {
-            result.replace(pos, 2, "\\");
-            pos += 1;
-        }
-        
-        // Handle Unicode escape sequences \uXXXX
-        pos = 0;
-        while ((pos = result.find("\\u", pos)) != string::npos) {
-            if (pos + 5 < result.length()) {
-                string hexStr = result.substr(pos + 2, 4);
-                try {
-                    unsigned int codepoint = stoul(hexStr, nullptr, 16);
-                    string utf8_char = ConvertCodepointToUTF8(codepoint);
-                    result.replace(pos, 6, utf8_char);
-                    pos += utf8_char.length();
-                } catch (...) {
-                    pos += 6; // Skip invalid unicode sequence
-                }
-            } else {
-                break;
-            }
-        }
-        
-        return result;
-    }
-    
-private:
-    static string ConvertCodepointToUTF8(unsigned int codepoint) {
-        string result;
-        
-        if (codepoint <= 0x7F) {
-            // 1-byte sequence
-            result += static_cast<char>(codepoint);
-        } else if (codepoint <= 0x7FF) {
-            // 2-byte sequence
-            result += static_cast<char>(0xC0 | (codepoint >> 6));
-            result += static_cast<char>(0x80 | (codepoint & 0x3F));
-        } else if (codepoint <= 0xFFFF) {
-            // 3-byte sequence
-            result += static_cast<char>(0xE0 | (codepoint >> 12));
-            result += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
-            result += static_cast<char>(0x80 | (codepoint & 0x3F));
-        } else if (codepoint <= 0x10FFFF) {
-            // 4-byte sequence
-            result += static_cast<char>(0xF0 | (codepoint >> 18));
-            result += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
-            result += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
-            result += static_cast<char>(0x80 | (codepoint & 0x3F));
-        }
-        
-        return result;
-    }
-};
-
-// UTF-8 helper class
-class UTF8Helper {
-public:
-    static string FixUTF8String(const string& input) {
-        if (IsValidUTF8(input)) {
-            return input;
-        }
-        
-        // Basic fix for common encoding issues
-        string result = input;
-        return result;
-    }
-    
-private:
-    static bool IsValidUTF8(const string& str) {
-        size_t i = 0;
-        while (i < str.length()) {
-            unsigned char c = str[i];
-            if (c < 0x80) {
-                i++;
-            } else if ((c >> 5) == 0x06) {
-                if (++i >= str.length() || (str[i] & 0xC0) != 0x80) return false;
-                i++;
-            } else if ((c >> 4) == 0x0E) {
-                if (++i >= str.length() || (str[i] & 0xC0) != 0x80) return false;
-                if (++i >= str.length() || (str[i] & 0xC0) != 0x80) return false;
-                i++;
-            } else if ((c >> 3) == 0x1E) {
-                if (++i >= str.length() || (str[i] & 0xC0) != 0x80) return false;
-                if (++i >= str.length() || (str[i] & 0xC0) != 0x80) return false;
-                if (++i >= str.length() || (str[i] & 0xC0) != 0x80) return false;
-                i++;
-            } else {
-                return false;
-            }
-        }
-        return true;
-    }
-};
-
 // Global variables
 unique_ptr<TranslationClient> g_translator = nullptr;
-char g_translation_buffer[4096] = {0};
-char g_error_buffer[256] = {0};
 
 TranslationClient::TranslationClient() 
-    : hSession(nullptr), hConnect(nullptr), initialized(false) {
+    : cache(DEFAULT_CACHE_BYTES, DEFAULT_CACHE_EXPIRY_SECONDS), negativeCache(NEGATIVE_CACHE_ENTRIES), initialized(false),
+      diskCacheBytes(DEFAULT_DISK_CACHE_BYTES), phraseTables(true) {
 }
 
 TranslationClient::~TranslationClient() {
@@ -168,37 +33,30 @@ TranslationClient::~TranslationClient() {
 }
 
 bool TranslationClient::Initialize(const string& key) {
+    unique_lock<shared_mutex> lock(clientLock);
+    
     if (initialized) {
-        Cleanup();
+        CleanupLocked();
     }
     
-    apiKey = key;
-    
-    LOG_INFO("Initializing translation client with API key");
-    
-    // Initialize WinHTTP
-    hSession = WinHttpOpen(L"CET Translator/1.0",
-                          WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
-                          WINHTTP_NO_PROXY_NAME,
-                          WINHTTP_NO_PROXY_BYPASS,
-                          0);
-    
-    if (!hSession) {
-        LOG_ERROR("Failed to initialize WinHTTP session");
-        return false;
+    if (key.empty()) {
+        LOG_INFO("Initializing translation client without an API key, phrase tables only");
+    } else {
+        LOG_INFO("Initializing translation client with API key");
+        if (!remote.Open(key)) {
+            return false;
+        }
     }
     
-    // Connect to Google Translate API
-    hConnect = WinHttpConnect(hSession,
-                             L"translation.googleapis.com",
-                             INTERNET_DEFAULT_HTTPS_PORT,
-                             0);
+    // Phrase tables are loaded when their language pair is first used
+    if (phraseTables) {
+        localBackends.push_back(make_unique<PhraseTableBackend>(GetDllDirectoryPath()));
+    }
     
-    if (!hConnect) {
-        LOG_ERROR("Failed to connect to Google Translate API");
-        WinHttpCloseHandle(hSession);
-        hSession = nullptr;
-        return false;
+    // Yesterday's translations; the file is mapped and indexed in the background
+    if (diskCacheBytes > 0) {
+        diskCache = make_unique<CacheStore>();
+        diskCache->Open(JoinPath(GetDllDirectoryPath(), "CET_cache.bin"), diskCacheBytes);
     }
     
     initialized = true;
@@ -207,183 +65,695 @@ bool TranslationClient::Initialize(const string& key) {
 }
 
 void TranslationClient::Cleanup() {
-    if (hConnect) {
-        WinHttpCloseHandle(hConnect);
-        hConnect = nullptr;
+    unique_lock<shared_mutex> lock(clientLock);
+    CleanupLocked();
+}
+
+void TranslationClient::Shutdown() {
+    unique_lock<shared_mutex> lock(clientLock);
+    remote.Close();
+    localBackends.clear();
+    
+    // Waits for the loader thread if the file is still being indexed
+    if (diskCache) {
+        diskCache->Close();
+        diskCache.reset();
     }
+    initialized = false;
+    LOG_INFO("Translation client shut down");
+}
+
+void TranslationClient::CleanupLocked() {
+    remote.Close();
+    localBackends.clear();
     
-    if (hSession) {
-        WinHttpCloseHandle(hSession);
-        hSession = nullptr;
+    if (diskCache) {
+        diskCache->Close();
+        diskCache.reset();
     }
     
-    cache.clear();
+    {
+        lock_guard<mutex> cacheLock(cacheMutex);
+        cache.Clear();
+        negativeCache.Clear();
+    }
     initialized = false;
     LOG_INFO("Translation client cleanup complete");
 }
 
-string TranslationClient::UrlEncode(const string& text) {
-    ostringstream encoded;
-    encoded.fill('0');
-    encoded << hex;
-    
-    for (char c : text) {
-        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
-            encoded << c;
-        } else {
-            encoded << uppercase;
-            encoded << '%' << setw(2) << static_cast<unsigned char>(c);
-            encoded << nouppercase;
-        }
-    }
-    
-    return encoded.str();
+void TranslationClient::SetEndpoint(const string& url) {
+    unique_lock<shared_mutex> lock(clientLock);
+    remote.SetEndpoint(url);
 }
 
-string TranslationClient::GenerateCacheKey(const string& text, const string& fromLang, const string& toLang) {
-    return fromLang + "->" + toLang + ":" + text;
+void TranslationClient::SetConnectionPoolSize(size_t size) {
+    unique_lock<shared_mutex> lock(clientLock);
+    remote.SetConnectionPoolSize(size);
 }
 
-void TranslationClient::CleanExpiredCache() {
-    DWORD currentTime = GetTickCount();
-    auto it = cache.begin();
-    
-    while (it != cache.end()) {
-        if (currentTime - it->second.timestamp > CACHE_EXPIRY_MS) {
-            it = cache.erase(it);
-        } else {
-            ++it;
-        }
+void TranslationClient::SetKeepAliveInterval(uint32_t intervalMs) {
+    unique_lock<shared_mutex> lock(clientLock);
+    remote.SetKeepAliveInterval(intervalMs);
+}
+
+void TranslationClient::SetCacheExpiry(uint32_t seconds) {
+    lock_guard<mutex> lock(cacheMutex);
+    cache.SetExpiry(seconds);
+}
+
+void TranslationClient::SetCacheBudget(size_t bytes) {
+    lock_guard<mutex> lock(cacheMutex);
+    cache.SetMaxBytes(bytes);
+}
+
+void TranslationClient::SetDiskCacheBudget(size_t bytes) {
+    unique_lock<shared_mutex> lock(clientLock);
+    diskCacheBytes = bytes;
+    
+    // Takes effect on the next Initialize, except that the limit of an
+    // open file is adjusted right away
+    if (diskCache && bytes > 0) {
+        diskCache->SetMaxBytes(bytes);
     }
-    
-    // Limit cache size
-    if (cache.size() > MAX_CACHE_SIZE) {
-        // Remove oldest entries (simple approach - remove first MAX_CACHE_SIZE/2 entries)
-        size_t removeCount = cache.size() - MAX_CACHE_SIZE / 2;
-        for (size_t i = 0; i < removeCount && !cache.empty(); ++i) {
-            cache.erase(cache.begin());
-        }
+}
+
+void TranslationClient::SetRequestTimeout(uint32_t timeoutMs) {
+    unique_lock<shared_mutex> lock(clientLock);
+    remote.SetRequestTimeout(timeoutMs);
+}
+
+void TranslationClient::SetRetryAttempts(unsigned int attempts) {
+    unique_lock<shared_mutex> lock(clientLock);
+    remote.SetRetryAttempts(attempts);
+}
+
+void TranslationClient::SetHedging(bool enabled) {
+    unique_lock<shared_mutex> lock(clientLock);
+    remote.SetHedging(enabled);
+}
+
+void TranslationClient::SetBreakerThreshold(unsigned int failures) {
+    // The breaker has its own lock and can change under requests in progress
+    remote.SetBreakerThreshold(failures);
+}
+
+void TranslationClient::SetBreakerOpenTime(unsigned int openMs) {
+    remote.SetBreakerOpenTime(openMs);
+}
+
+void TranslationClient::SetPhraseTables(bool enabled) {
+    // Takes effect on the next Initialize
+    unique_lock<shared_mutex> lock(clientLock);
+    phraseTables = enabled;
+}
+
+void TranslationClient::SetMasking(bool enabled) {
+    masker.SetEnabled(enabled);
+}
+
+void TranslationClient::SetGlossaryTerms(const vector<string>& terms) {
+    masker.SetGlossaryTerms(terms);
+    LOG_DEBUG("Glossary set to ", terms.size(), " terms");
+}
+
+void TranslationClient::SetGlossaryNames(const vector<string>& names) {
+    masker.SetNames(names);
+}
+
+// Segments of a message as separate strings; a message without translatable
+// text yields none
+static void ExtractSegments(const string& text, vector<TextSegment>& segments, vector<string>& units) {
+    SplitSegments(text, segments);
+    for (const TextSegment& segment : segments) {
+        units.push_back(text.substr(segment.start, segment.length));
     }
 }
 
-string TranslationClient::HttpsRequest(const string& host, const string& path, const string& postData) {
-    if (!hConnect) {
-        return "";
+// Working storage for LookupCached. It runs on the game thread for every
+// incoming message, so the vectors (and the strings in them) are kept and
+// reused instead of being allocated per call.
+struct LookupScratch {
+    vector<TextSegment> segments;
+    vector<string> templates;
+    vector<vector<MaskSpan>> spans;
+    string unmasked;
+    vector<CacheKey> keys;
+    vector<string> translations;
+    vector<size_t> missing;
+    vector<size_t> fromDisk;
+};
+
+bool TranslationClient::LookupCached(string_view text, string_view fromLang,
+                                     string_view toLang, string& result) {
+    if (!initialized || text.empty()) {
+        return false;
     }
-    
-    // Convert strings to wide strings
-    wstring wPath(path.begin(), path.end());
-    
-    // Open request
-    HINTERNET hRequest = WinHttpOpenRequest(hConnect,
-                                           L"POST",
-                                           wPath.c_str(),
-                                           nullptr,
-                                           WINHTTP_NO_REFERER,
-                                           WINHTTP_DEFAULT_ACCEPT_TYPES,
-                                           WINHTTP_FLAG_SECURE);
-    
-    if (!hRequest) {
-        LOG_ERROR("Failed to open HTTP request");
-        return "";
+    TraceSpan span("LookupCached");
+    
+    static thread_local LookupScratch scratch;
+    vector<TextSegment>& segments = scratch.segments;
+    vector<string>& templates = scratch.templates;
+    vector<vector<MaskSpan>>& spans = scratch.spans;
+    vector<CacheKey>& keys = scratch.keys;
+    vector<string>& translations = scratch.translations;
+    vector<size_t>& missing = scratch.missing;
+    vector<size_t>& fromDisk = scratch.fromDisk;
+    
+    SplitSegments(text, segments);
+    if (segments.empty()) {
+        return false;
     }
     
-    // Set headers
-    wstring headers = L"Content-Type: application/json\r\n";
-    WinHttpAddRequestHeaders(hRequest, headers.c_str(), (DWORD)-1, WINHTTP_ADDREQ_FLAG_ADD);
-    
-    // Send request
-    BOOL result = WinHttpSendRequest(hRequest,
-                                    WINHTTP_NO_ADDITIONAL_HEADERS, 0,
-                                    (LPVOID)postData.c_str(), postData.length(),
-                                    postData.length(), 0);
+    keys.clear();
+    missing.clear();
+    fromDisk.clear();
+    if (translations.size() < segments.size()) {
+        translations.resize(segments.size());
+        templates.resize(segments.size());
+        spans.resize(segments.size());
+    }
+    for (size_t i = 0; i < segments.size(); ++i) {
+        masker.Mask(text.substr(segments[i].start, segments[i].length), templates[i], spans[i]);
+    }
+    // Peeked, not counted: a message left for the worker is looked up
+    // there again, and counting both would count it twice in the stats and
+    // the admission sketch. The lookups are counted below once the message
+    // is answered here.
+    size_t negativeHits = 0;
+    {
+        lock_guard<mutex> lock(cacheMutex);
+        for (size_t i = 0; i < segments.size(); ++i) {
+            const string& segment = templates[i];
+            keys.push_back(MakeCacheKey(segment, fromLang, toLang));
+            if (cache.Peek(keys[i], translations[i])) {
+                continue;
+            }
+            
+            // Segments the worker would not send either stay as they are; a
+            // remembered failure is left for the worker to report
+            TranslationResult negative = TranslationResult::SUCCESS;
+            if (negativeCache.Lookup(keys[i], negative)) {
+                if (negative != TranslationResult::SUCCESS) {
+                    return false;
+                }
+                translations[i] = segment;
+                negativeHits++;
+                continue;
+            }
+            if (DetectScript(segment).letters == 0) {
+                translations[i] = segment;
+                negativeHits++;
+                continue;
+            }
+            missing.push_back(i);
+        }
+    }
     
-    string response;
-    if (result && WinHttpReceiveResponse(hRequest, nullptr)) {
-        DWORD bytesAvailable = 0;
-        char buffer[8192];
+    size_t localHits = 0;
+    if (!missing.empty()) {
+        // Called from the game thread: never wait on the disk cache, a phrase
+        // table being loaded or an Initialize/Cleanup in progress
+        shared_lock<shared_mutex> lock(clientLock, try_to_lock);
+        if (!lock.owns_lock()) {
+            return false;
+        }
         
-        while (WinHttpQueryDataAvailable(hRequest, &bytesAvailable) && bytesAvailable > 0) {
-            DWORD bytesRead = 0;
-            DWORD bytesToRead = min(bytesAvailable, sizeof(buffer) - 1);
+        for (size_t i : missing) {
+            if (diskCache && diskCache->TryLookup(SerializeCacheKey(keys[i]), translations[i])) {
+                fromDisk.push_back(i);
+                continue;
+            }
             
-            if (WinHttpReadData(hRequest, buffer, bytesToRead, &bytesRead)) {
-                buffer[bytesRead] = '\0';
-                response += string(buffer, bytesRead);
-            } else {
-                break;
+            bool answered = false;
+            for (const unique_ptr<TranslationBackend>& backend : localBackends) {
+                if (backend->TryTranslate(templates[i], fromLang, toLang, translations[i])) {
+                    answered = true;
+                    break;
+                }
+            }
+            if (!answered) {
+                return false;
             }
+            localHits++;
+        }
+    }
+    
+    // Misses are counted when the worker translates the message
+    {
+        lock_guard<mutex> lock(cacheMutex);
+        for (const CacheKey& key : keys) {
+            cache.Record(key);
+        }
+        // Phrase table answers are cheap to repeat and stay out of the cache
+        for (size_t i : fromDisk) {
+            cache.Put(keys[i], translations[i]);
+        }
+        memoryStats.localHits += localHits;
+        memoryStats.negativeHits += negativeHits;
+        memoryStats.messages++;
+        memoryStats.messageHits++;
+        memoryStats.segments += segments.size();
+        memoryStats.segmentHits += segments.size();
+    }
+    
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (!spans[i].empty()) {
+            Unmask(translations[i], text.substr(segments[i].start, segments[i].length), spans[i], scratch.unmasked);
+            translations[i].swap(scratch.unmasked);
         }
     }
     
-    WinHttpCloseHandle(hRequest);
-    return response;
+    JoinSegments(text, segments, translations, 0, result);
+    return true;
 }
 
-string TranslationClient::ParseTranslationResponse(const string& jsonResponse) {
-    return SimpleJsonParser::extractTranslatedText(jsonResponse);
+TranslationResult TranslationClient::TranslateText(string_view text, string_view fromLang, 
+                                                  string_view toLang, string& result) {
+    TraceSpan span("TranslateText");
+    vector<string> texts(1, string(text));
+    vector<string> results;
+    vector<TranslationResult> statuses;
+    
+    TranslationResult status = TranslateBatch(texts, string(fromLang), string(toLang), results, statuses);
+    if (status == TranslationResult::SUCCESS) {
+        result = results[0];
+    }
+    return status;
 }
 
-TranslationResult TranslationClient::TranslateText(const string& text, const string& fromLang, 
-                                                  const string& toLang, string& result) {
+TranslationResult TranslationClient::TranslateBatch(const vector<string>& texts, const string& fromLang,
+                                                   const string& toLang, vector<string>& results,
+                                                   vector<TranslationResult>& statuses) {
+    TraceSpan span("TranslateBatch");
+    shared_lock<shared_mutex> lock(clientLock);
+    results.assign(texts.size(), string());
+    statuses.assign(texts.size(), TranslationResult::INVALID_PARAMS);
+    
     if (!initialized) {
         LOG_ERROR("Translation client not initialized");
         return TranslationResult::INVALID_PARAMS;
     }
     
-    if (text.empty() || fromLang.empty() || toLang.empty()) {
+    if (texts.empty() || fromLang.empty() || toLang.empty()) {
         LOG_ERROR("Invalid translation parameters: empty text or language codes");
         return TranslationResult::INVALID_PARAMS;
     }
     
-    // Check cache first
-    string cacheKey = GenerateCacheKey(text, fromLang, toLang);
-    auto cacheIt = cache.find(cacheKey);
-    if (cacheIt != cache.end() && (GetTickCount() - cacheIt->second.timestamp) < CACHE_EXPIRY_MS) {
-        result = cacheIt->second.translation;
-        LOG_DEBUG("Translation cache hit for: " + text);
-        return TranslationResult::SUCCESS;
+    for (const string& text : texts) {
+        if (text.empty()) {
+            LOG_ERROR("Invalid translation parameters: empty text or language codes");
+            return TranslationResult::INVALID_PARAMS;
+        }
     }
     
-    // Clean expired cache entries periodically
-    CleanExpiredCache();
-    
-    // Build request
-    string encodedText = UrlEncode(text);
-    string requestBody = "{"
-        "\"q\":\"" + text + "\","
-        "\"source\":\"" + fromLang + "\","
-        "\"target\":\"" + toLang + "\","
-        "\"format\":\"text\""
-        "}";
-    
-    string path = "/language/translate/v2?key=" + apiKey;
-    
-    LOG_DEBUG("Making translation request for: " + text);
-    
-    // Make HTTP request
-    string response = HttpsRequest("translation.googleapis.com", path, requestBody);
-    
-    if (response.empty()) {
-        LOG_ERROR("Empty response from translation API");
-        return TranslationResult::NETWORK_ERROR;
+    // Messages are translated segment by segment, so a line that repeats a
+    // known sentence only sends the new parts to the API
+    vector<vector<TextSegment>> segments(texts.size());
+    vector<size_t> firstUnit(texts.size() + 1, 0);
+    vector<string> units;
+    for (size_t i = 0; i < texts.size(); ++i) {
+        firstUnit[i] = units.size();
+        ExtractSegments(texts[i], segments[i], units);
+    }
+    firstUnit[texts.size()] = units.size();
+    
+    // Links, numbers, names and glossary words become placeholders; the
+    // templates are what gets cached and sent
+    vector<string> templates(units.size());
+    vector<vector<MaskSpan>> spans(units.size());
+    for (size_t unit = 0; unit < units.size(); ++unit) {
+        masker.Mask(units[unit], templates[unit], spans[unit]);
     }
     
-    // Parse response
-    string translation = ParseTranslationResponse(response);
-    
-    if (translation.empty()) {
-        LOG_ERROR("Failed to parse translation from response: " + response.substr(0, 200));
-        return TranslationResult::API_ERROR;
+    vector<string> unitResults;
+    vector<bool> cached;
+    vector<TranslationResult> unitStatuses;
+    if (!units.empty()) {
+        TranslateUnits(templates, fromLang, toLang, unitResults, cached, unitStatuses);
     }
     
-    // Fix UTF-8 encoding issues
-    translation = UTF8Helper::FixUTF8String(translation);
+    string unmasked;
+    for (size_t unit = 0; unit < units.size(); ++unit) {
+        if (unitStatuses[unit] == TranslationResult::SUCCESS && !spans[unit].empty()) {
+            Unmask(unitResults[unit], units[unit], spans[unit], unmasked);
+            unitResults[unit].swap(unmasked);
+        }
+    }
     
-    // Cache the result
-    cache[cacheKey] = CacheEntry(translation);
+    // A message fails with the first of its segments that failed
+    TranslationResult firstFailure = TranslationResult::SUCCESS;
+    lock_guard<mutex> statsLock(cacheMutex);
+    for (size_t i = 0; i < texts.size(); ++i) {
+        size_t first = firstUnit[i];
+        size_t count = firstUnit[i + 1] - first;
+        statuses[i] = TranslationResult::SUCCESS;
+        if (count == 0) {
+            results[i] = texts[i];
+            continue;
+        }
+        for (size_t unit = first; unit < first + count && statuses[i] == TranslationResult::SUCCESS; ++unit) {
+            statuses[i] = unitStatuses[unit];
+        }
+        if (statuses[i] != TranslationResult::SUCCESS) {
+            if (firstFailure == TranslationResult::SUCCESS) {
+                firstFailure = statuses[i];
+            }
+            continue;
+        }
+        
+        JoinSegments(texts[i], segments[i], unitResults, first, results[i]);
+        
+        size_t hits = 0;
+        for (size_t unit = first; unit < first + count; ++unit) {
+            hits += cached[unit] ? 1 : 0;
+        }
+        memoryStats.messages++;
+        memoryStats.messageHits += hits == count ? 1 : 0;
+        memoryStats.segments += count;
+        memoryStats.segmentHits += hits;
+    }
     
-    result = translation;
-    LOG_DEBUG("Translation successful: " + text + " -> " + translation);
+    return firstFailure;
+}
+
+void TranslationClient::FinishInFlight(const vector<CacheKey>& keys, const vector<TranslationResult>& statuses,
+                                       const vector<string>& translations) {
+    // Caller holds cacheMutex
+    for (size_t slot = 0; slot < keys.size(); ++slot) {
+        auto it = inFlight.find(keys[slot]);
+        if (it == inFlight.end()) {
+            continue;
+        }
+        TranslationResult status = statuses[slot];
+        it->second->status = status;
+        if (status == TranslationResult::SUCCESS && slot < translations.size()) {
+            it->second->translation = translations[slot];
+        }
+        it->second->done = true;
+        inFlight.erase(it);
+    }
+    inFlightDone.notify_all();
+}
+
+TranslationResult TranslationClient::TranslateUnits(const vector<string>& texts, const string& fromLang,
+                                                   const string& toLang, vector<string>& results,
+                                                   vector<bool>& cached, vector<TranslationResult>& statuses) {
+    results.assign(texts.size(), string());
+    cached.assign(texts.size(), false);
+    statuses.assign(texts.size(), TranslationResult::SUCCESS);
+
+    // Check the caches first. Identical texts in one batch share a single
+    // query slot, and texts another thread is already fetching are waited
+    // for instead of being requested again.
+    PendingQueries pending;
+    pending.missSlot.assign(texts.size(), string::npos);
+    vector<pair<size_t, shared_ptr<InFlightQuery>>> waiting;
+    {
+        TraceSpan span("cache_lookup");
+        lock_guard<mutex> cacheLock(cacheMutex);
+        vector<CacheKey> textKeys;
+        textKeys.reserve(texts.size());
+        for (const string& text : texts) {
+            textKeys.push_back(MakeCacheKey(text, fromLang, toLang));
+        }
+
+        unordered_map<CacheKey, size_t, CacheKeyHash> queued;
+        for (size_t i = 0; i < texts.size(); ++i) {
+            const CacheKey& cacheKey = textKeys[i];
+            if (cache.Get(cacheKey, results[i])) {
+                LOG_DEBUG("Translation cache hit for: ", texts[i]);
+                cached[i] = true;
+                continue;
+            }
+
+            // A text that recently failed for good fails again without
+            // being sent; the rest of the call goes ahead
+            TranslationResult negative = TranslationResult::SUCCESS;
+            bool remembered = negativeCache.Lookup(cacheKey, negative);
+            if (remembered && negative != TranslationResult::SUCCESS) {
+                statuses[i] = negative;
+                continue;
+            }
+
+            // Recently returned unchanged, or nothing to translate (numbers,
+            // punctuation, links): the text stands for itself
+            if (remembered || DetectScript(texts[i]).letters == 0) {
+                results[i] = texts[i];
+                cached[i] = true;
+                memoryStats.negativeHits++;
+                continue;
+            }
+
+            auto queuedIt = queued.find(cacheKey);
+            if (queuedIt != queued.end()) {
+                pending.missSlot[i] = queuedIt->second;
+                memoryStats.coalesced++;
+                continue;
+            }
+
+            auto flightIt = inFlight.find(cacheKey);
+            if (flightIt != inFlight.end()) {
+                waiting.emplace_back(i, flightIt->second);
+                memoryStats.coalesced++;
+                continue;
+            }
+
+            pending.missSlot[i] = pending.queryIndex.size();
+            queued.emplace(cacheKey, pending.queryIndex.size());
+            pending.queryIndex.push_back(i);
+            pending.keys.push_back(cacheKey);
+            inFlight.emplace(cacheKey, make_shared<InFlightQuery>());
+        }
+    }
+
+    vector<string> translations;
+    vector<TranslationResult> slotStatuses;
+    vector<bool> permanent;
+    try {
+        FetchUnits(texts, fromLang, toLang, pending, results, cached, translations, slotStatuses, permanent);
+    } catch (...) {
+        // Never leave waiters hanging on a fetch that will not finish
+        lock_guard<mutex> cacheLock(cacheMutex);
+        FinishInFlight(pending.keys, vector<TranslationResult>(pending.keys.size(), TranslationResult::API_ERROR),
+                       translations);
+        throw;
+    }
+
+    const vector<size_t>& queryIndex = pending.queryIndex;
+    const vector<CacheKey>& cacheKeys = pending.keys;
+    {
+        lock_guard<mutex> cacheLock(cacheMutex);
+        for (size_t slot = 0; slot < queryIndex.size(); ++slot) {
+            if (slotStatuses[slot] != TranslationResult::SUCCESS) {
+                // Only a failure pinned on this text alone is remembered;
+                // transient failures (network, timeout, 429/5xx, open
+                // breaker, shed) and errors for the whole request are not
+                if (permanent[slot]) {
+                    negativeCache.Add(cacheKeys[slot], chrono::seconds(FAILURE_TTL_SECONDS), slotStatuses[slot]);
+                }
+                continue;
+            }
+            // Unchanged results stay out of the main cache and the disk
+            // file; the negative cache keeps them from being re-sent
+            if (translations[slot] == texts[queryIndex[slot]]) {
+                negativeCache.Add(cacheKeys[slot], chrono::seconds(UNCHANGED_TTL_SECONDS));
+            } else {
+                cache.Put(cacheKeys[slot], translations[slot]);
+            }
+        }
+        FinishInFlight(cacheKeys, slotStatuses, translations);
+    }
+
+    if (diskCache) {
+        for (size_t slot = 0; slot < queryIndex.size(); ++slot) {
+            if (slotStatuses[slot] == TranslationResult::SUCCESS && translations[slot] != texts[queryIndex[slot]]) {
+                diskCache->Append(SerializeCacheKey(cacheKeys[slot]), translations[slot]);
+            }
+        }
+    }
+
+    // Fan results back out to every requested text
+    for (size_t i = 0; i < texts.size(); ++i) {
+        size_t slot = pending.missSlot[i];
+        if (slot == string::npos) {
+            continue;
+        }
+        statuses[i] = slotStatuses[slot];
+        if (statuses[i] != TranslationResult::SUCCESS) {
+            continue;
+        }
+        results[i] = translations[slot];
+        LOG_DEBUG("Translation successful: ", texts[i], " -> ", results[i]);
+    }
+
+    // Texts fetched by other threads; our own requests are done first, so
+    // two threads waiting on each other's keys cannot deadlock
+    if (!waiting.empty()) {
+        TraceSpan span("wait_in_flight");
+        unique_lock<mutex> cacheLock(cacheMutex);
+        for (auto& [index, query] : waiting) {
+            inFlightDone.wait(cacheLock, [&query] { return query->done; });
+            statuses[index] = query->status;
+            if (query->status == TranslationResult::SUCCESS) {
+                results[index] = query->translation;
+            }
+        }
+    }
+
+    for (TranslationResult textStatus : statuses) {
+        if (textStatus != TranslationResult::SUCCESS) {
+            return textStatus;
+        }
+    }
     return TranslationResult::SUCCESS;
 }
+
+void TranslationClient::ResolveAnswered(const vector<string>& texts, const vector<bool>& answered,
+                                        const vector<string>& found, bool remember, PendingQueries& pending,
+                                        vector<string>& results, vector<bool>& cached) {
+    PendingQueries remaining;
+    vector<CacheKey> foundKeys;
+    vector<string> foundTranslations;
+    vector<size_t> slotMap(pending.queryIndex.size());
+
+    for (size_t slot = 0; slot < pending.queryIndex.size(); ++slot) {
+        if (answered[slot]) {
+            slotMap[slot] = string::npos;
+            foundKeys.push_back(pending.keys[slot]);
+            foundTranslations.push_back(found[slot]);
+            continue;
+        }
+        slotMap[slot] = remaining.queryIndex.size();
+        remaining.queryIndex.push_back(pending.queryIndex[slot]);
+        remaining.keys.push_back(pending.keys[slot]);
+    }
+
+    if (foundKeys.empty()) {
+        return;
+    }
+
+    {
+        lock_guard<mutex> cacheLock(cacheMutex);
+        for (size_t slot = 0; slot < foundKeys.size(); ++slot) {
+            if (remember) {
+                cache.Put(foundKeys[slot], foundTranslations[slot]);
+            } else {
+                memoryStats.localHits++;
+            }
+        }
+        FinishInFlight(foundKeys, vector<TranslationResult>(foundKeys.size(), TranslationResult::SUCCESS),
+                       foundTranslations);
+    }
+
+    // Fill in the answered texts and renumber the slots still open
+    remaining.missSlot.swap(pending.missSlot);
+    for (size_t i = 0; i < texts.size(); ++i) {
+        size_t slot = remaining.missSlot[i];
+        if (slot == string::npos) {
+            continue;
+        }
+        if (slotMap[slot] == string::npos) {
+            results[i] = found[slot];
+            cached[i] = true;
+            LOG_DEBUG(remember ? "Disk cache hit for: " : "Phrase table hit for: ", texts[i]);
+        }
+        remaining.missSlot[i] = slotMap[slot];
+    }
+
+    pending = move(remaining);
+}
+
+TranslationResult TranslationClient::FetchUnits(const vector<string>& texts, const string& fromLang,
+                                               const string& toLang, PendingQueries& pending,
+                                               vector<string>& results, vector<bool>& cached,
+                                               vector<string>& translations,
+                                               vector<TranslationResult>& slotStatuses, vector<bool>& permanent) {
+    TraceSpan span("FetchUnits");
+    slotStatuses.clear();
+    permanent.clear();
+    // Memory misses go to the disk cache, then to the local backends, and
+    // only what is left to the network
+    if (diskCache && !pending.queryIndex.empty()) {
+        vector<string> found(pending.queryIndex.size());
+        vector<bool> answered(pending.queryIndex.size(), false);
+        for (size_t slot = 0; slot < pending.queryIndex.size(); ++slot) {
+            answered[slot] = diskCache->Lookup(SerializeCacheKey(pending.keys[slot]), found[slot]);
+        }
+        ResolveAnswered(texts, answered, found, true, pending, results, cached);
+    }
+
+    for (const unique_ptr<TranslationBackend>& backend : localBackends) {
+        if (pending.queryIndex.empty()) {
+            break;
+        }
+        vector<string> found(pending.queryIndex.size());
+        vector<bool> answered(pending.queryIndex.size(), false);
+        if (backend->Translate(texts, pending.queryIndex, fromLang, toLang, found, answered) ==
+            TranslationResult::SUCCESS) {
+            ResolveAnswered(texts, answered, found, false, pending, results, cached);
+        }
+    }
+
+    if (pending.queryIndex.empty()) {
+        return TranslationResult::SUCCESS;
+    }
+
+    translations.assign(pending.queryIndex.size(), string());
+    vector<bool> answered(pending.queryIndex.size(), false);
+    return remote.Translate(texts, pending.queryIndex, fromLang, toLang, translations, answered, slotStatuses,
+                            permanent);
+}
+
+TranslationMemoryStats TranslationClient::GetMemoryStats() const {
+    lock_guard<mutex> lock(cacheMutex);
+    return memoryStats;
+}
+
+TranslationCacheStats TranslationClient::GetCacheStats(size_t& entries, size_t& bytes) const {
+    lock_guard<mutex> lock(cacheMutex);
+    entries = cache.Size();
+    bytes = cache.Bytes();
+    return cache.GetStats();
+}
+
+ResilienceStats TranslationClient::GetResilienceStats() const {
+    return remote.GetStats();
+}
+
+// Description and preformatted error reply of each result code, indexed by
+// the code; the last entry is for codes outside the enum
+struct ResultText {
+    const char* description;
+    const char* errorReply;
+};
+
+#define RESULT_TEXT(description) { description, "CET translate error: " description }
+static const ResultText RESULT_TEXTS[] = {
+    RESULT_TEXT("success"),
+    RESULT_TEXT("network error"),
+    RESULT_TEXT("API error"),
+    RESULT_TEXT("encoding error"),
+    RESULT_TEXT("timeout"),
+    RESULT_TEXT("invalid parameters"),
+    RESULT_TEXT("dropped under load"),
+    RESULT_TEXT("translation service unavailable"),
+    RESULT_TEXT("unknown error"),
+};
+#undef RESULT_TEXT
+
+static const size_t RESULT_TEXT_COUNT = sizeof(RESULT_TEXTS) / sizeof(RESULT_TEXTS[0]);
+static_assert(RESULT_TEXT_COUNT == static_cast<size_t>(TranslationResult::UNAVAILABLE) + 2,
+              "one RESULT_TEXTS entry per TranslationResult, plus unknown");
+
+static const ResultText& ResultTextFor(TranslationResult result) {
+    size_t index = static_cast<size_t>(result);
+    return RESULT_TEXTS[index < RESULT_TEXT_COUNT ? index : RESULT_TEXT_COUNT - 1];
+}
+
+const char* TranslationResultToString(TranslationResult result) {
+    return ResultTextFor(result).description;
+}
+
+const char* TranslationErrorReply(TranslationResult result) {
+    return ResultTextFor(result).errorReply;
+}
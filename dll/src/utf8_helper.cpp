@@ -0,0 +1,156 @@
+// utf8_helper.cpp - UTF-8 validation and repair for CET
+
+#include <string>
+#include <string_view>
+
+#include "../include/utf8_helper.h"
+#include "../include/simd.h"
+
+using namespace std;
+
+static const char REPLACEMENT_CHARACTER[] = "\xEF\xBF\xBD";
+
+// Number of ASCII bytes at the start of text[pos, size)
+static size_t AsciiRun(const unsigned char* data, size_t pos, size_t size) {
+    size_t start = pos;
+
+#ifdef CET_HAVE_SSE2
+    while (pos + 16 <= size) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        if (_mm_movemask_epi8(chunk) != 0) {
+            break;
+        }
+        pos += 16;
+    }
+#endif
+
+    while (pos < size && data[pos] < 0x80) {
+        ++pos;
+    }
+    return pos - start;
+}
+
+// Check the multi-byte sequence starting at data[pos]. Returns its length if
+// well formed, otherwise 0 with invalidLength set to the maximal ill-formed
+// subpart (at least 1), which is what a single U+FFFD replaces.
+static size_t SequenceLength(const unsigned char* data, size_t pos, size_t size, size_t& invalidLength) {
+    unsigned char lead = data[pos];
+    size_t length;
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        if (lead == 0xE0) low = 0xA0;       // overlong
+        if (lead == 0xED) high = 0x9F;      // surrogates
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        if (lead == 0xF0) low = 0x90;       // overlong
+        if (lead == 0xF4) high = 0x8F;      // past U+10FFFF
+    } else {
+        invalidLength = 1;
+        return 0;
+    }
+
+    for (size_t i = 1; i < length; ++i) {
+        if (pos + i >= size) {
+            invalidLength = i;
+            return 0;
+        }
+
+        unsigned char next = data[pos + i];
+        unsigned char lowest = i == 1 ? low : 0x80;
+        unsigned char highest = i == 1 ? high : 0xBF;
+        if (next < lowest || next > highest) {
+            invalidLength = i;
+            return 0;
+        }
+    }
+
+    return length;
+}
+
+size_t UTF8Helper::FindInvalid(string_view text) {
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(text.data());
+    size_t size = text.size();
+    size_t pos = 0;
+
+    while (pos < size) {
+        pos += AsciiRun(data, pos, size);
+        if (pos >= size) {
+            break;
+        }
+
+        size_t invalidLength;
+        size_t length = SequenceLength(data, pos, size, invalidLength);
+        if (length == 0) {
+            return pos;
+        }
+        pos += length;
+    }
+
+    return npos;
+}
+
+string UTF8Helper::Repair(string_view text, size_t maxBytes) {
+    size_t firstInvalid = FindInvalid(text);
+    if (firstInvalid == npos) {
+        return string(text.substr(0, SafeTruncateLength(text, maxBytes)));
+    }
+
+    if (firstInvalid >= maxBytes) {
+        return string(text.substr(0, SafeTruncateLength(text.substr(0, firstInvalid), maxBytes)));
+    }
+
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(text.data());
+    size_t size = text.size();
+    size_t limit = maxBytes;
+
+    // The valid prefix is copied as is
+    string result;
+    result.reserve(size + 8 < limit ? size + 8 : limit);
+    result.append(text.data(), firstInvalid);
+
+    size_t pos = firstInvalid;
+    while (pos < size) {
+        size_t run = AsciiRun(data, pos, size);
+        if (run > 0) {
+            if (result.size() + run > limit) {
+                result.append(text.data() + pos, limit - result.size());
+                break;
+            }
+            result.append(text.data() + pos, run);
+            pos += run;
+            continue;
+        }
+
+        size_t invalidLength;
+        size_t length = SequenceLength(data, pos, size, invalidLength);
+        const char* piece = length > 0 ? text.data() + pos : REPLACEMENT_CHARACTER;
+        size_t pieceLength = length > 0 ? length : sizeof(REPLACEMENT_CHARACTER) - 1;
+
+        if (result.size() + pieceLength > limit) {
+            break;
+        }
+        result.append(piece, pieceLength);
+        pos += length > 0 ? length : invalidLength;
+    }
+
+    return result;
+}
+
+size_t UTF8Helper::SafeTruncateLength(string_view text, size_t maxBytes) {
+    if (text.size() <= maxBytes) {
+        return text.size();
+    }
+
+    // Back up over continuation bytes to the start of the character that
+    // straddles the limit
+    size_t length = maxBytes;
+    while (length > 0 && (static_cast<unsigned char>(text[length]) & 0xC0) == 0x80) {
+        --length;
+    }
+    return length;
+}
@@ -1,6 +1,10 @@
 // utils.cpp - Utility functions for CET
 
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
 #include <string>
 #include <vector>
 #include <sstream>
@@ -23,6 +27,7 @@ string GetCurrentTimestamp() {
     return oss.str();
 }
 
+#ifdef _WIN32
 string GetDllPath() {
     char path[MAX_PATH];
     HMODULE hModule = nullptr;
@@ -41,6 +46,39 @@ string GetDllPath() {
     
     return string(path);
 }
+#else
+// Outside the game (benchmarks, tools) the module is the executable or a
+// shared library linked into it
+string GetDllPath() {
+    Dl_info info;
+    if (dladdr(reinterpret_cast<void*>(&GetDllPath), &info) == 0 || !info.dli_fname) {
+        return "";
+    }
+    return string(info.dli_fname);
+}
+#endif
+
+string GetDllDirectoryPath() {
+    string dllPath = GetDllPath();
+    size_t lastSlash = dllPath.find_last_of("\\/");
+    if (lastSlash == string::npos) {
+        return "";
+    }
+
+    return dllPath.substr(0, lastSlash);
+}
+
+string JoinPath(const string& directory, const string& name) {
+#ifdef _WIN32
+    const char separator = '\\';
+#else
+    const char separator = '/';
+#endif
+    if (directory.empty() || directory.back() == '/' || directory.back() == separator) {
+        return directory + name;
+    }
+    return directory + separator + name;
+}
 
 vector<string> SplitString(const string& str, char delimiter) {
     vector<string> tokens;
@@ -83,6 +121,7 @@ bool IsValidLanguageCode(const string& lang) {
     return validCodes.find(lowerLang) != validCodes.end();
 }
 
+#ifdef _WIN32
 bool IsValidMemoryAddress(void* addr) {
     if (addr == nullptr) {
         return false;
@@ -109,3 +148,4 @@ void* SafeGetProcAddress(HMODULE hModule, const char* procName) {
         return nullptr;
     }
 }
+#endif
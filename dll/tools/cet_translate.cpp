@@ -0,0 +1,135 @@
+// cet_translate.cpp - Translate stdin to stdout with the CET translation core
+// One output line per input line, in order. Lines with no letters, and lines
+// that fail to translate, are copied through unchanged; failures are reported
+// on stderr. Points at a local endpoint such as cet_mock_server by default.
+
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../include/translator_core.h"
+#include "../include/script_detect.h"
+#include "../include/logging.h"
+
+using namespace std;
+
+static const char* const DEFAULT_ENDPOINT_URL = "http://127.0.0.1:8089/language/translate/v2";
+
+struct TranslateOptions {
+    string endpoint = DEFAULT_ENDPOINT_URL;
+    string apiKey = "local";            // empty: phrase tables only
+    string fromLang;                    // empty: detect each line
+    string toLang;                      // empty: en, or zh for English lines
+    uint32_t timeoutMs = 0;             // 0: the client default
+    bool phraseTables = true;
+    string logLevel;
+};
+
+static void PrintUsage() {
+    printf("usage: cet_translate [options] < input > output\n"
+           "  --endpoint URL      translate endpoint (%s)\n"
+           "  --key KEY           API key sent with each request (local)\n"
+           "  --offline           no endpoint; phrase tables next to the binary only\n"
+           "  --from LANG         source language; detected per line by default\n"
+           "  --to LANG           target language; en, or zh for English lines by default\n"
+           "  --timeout-ms N      per-request timeout including retries\n"
+           "  --no-phrases        skip the CET_phrases_<from>_<to>.tsv tables\n"
+           "  --log LEVEL         write CET.log next to the binary at debug/info/warning/error\n",
+           DEFAULT_ENDPOINT_URL);
+}
+
+int main(int argc, char** argv) {
+    TranslateOptions options;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--endpoint" && i + 1 < argc) {
+            options.endpoint = argv[++i];
+        } else if (arg == "--key" && i + 1 < argc) {
+            options.apiKey = argv[++i];
+        } else if (arg == "--offline") {
+            options.apiKey.clear();
+        } else if (arg == "--from" && i + 1 < argc) {
+            options.fromLang = argv[++i];
+        } else if (arg == "--to" && i + 1 < argc) {
+            options.toLang = argv[++i];
+        } else if (arg == "--timeout-ms" && i + 1 < argc) {
+            options.timeoutMs = static_cast<uint32_t>(max(0, atoi(argv[++i])));
+        } else if (arg == "--no-phrases") {
+            options.phraseTables = false;
+        } else if (arg == "--log" && i + 1 < argc) {
+            options.logLevel = argv[++i];
+        } else {
+            PrintUsage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    if (!options.logLevel.empty()) {
+        LogLevel level;
+        if (!ParseLogLevel(options.logLevel, level)) {
+            fprintf(stderr, "cet_translate: unknown log level %s\n", options.logLevel.c_str());
+            return 1;
+        }
+        InitializeLogging();
+        SetLogLevel(level);
+        StartLogWriter();
+    }
+
+    // No CET_cache.bin: a command-line run should not leave files behind
+    TranslationClient client;
+    client.SetEndpoint(options.endpoint);
+    client.SetDiskCacheBudget(0);
+    client.SetPhraseTables(options.phraseTables);
+    if (options.timeoutMs != 0) {
+        client.SetRequestTimeout(options.timeoutMs);
+    }
+    if (!client.Initialize(options.apiKey)) {
+        fprintf(stderr, "cet_translate: cannot initialize the translator for %s\n", options.endpoint.c_str());
+        return 1;
+    }
+
+    string line;
+    string translated;
+    size_t lineNumber = 0;
+    size_t failed = 0;
+    while (getline(cin, line)) {
+        lineNumber++;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        string fromLang = options.fromLang;
+        if (fromLang.empty()) {
+            const char* detected = ScriptLanguageCode(DetectScript(line).script);
+            fromLang = detected ? detected : "";
+        }
+        string toLang = options.toLang.empty() ? (fromLang == "en" ? "zh" : "en") : options.toLang;
+        if (fromLang.empty() || fromLang == toLang) {
+            fwrite(line.data(), 1, line.size(), stdout);
+            fputc('\n', stdout);
+            continue;
+        }
+
+        TranslationResult result = client.TranslateText(line, fromLang, toLang, translated);
+        if (result == TranslationResult::SUCCESS) {
+            fwrite(translated.data(), 1, translated.size(), stdout);
+        } else {
+            failed++;
+            fprintf(stderr, "cet_translate: line %zu: %s\n", lineNumber, TranslationResultToString(result));
+            fwrite(line.data(), 1, line.size(), stdout);
+        }
+        fputc('\n', stdout);
+        // Keep up with interactive input
+        fflush(stdout);
+    }
+
+    client.Cleanup();
+    if (!options.logLevel.empty()) {
+        StopLogWriter();
+        CleanupLogging();
+    }
+    return failed == 0 ? 0 : 2;
+}